@@ -0,0 +1,1035 @@
+// Benchmark suite over generated market data.
+//
+// Build:  g++ -std=c++17 -O2 -pthread -Iinclude bench/Benchmark.cpp src/*.cpp -o stock_bench
+// Run:    stock_bench [--tickers 20,100,500] [--years 5] [--dividends 4] [--seed 42]
+//                     [--repetitions 5] [--json results.json]
+//         stock_bench --generate out.csv [--tickers N] [--years Y] [--dividends F] [--seed S]
+//         stock_bench --check
+//
+// Before timing anything the vector scan kernels are checked against the
+// scalar ones on inputs with NaN, infinities and -0.0 at lengths and offsets
+// that are not multiples of the vector width, and every column encoding is
+// decoded back and compared bit for bit, and the rankings are checked against
+// the filter engine's scan on rows with NaN values; --check runs only those checks.
+// For every dataset size a CSV is generated, loaded, and each operation is
+// timed. Fast operations run in batches calibrated to at least 10 ms; every
+// measurement is repeated and the median and best ns/op are reported, with
+// peak RSS per size. The JSON output has a fixed key order so runs of two
+// versions can be diffed. Each size also reports the size, scan speed and
+// point lookup cost of the column encodings (see CompressedColumn.h) on the
+// generated close, volume and dividend columns, in file order and per ticker.
+// Queries 6, 13, 14 and 15 are timed again through the filter engine
+// (RowFilter.h), next to filters that no single index answers. Writes include
+// following the CSV (CsvFollower.h) while whole days are appended to the
+// loaded history, timed per appended day. Reads from a cold segment include
+// the first ranked query after freezing, which builds the rankings over it.
+// The bytes the columns and indexes keep in memory are reported with all rows
+// in memory and with every row frozen, next to the mapped segment sizes.
+
+#include "StockDatabase.h"
+#include "MarketDataGenerator.h"
+#include "ScanKernels.h"
+#include "CompressedColumn.h"
+#include "CsvFollower.h"
+#include <sys/resource.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    struct Measurement
+    {
+        std::string name;
+        size_t operations = 0; // per repetition
+        double nsPerOp = 0;    // median over repetitions
+        double bestNsPerOp = 0;
+        double bytesPerOp = 0; // > 0 for operations that read a file
+    };
+
+    struct CompressionResult
+    {
+        std::string column;
+        std::string order;    // "date" (file order) or "ticker"
+        std::string encoding; // "none" is the plain vector
+        double bytesPerValue = 0;
+        double scanNsPerValue = 0; // sum of the whole column
+        double lookupNs = 0;       // one value at a random position
+    };
+
+    struct SizeResult
+    {
+        size_t tickers = 0;
+        size_t rows = 0;
+        size_t csvBytes = 0;
+        long peakRssKb = 0;
+        size_t coldSegmentBytes = 0; // every row frozen, raw and compressed
+        size_t compressedSegmentBytes = 0;
+        MemoryUsage memory; // all rows in memory, then every row frozen raw and compressed
+        MemoryUsage coldMemory;
+        MemoryUsage compressedMemory;
+        std::vector<Measurement> measurements;
+        std::vector<CompressionResult> compression;
+    };
+
+    struct Config
+    {
+        std::vector<size_t> tickerCounts{20, 100, 500};
+        MarketDataOptions data;
+        int repetitions = 5;
+        std::string jsonPath;
+        std::string generatePath;
+        bool checkOnly = false;
+    };
+
+    volatile double sink = 0; // keeps results observable
+
+    // Swallows std::cout while the database reports loads, adds and deletes
+    class NullBuffer : public std::streambuf
+    {
+    protected:
+        int overflow(int c) override { return c; }
+    };
+
+    class QuietStdout
+    {
+    private:
+        NullBuffer null;
+        std::streambuf *saved;
+
+    public:
+        QuietStdout() : saved(std::cout.rdbuf(&null)) {}
+        ~QuietStdout() { std::cout.rdbuf(saved); }
+    };
+
+    long peakRssKb()
+    {
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+
+    double elapsedNs(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    Measurement summarize(const std::string &name, size_t operations, std::vector<double> perOp)
+    {
+        std::sort(perOp.begin(), perOp.end());
+        Measurement m;
+        m.name = name;
+        m.operations = operations;
+        m.nsPerOp = perOp[perOp.size() / 2];
+        m.bestNsPerOp = perOp.front();
+        return m;
+    }
+
+    // Time op(i) for i = 0, 1, ... in batches of at least 10 ms
+    Measurement measure(const std::string &name, int repetitions, const std::function<void(size_t)> &op)
+    {
+        op(0); // warm-up (first use builds lazy indexes)
+        size_t operations = 1;
+        while (true)
+        {
+            auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < operations; ++i)
+            {
+                op(i);
+            }
+            if (elapsedNs(start) >= 1e7 || operations >= (size_t(1) << 26))
+            {
+                break;
+            }
+            operations *= 2;
+        }
+
+        std::vector<double> perOp;
+        for (int r = 0; r < repetitions; ++r)
+        {
+            auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < operations; ++i)
+            {
+                op(i);
+            }
+            perOp.push_back(elapsedNs(start) / operations);
+        }
+        return summarize(name, operations, perOp);
+    }
+
+    // Time an operation that needs fresh state: setup() is not timed, run() does `operations` operations
+    Measurement measureWithSetup(const std::string &name, int repetitions, size_t operations,
+                                 const std::function<void()> &setup, const std::function<void()> &run)
+    {
+        std::vector<double> perOp;
+        for (int r = 0; r < repetitions; ++r)
+        {
+            setup();
+            auto start = std::chrono::steady_clock::now();
+            run();
+            perOp.push_back(elapsedNs(start) / operations);
+        }
+        return summarize(name, operations, perOp);
+    }
+
+    // Equal bit for bit, or both NaN
+    bool sameValue(double a, double b)
+    {
+        return (a != a && b != b) || std::memcmp(&a, &b, sizeof(double)) == 0;
+    }
+
+    // Values between -4 and 4 at 1/16 resolution (so many repeat), with NaN,
+    // infinities and signed zeros mixed in
+    std::vector<double> awkwardValues(size_t count, std::uint64_t seed)
+    {
+        std::mt19937_64 random(seed);
+        std::vector<double> values(count);
+        for (double &value : values)
+        {
+            switch (random() % 16)
+            {
+            case 0:
+                value = std::numeric_limits<double>::quiet_NaN();
+                break;
+            case 1:
+                value = random() % 2 ? std::numeric_limits<double>::infinity() : -std::numeric_limits<double>::infinity();
+                break;
+            case 2:
+                value = random() % 2 ? 0.0 : -0.0;
+                break;
+            default:
+                value = static_cast<double>(static_cast<int>(random() % 129) - 64) / 16;
+            }
+        }
+        return values;
+    }
+
+    // Every scan kernel of `kernel` against the scalar ones; prints the first
+    // mismatch and returns false
+    bool checkScanKernel(ScanKernel kernel)
+    {
+        const double inf = std::numeric_limits<double>::infinity();
+        const double bounds[][2] = {{-1, 1}, {0, inf}, {-inf, -0.0}, {-inf, inf}, {2, 2}};
+        std::vector<double> values = awkwardValues(1024 + 64, 17), other = awkwardValues(1024 + 64, 18);
+        std::vector<std::uint32_t> positions(values.size()), expectedPositions(values.size());
+        std::vector<std::uint64_t> bits(values.size() / 64 + 1), expectedBits(bits.size());
+        bool ok = true;
+        auto expect = [&](bool same, const char *function, size_t offset, size_t count)
+        {
+            if (!same && ok)
+            {
+                std::printf("scan kernel %s differs from scalar: %s at offset %zu, %zu values\n",
+                            scanKernelName(kernel), function, offset, count);
+            }
+            ok &= same;
+        };
+        for (size_t offset = 0; offset < 3; ++offset)
+        {
+            for (size_t count = 0; count <= 1024; count += count < 40 ? 1 : 61)
+            {
+                const double *v = values.data() + offset;
+                const double *w = other.data() + offset;
+                setScanKernel(ScanKernel::Scalar);
+                double sum = scanSum(v, count), max = scanMax(v, count), min = scanMin(v, count), dot = scanDot(v, w, count);
+                size_t above[5], between[5], filtered[5];
+                for (size_t b = 0; b < 5; ++b)
+                {
+                    above[b] = scanCountAbove(v, count, bounds[b][0]);
+                    between[b] = scanCountBetween(v, count, bounds[b][0], bounds[b][1]);
+                }
+                std::vector<double> added(v, v + count);
+                scanAddToAll(added.data(), count, 0.25);
+
+                setScanKernel(kernel);
+                expect(sameValue(scanSum(v, count), sum), "scanSum", offset, count);
+                expect(sameValue(scanMax(v, count), max), "scanMax", offset, count);
+                expect(sameValue(scanMin(v, count), min), "scanMin", offset, count);
+                expect(sameValue(scanDot(v, w, count), dot), "scanDot", offset, count);
+                for (size_t b = 0; b < 5; ++b)
+                {
+                    double lower = bounds[b][0], upper = bounds[b][1];
+                    expect(scanCountAbove(v, count, lower) == above[b], "scanCountAbove", offset, count);
+                    expect(scanCountBetween(v, count, lower, upper) == between[b], "scanCountBetween", offset, count);
+
+                    setScanKernel(ScanKernel::Scalar);
+                    filtered[b] = scanFilterBetween(v, count, lower, upper, expectedPositions.data());
+                    scanMaskBetween(v, count, lower, upper, expectedBits.data());
+                    setScanKernel(kernel);
+                    expect(scanFilterBetween(v, count, lower, upper, positions.data()) == filtered[b] &&
+                               std::equal(positions.begin(), positions.begin() + filtered[b], expectedPositions.begin()),
+                           "scanFilterBetween", offset, count);
+                    scanMaskBetween(v, count, lower, upper, bits.data());
+                    expect(std::equal(bits.begin(), bits.begin() + (count + 63) / 64, expectedBits.begin()),
+                           "scanMaskBetween", offset, count);
+                }
+                std::vector<double> vectorAdded(v, v + count);
+                scanAddToAll(vectorAdded.data(), count, 0.25);
+                expect(std::equal(added.begin(), added.end(), vectorAdded.begin(), sameValue), "scanAddToAll", offset, count);
+            }
+        }
+        return ok;
+    }
+
+    // Every kernel the CPU supports against scalar; the best one stays active
+    bool checkScanKernels()
+    {
+        ScanKernel best = activeScanKernel();
+        bool ok = true;
+        for (ScanKernel kernel : {ScanKernel::Avx2, ScanKernel::Avx512})
+        {
+            if (setScanKernel(kernel) == kernel)
+            {
+                ok &= checkScanKernel(kernel);
+            }
+        }
+        setScanKernel(best);
+        std::printf("scan kernels: %s\n", ok ? "match scalar" : "MISMATCH");
+        return ok;
+    }
+
+    // Whole numbers (decimals 0) or prices with two decimals, in blocks of 64:
+    // every third block is clean, so FixedPoint and DeltaVarint keep it, the
+    // next has one NaN, infinity or -0.0, the next a special every seventh value
+    std::vector<double> encodingInput(size_t count, int decimals, std::uint64_t seed)
+    {
+        std::mt19937_64 random(seed);
+        std::vector<double> values(count), specials = awkwardValues(count, seed + 1);
+        std::int64_t level = 100000;
+        for (size_t i = 0; i < count; ++i)
+        {
+            level += static_cast<std::int64_t>(random() % 201) - 100;
+            values[i] = decimals == 0 ? static_cast<double>(level) : static_cast<double>(level) / 100;
+        }
+        const double special[] = {std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::infinity(),
+                                  -std::numeric_limits<double>::infinity(), -0.0};
+        for (size_t block = 0; block * CompressedColumn::BLOCK < count; ++block)
+        {
+            size_t first = block * CompressedColumn::BLOCK;
+            size_t length = std::min(CompressedColumn::BLOCK, count - first);
+            if (block % 3 == 1)
+            {
+                values[first + random() % length] = special[block % 4];
+            }
+            for (size_t i = first; block % 3 == 2 && i < first + length; i += 7)
+            {
+                values[i] = specials[i];
+            }
+        }
+        return values;
+    }
+
+    // Every encoding decoded back, whole and by block, value by value and
+    // through countBetween; prints the first mismatch and returns false
+    bool checkEncodings()
+    {
+        const ColumnEncoding encodings[] = {ColumnEncoding::Raw, ColumnEncoding::Xor, ColumnEncoding::DeltaVarint, ColumnEncoding::FixedPoint};
+        bool ok = true;
+        for (ColumnEncoding encoding : encodings)
+        {
+            for (size_t count : {size_t(0), size_t(1), size_t(63), size_t(64), size_t(65), size_t(9 * 64 + 17)})
+            {
+                for (int decimals : {0, 2})
+                {
+                    std::vector<double> values = encodingInput(count, decimals, count * 3 + decimals);
+                    std::vector<std::uint8_t> encoded = encodeColumn(values.data(), count, encoding);
+                    CompressedColumn column(encoded.data(), encoded.size());
+                    std::vector<double> decoded(count), byBlock(count);
+                    column.decode(0, count, decoded.data());
+                    column.forEachBlock(1, count, [&](const double *block, size_t n, size_t position)
+                                        { std::copy(block, block + n, byBlock.begin() + position); });
+                    bool same = column.size() == count && std::equal(values.begin(), values.end(), decoded.begin(), sameValue);
+                    for (size_t i = 0; same && i < count; ++i)
+                    {
+                        // Backwards, so operator[] keeps switching blocks
+                        size_t j = count - 1 - i;
+                        same = sameValue(column[j], values[j]) && (j == 0 || sameValue(byBlock[j], values[j]));
+                    }
+                    same = same && column.countBetween(0, count, 999.5, 1000.5) == scanCountBetween(values.data(), count, 999.5, 1000.5) &&
+                           column.countBetween(0, count, -std::numeric_limits<double>::infinity(), 0) ==
+                               scanCountBetween(values.data(), count, -std::numeric_limits<double>::infinity(), 0);
+                    if (!same && ok)
+                    {
+                        std::printf("encoding %s does not round-trip: %zu values with %d decimals\n",
+                                    columnEncodingName(encoding), count, decimals);
+                    }
+                    ok &= same;
+                }
+            }
+        }
+        std::printf("column encodings: %s\n", ok ? "round-trip" : "MISMATCH");
+        return ok;
+    }
+
+    bool sameRows(const RowRange &a, const RowRange &b)
+    {
+        bool same = a.size() == b.size();
+        for (size_t i = 0; same && i < a.size(); ++i)
+        {
+            same = a[i].row() == b[i].row();
+        }
+        return same;
+    }
+
+    // Rows with NaN closes and volumes, added before and after the rankings are
+    // built and then partly erased: topK/bottomK and the by-volume order must
+    // keep agreeing with the filter engine's scan, which skips NaN
+    bool checkNanOrdering()
+    {
+        const double nan = std::numeric_limits<double>::quiet_NaN();
+        StockDatabase db;
+        std::vector<StockData> records;
+        auto add = [&](int ticker, int day, std::uint64_t seed)
+        {
+            std::string date = "2020-01-" + std::string(day < 10 ? "0" : "") + std::to_string(day);
+            double close = static_cast<double>(seed % 50) / 2;
+            double volume = static_cast<double>(seed % 7) * 1000;
+            records.push_back({date, "N" + std::to_string(ticker), close, close + 1, close - 1,
+                               seed % 5 == 0 ? nan : close, seed % 6 == 0 ? nan : volume, 0});
+        };
+        std::mt19937_64 random(99);
+        for (int ticker = 0; ticker < 12; ++ticker)
+        {
+            for (int day = 1; day <= 20; ++day)
+            {
+                add(ticker, day, random());
+            }
+        }
+        db.addStockRecords(records);
+
+        bool ok = true;
+        auto check = [&](const char *stage)
+        {
+            bool same = true;
+            for (StockField field : {StockField::Close, StockField::Volume})
+            {
+                RowFilter scan;
+                scan.useIndexShortcuts = false;
+                for (bool distinct : {false, true})
+                {
+                    same &= sameRows(db.topK(field, 15, distinct), db.topRows(scan, field, 15, true, distinct));
+                    same &= sameRows(db.bottomK(field, 15, distinct), db.topRows(scan, field, 15, false, distinct));
+                }
+            }
+            for (int day = 1; day <= 20; ++day)
+            {
+                std::string date = "2020-01-" + std::string(day < 10 ? "0" : "") + std::to_string(day);
+                DayNumber dayNumber;
+                parseDate(date, dayNumber);
+                RowFilter scan;
+                scan.on(dayNumber).useIndexShortcuts = false;
+                RowRange top = db.getTop10StocksByVolume(date);
+                RowRange expected = db.topRows(scan, StockField::Volume, 10, true, false);
+                // Query 13 breaks ties by ascending row, so compare the volumes
+                for (size_t i = 0; i < std::min(top.size(), expected.size()); ++i)
+                {
+                    same &= top[i].volume() == expected[i].volume();
+                }
+                // NaN volumes come after every number
+                for (size_t i = expected.size(); i < top.size(); ++i)
+                {
+                    same &= std::isnan(top[i].volume());
+                }
+            }
+            if (!same && ok)
+            {
+                std::printf("NaN ordering: rankings differ from the scan %s\n", stage);
+            }
+            ok &= same;
+        };
+        check("after loading");
+        records.clear();
+        for (int ticker = 0; ticker < 14; ++ticker)
+        {
+            add(ticker, 21 + ticker % 5, random());
+        }
+        for (const StockData &record : records)
+        {
+            db.insertRecord(record);
+        }
+        check("after inserts");
+        for (int ticker : {1, 4, 7, 13})
+        {
+            db.eraseTicker("N" + std::to_string(ticker));
+        }
+        check("after erasing");
+        std::printf("NaN ordering: %s\n", ok ? "consistent" : "MISMATCH");
+        return ok;
+    }
+
+    double consume(const RowRange &rows)
+    {
+        double total = 0;
+        for (RowRef row : rows)
+        {
+            total += row.close();
+        }
+        return total;
+    }
+
+    CompressionResult measureEncoding(const std::string &column, const std::string &order, const std::vector<double> &values,
+                                      const char *encoding, int repetitions, const std::vector<std::uint8_t> *encoded)
+    {
+        CompressionResult result;
+        result.column = column;
+        result.order = order;
+        result.encoding = encoding;
+        size_t n = values.size();
+        auto position = [n](size_t i)
+        { return (i * 2654435761u) % n; };
+        if (encoded == nullptr)
+        {
+            result.bytesPerValue = sizeof(double);
+            result.scanNsPerValue = measure("scan", repetitions, [&](size_t)
+                                            { sink = sink + scanSum(values.data(), n); })
+                                        .nsPerOp /
+                                    n;
+            result.lookupNs = measure("lookup", repetitions, [&](size_t i)
+                                      { sink = sink + values[position(i)]; })
+                                  .nsPerOp;
+            return result;
+        }
+        CompressedColumn packed(encoded->data(), encoded->size());
+        result.bytesPerValue = static_cast<double>(encoded->size()) / n;
+        result.scanNsPerValue = measure("scan", repetitions, [&](size_t)
+                                        { sink = sink + packed.sum(0, n); })
+                                    .nsPerOp /
+                                n;
+        result.lookupNs = measure("lookup", repetitions, [&](size_t i)
+                                  { sink = sink + packed[position(i)]; })
+                              .nsPerOp;
+        return result;
+    }
+
+    // A generated value as loadData stores it after the CSV round trip
+    double asLoaded(double value, int decimals)
+    {
+        char text[64];
+        std::snprintf(text, sizeof(text), "%.*f", decimals, value);
+        return std::strtod(text, nullptr);
+    }
+
+    // Every encoding on the generated close, volume and dividend columns, in
+    // file order (by date, then ticker) and grouped by ticker
+    std::vector<CompressionResult> measureCompression(const MarketDataOptions &options, int repetitions)
+    {
+        MarketDataGenerator generator(options);
+        size_t tickers = options.tickers;
+        size_t days = generator.days().size();
+        std::vector<std::vector<double>> byDate(3), byTicker(3, std::vector<double>(tickers * days));
+        StockData bar;
+        for (size_t row = 0; generator.next(bar); ++row)
+        {
+            double values[3] = {asLoaded(bar.close, 6), asLoaded(bar.volume, 0), asLoaded(bar.dividends, 2)};
+            for (size_t c = 0; c < 3; ++c)
+            {
+                byDate[c].push_back(values[c]);
+                byTicker[c][(row % tickers) * days + row / tickers] = values[c];
+            }
+        }
+
+        const char *columns[3] = {"close", "volume", "dividends"};
+        const ColumnEncoding encodings[] = {ColumnEncoding::Raw, ColumnEncoding::Xor, ColumnEncoding::DeltaVarint, ColumnEncoding::FixedPoint};
+        std::vector<CompressionResult> results;
+        for (size_t c = 0; c < 3; ++c)
+        {
+            for (const std::vector<double> *values : {&byDate[c], &byTicker[c]})
+            {
+                std::string order = values == &byDate[c] ? "date" : "ticker";
+                results.push_back(measureEncoding(columns[c], order, *values, "none", repetitions, nullptr));
+                for (ColumnEncoding encoding : encodings)
+                {
+                    std::vector<std::uint8_t> encoded = encodeColumn(values->data(), values->size(), encoding);
+                    results.push_back(measureEncoding(columns[c], order, *values, columnEncodingName(encoding), repetitions, &encoded));
+                }
+            }
+        }
+        return results;
+    }
+
+    std::vector<size_t> parseSizes(const char *text)
+    {
+        std::vector<size_t> sizes;
+        std::stringstream in(text);
+        std::string item;
+        while (std::getline(in, item, ','))
+        {
+            sizes.push_back(std::strtoul(item.c_str(), nullptr, 10));
+        }
+        return sizes;
+    }
+
+    bool parseArguments(int argc, char *argv[], Config &config)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            bool hasValue = i + 1 < argc;
+            if (std::strcmp(argv[i], "--tickers") == 0 && hasValue)
+            {
+                config.tickerCounts = parseSizes(argv[++i]);
+            }
+            else if (std::strcmp(argv[i], "--years") == 0 && hasValue)
+            {
+                config.data.years = std::atoi(argv[++i]);
+            }
+            else if (std::strcmp(argv[i], "--dividends") == 0 && hasValue)
+            {
+                config.data.dividendFrequency = std::strtod(argv[++i], nullptr);
+            }
+            else if (std::strcmp(argv[i], "--seed") == 0 && hasValue)
+            {
+                config.data.seed = std::strtoull(argv[++i], nullptr, 10);
+            }
+            else if (std::strcmp(argv[i], "--repetitions") == 0 && hasValue)
+            {
+                config.repetitions = std::max(1, std::atoi(argv[++i]));
+            }
+            else if (std::strcmp(argv[i], "--json") == 0 && hasValue)
+            {
+                config.jsonPath = argv[++i];
+            }
+            else if (std::strcmp(argv[i], "--check") == 0)
+            {
+                config.checkOnly = true;
+            }
+            else if (std::strcmp(argv[i], "--generate") == 0 && hasValue)
+            {
+                config.generatePath = argv[++i];
+            }
+            else
+            {
+                return false;
+            }
+        }
+        return !config.tickerCounts.empty() && config.data.years > 0;
+    }
+
+    SizeResult runSize(const Config &config, size_t tickers, const std::filesystem::path &directory)
+    {
+        SizeResult result;
+        result.tickers = tickers;
+        MarketDataOptions options = config.data;
+        options.tickers = tickers;
+        int reps = config.repetitions;
+
+        std::string csvPath = (directory / ("bench_" + std::to_string(tickers) + ".csv")).string();
+        std::string snapshotPath = csvPath + ".snapshot";
+        writeMarketDataCsv(csvPath, options);
+        result.csvBytes = std::filesystem::file_size(csvPath);
+
+        // Deterministic query arguments drawn from the generated tickers and days
+        MarketDataGenerator layout(options);
+        const std::vector<DayNumber> &days = layout.days();
+        result.rows = layout.rowCount();
+        constexpr size_t ARGUMENTS = 1024;
+        std::vector<std::string> tickerArgs, dateArgs, startArgs, endArgs;
+        std::vector<double> thresholds;
+        std::uint64_t state = options.seed;
+        auto draw = [&state](size_t bound)
+        {
+            state = state * 6364136223846793005ull + 1442695040888963407ull;
+            return static_cast<size_t>((state >> 33) % bound);
+        };
+        for (size_t i = 0; i < ARGUMENTS; ++i)
+        {
+            tickerArgs.push_back(MarketDataGenerator::tickerName(draw(tickers)));
+            dateArgs.push_back(formatDate(days[draw(days.size())]));
+            size_t first = draw(days.size());
+            size_t last = std::min(days.size() - 1, first + draw(252));
+            startArgs.push_back(formatDate(days[first]));
+            endArgs.push_back(formatDate(days[last]));
+            thresholds.push_back(static_cast<double>(draw(500)));
+        }
+        auto ticker = [&](size_t i) -> const std::string & { return tickerArgs[i % ARGUMENTS]; };
+        auto date = [&](size_t i) -> const std::string & { return dateArgs[i % ARGUMENTS]; };
+        auto startDate = [&](size_t i) -> const std::string & { return startArgs[i % ARGUMENTS]; };
+        auto endDate = [&](size_t i) -> const std::string & { return endArgs[i % ARGUMENTS]; };
+        auto threshold = [&](size_t i) { return thresholds[i % ARGUMENTS]; };
+
+        std::vector<Measurement> &out = result.measurements;
+        StockDatabase db;
+        {
+            QuietStdout quiet;
+            Measurement load = measureWithSetup(
+                "loadData", reps, 1, [&]()
+                { db = StockDatabase(); },
+                [&]()
+                { db.loadData(csvPath); });
+            load.bytesPerOp = static_cast<double>(result.csvBytes);
+            out.push_back(load);
+        }
+        out.push_back(measureWithSetup(
+            "saveSnapshot", reps, 1, []() {}, [&]()
+            { db.saveSnapshot(snapshotPath); }));
+        {
+            StockDatabase loaded;
+            Measurement load = measureWithSetup(
+                "loadSnapshot", reps, 1, [&]()
+                { loaded = StockDatabase(); },
+                [&]()
+                { loaded.loadSnapshot(snapshotPath); });
+            load.bytesPerOp = static_cast<double>(std::filesystem::file_size(snapshotPath));
+            out.push_back(load);
+        }
+
+        out.push_back(measure("getDataByDate", reps, [&](size_t i)
+                              { sink = sink + consume(db.getDataByDate(date(i))); }));
+        out.push_back(measure("getAverageClosePrice", reps, [&](size_t i)
+                              { sink = sink + db.getAverageClosePrice(ticker(i)); }));
+        out.push_back(measure("getAverageClosePrice(range)", reps, [&](size_t i)
+                              { sink = sink + db.getAverageClosePrice(ticker(i), startDate(i), endDate(i)); }));
+        out.push_back(measure("getHighestPriceInPeriod", reps, [&](size_t i)
+                              { sink = sink + db.getHighestPriceInPeriod(ticker(i), startDate(i), endDate(i)); }));
+        out.push_back(measure("getLowestPriceInPeriod", reps, [&](size_t i)
+                              { sink = sink + db.getLowestPriceInPeriod(ticker(i), startDate(i), endDate(i)); }));
+        out.push_back(measure("getAllUniqueTickers", reps, [&](size_t)
+                              { sink = sink + db.getAllUniqueTickers().size(); }));
+        out.push_back(measure("doesTickerExist", reps, [&](size_t i)
+                              { sink = sink + db.doesTickerExist(ticker(i)); }));
+        out.push_back(measure("countDatesAboveThreshold", reps, [&](size_t i)
+                              { sink = sink + db.countDatesAboveThreshold(threshold(i)); }));
+        out.push_back(measure("countDatesBelowThreshold", reps, [&](size_t i)
+                              { sink = sink + db.countDatesBelowThreshold(threshold(i)); }));
+        out.push_back(measure("countDatesBetweenThresholds", reps, [&](size_t i)
+                              { sink = sink + db.countDatesBetweenThresholds(threshold(i), threshold(i) + 50); }));
+        out.push_back(measure("getClosingPrice", reps, [&](size_t i)
+                              { sink = sink + db.getClosingPrice(ticker(i), date(i)).value_or(0); }));
+        out.push_back(measure("getDatesAndClosingPrices", reps, [&](size_t i)
+                              { sink = sink + consume(db.getDatesAndClosingPrices(ticker(i))); }));
+        out.push_back(measure("getTotalVolume", reps, [&](size_t i)
+                              { sink = sink + db.getTotalVolume(ticker(i)); }));
+        out.push_back(measure("getTotalVolume(range)", reps, [&](size_t i)
+                              { sink = sink + db.getTotalVolume(ticker(i), startDate(i), endDate(i)); }));
+        out.push_back(measure("getTotalDividends(range)", reps, [&](size_t i)
+                              { sink = sink + db.getTotalDividends(ticker(i), startDate(i), endDate(i)); }));
+        out.push_back(measure("doesDataExist", reps, [&](size_t i)
+                              { sink = sink + db.doesDataExist(ticker(i), date(i)); }));
+        out.push_back(measure("getOpeningAndClosingPrices", reps, [&](size_t i)
+                              { sink = sink + db.getOpeningAndClosingPrices(ticker(i), date(i)).value_or(std::make_pair(0.0, 0.0)).first; }));
+        out.push_back(measure("getDividend", reps, [&](size_t i)
+                              { sink = sink + db.getDividend(ticker(i), date(i)).value_or(0); }));
+        out.push_back(measure("getTop10StocksByVolume", reps, [&](size_t i)
+                              { sink = sink + consume(db.getTop10StocksByVolume(date(i))); }));
+        out.push_back(measure("getTopStocksOnDate(Close,10)", reps, [&](size_t i)
+                              { sink = sink + consume(db.getTopStocksOnDate(date(i), StockField::Close, 10)); }));
+        out.push_back(measure("getTopTickersByVolume(10)", reps, [&](size_t i)
+                              { sink = sink + db.getTopTickersByVolume(startDate(i), endDate(i), 10).size(); }));
+        out.push_back(measure("getBottom5StocksByClosingPrice", reps, [&](size_t)
+                              { sink = sink + consume(db.getBottom5StocksByClosingPrice()); }));
+        out.push_back(measure("getTop5StocksByDividends", reps, [&](size_t)
+                              { sink = sink + consume(db.getTop5StocksByDividends()); }));
+        out.push_back(measure("topK(High,100)", reps, [&](size_t)
+                              { sink = sink + consume(db.topK(StockField::High, 100)); }));
+        out.push_back(measure("bottomK(Volume,100,distinct)", reps, [&](size_t)
+                              { sink = sink + consume(db.bottomK(StockField::Volume, 100, true)); }));
+
+        // Queries 6, 13, 14 and 15 through the filter engine, then filters no single index answers
+        auto period = [&](size_t i)
+        {
+            DayNumber first = 0, last = 0;
+            parseDate(startDate(i), first);
+            parseDate(endDate(i), last);
+            return RowFilter().between(first, last);
+        };
+        out.push_back(measure("countDates(close>T)", reps, [&](size_t i)
+                              { sink = sink + db.countDates(RowFilter().above(StockField::Close, threshold(i))); }));
+        out.push_back(measure("topRows(date,Volume,10)", reps, [&](size_t i)
+                              {
+                                  DayNumber day = 0;
+                                  parseDate(date(i), day);
+                                  sink = sink + consume(db.topRows(RowFilter().on(day), StockField::Volume, 10)); }));
+        out.push_back(measure("topRows(Close,5,lowest,distinct)", reps, [&](size_t)
+                              { sink = sink + consume(db.topRows(RowFilter(), StockField::Close, 5, false, true)); }));
+        out.push_back(measure("topRows(Dividends,5)", reps, [&](size_t)
+                              { sink = sink + consume(db.topRows(RowFilter(), StockField::Dividends, 5)); }));
+        out.push_back(measure("countRows(dividend)", reps, [&](size_t)
+                              { sink = sink + db.countRows(RowFilter().withDividend()); }));
+        out.push_back(measure("countRows(close<T,volume>V)", reps, [&](size_t i)
+                              { sink = sink + db.countRows(RowFilter().below(StockField::Close, threshold(i)).above(StockField::Volume, 1e6)); }));
+        out.push_back(measure("aggregateRows(period,dividend,close<T)", reps, [&](size_t i)
+                              { sink = sink + db.aggregateRows(period(i).withDividend().below(StockField::Close, threshold(i)), StockField::Close).sum; }));
+        out.push_back(measure("topRows(period,close<T,Volume,10)", reps, [&](size_t i)
+                              { sink = sink + consume(db.topRows(period(i).below(StockField::Close, threshold(i)), StockField::Volume, 10)); }));
+
+        // Writes start from a copy of the loaded database every repetition
+        MarketDataOptions nextYear = options;
+        nextYear.startYear = options.startYear + options.years;
+        nextYear.years = 1;
+        MarketDataGenerator newBars(nextYear);
+        std::vector<StockData> records(std::min<size_t>(20000, newBars.rowCount()));
+        for (StockData &record : records)
+        {
+            newBars.next(record);
+        }
+        StockDatabase scratch;
+        {
+            QuietStdout quiet;
+            out.push_back(measureWithSetup(
+                "addStockRecord", reps, records.size(), [&]()
+                { scratch = db; },
+                [&]()
+                {
+                    for (const StockData &record : records)
+                    {
+                        scratch.addStockRecord(record);
+                    }
+                }));
+            out.push_back(measureWithSetup(
+                "addStockRecords", reps, records.size(), [&]()
+                { scratch = db; },
+                [&]()
+                { scratch.addStockRecords(records); }));
+
+            // Following the CSV as whole days of new bars are appended to it:
+            // each poll should cost the day's rows, not the loaded history
+            std::string followPath = csvPath + ".follow";
+            std::vector<std::string> dayLines;
+            for (size_t i = 0; i < records.size() && dayLines.size() <= 20; ++i)
+            {
+                const StockData &bar = records[i];
+                if (i == 0 || bar.date != records[i - 1].date)
+                {
+                    dayLines.emplace_back();
+                }
+                char line[160];
+                int length = std::snprintf(line, sizeof(line), "%s,%s,%.6f,%.6f,%.6f,%.6f,%.0f,%.2f\n", bar.date.c_str(),
+                                           bar.ticker.c_str(), bar.open, bar.high, bar.low, bar.close, bar.volume, bar.dividends);
+                dayLines.back().append(line, static_cast<size_t>(length));
+            }
+            dayLines.resize(std::min<size_t>(dayLines.size(), 20)); // the last day may be cut short
+            std::unique_ptr<CsvFollower> follower;
+            std::vector<CsvChunk> chunks;
+            out.push_back(measureWithSetup(
+                "followAppend(day)", reps, dayLines.size(), [&]()
+                {
+                    std::filesystem::copy_file(csvPath, followPath, std::filesystem::copy_options::overwrite_existing);
+                    follower = std::make_unique<CsvFollower>(followPath);
+                    scratch = StockDatabase();
+                    follower->poll(chunks);
+                    scratch.ingestChunks(chunks); },
+                [&]()
+                {
+                    for (const std::string &lines : dayLines)
+                    {
+                        std::ofstream(followPath, std::ios::binary | std::ios::app) << lines;
+                        follower->poll(chunks);
+                        scratch.ingestChunks(chunks);
+                    }
+                }));
+            follower.reset();
+            std::filesystem::remove(followPath);
+
+            size_t deletes = std::max<size_t>(1, std::min<size_t>(20, tickers / 10));
+            out.push_back(measureWithSetup(
+                "deleteTicker", reps, deletes, [&]()
+                { scratch = db; },
+                [&]()
+                {
+                    for (size_t i = 0; i < deletes; ++i)
+                    {
+                        scratch.deleteTicker(MarketDataGenerator::tickerName(i));
+                    }
+                }));
+        }
+
+        // Reads served from a cold segment holding every row, raw and compressed
+        std::string segmentPath = csvPath + ".cold";
+        result.memory = db.memoryUsage();
+        for (bool compress : {false, true})
+        {
+            std::string suffix = compress ? "(cold, compressed)" : "(cold)";
+            StockDatabase frozen = db;
+            out.push_back(measureWithSetup(
+                "freezeColdPartitions" + suffix, reps, 1, [&]()
+                { frozen = db; },
+                [&]()
+                { frozen.freezeColdPartitions(segmentPath, 0, compress); }));
+            (compress ? result.compressedSegmentBytes : result.coldSegmentBytes) = std::filesystem::file_size(segmentPath);
+            // Freezing drops the rankings, so the first ranked query builds them over the segment
+            StockDatabase ranked;
+            out.push_back(measureWithSetup(
+                "getBottom5StocksByClosingPrice" + suffix, reps, 1, [&]()
+                { ranked = frozen; },
+                [&]()
+                { sink = sink + consume(ranked.getBottom5StocksByClosingPrice()); }));
+            out.push_back(measure("getDataByDate" + suffix, reps, [&](size_t i)
+                                  { sink = sink + consume(frozen.getDataByDate(date(i))); }));
+            out.push_back(measure("getDatesAndClosingPrices" + suffix, reps, [&](size_t i)
+                                  { sink = sink + consume(frozen.getDatesAndClosingPrices(ticker(i))); }));
+            (compress ? result.compressedMemory : result.coldMemory) = frozen.memoryUsage();
+        }
+        std::filesystem::remove(segmentPath);
+        result.compression = measureCompression(options, reps);
+
+        std::filesystem::remove(csvPath);
+        std::filesystem::remove(snapshotPath);
+        result.peakRssKb = peakRssKb();
+        return result;
+    }
+
+    void printText(const SizeResult &result)
+    {
+        std::printf("\n%zu tickers, %zu rows, %.1f MB CSV, peak RSS %.1f MB\n", result.tickers, result.rows,
+                    result.csvBytes / 1048576.0, result.peakRssKb / 1024.0);
+        std::printf("  %-32s %14s %14s %14s\n", "operation", "ns/op", "best ns/op", "ops/s");
+        for (const Measurement &m : result.measurements)
+        {
+            std::printf("  %-32s %14.1f %14.1f %14.0f", m.name.c_str(), m.nsPerOp, m.bestNsPerOp, 1e9 / m.nsPerOp);
+            if (m.bytesPerOp > 0)
+            {
+                std::printf("  %.1f MB/s", m.bytesPerOp / 1048576.0 / (m.nsPerOp * 1e-9));
+            }
+            std::printf("\n");
+        }
+        std::printf("  cold segment of all rows: %.1f MB raw, %.1f MB compressed\n", result.coldSegmentBytes / 1048576.0,
+                    result.compressedSegmentBytes / 1048576.0);
+        std::printf("  %-10s %14s %14s %14s\n", "memory", "columns MB", "indexes MB", "mapped MB");
+        const char *states[] = {"in memory", "cold", "compressed"};
+        const MemoryUsage *usages[] = {&result.memory, &result.coldMemory, &result.compressedMemory};
+        for (size_t i = 0; i < 3; ++i)
+        {
+            std::printf("  %-10s %14.1f %14.1f %14.1f\n", states[i], usages[i]->columnBytes / 1048576.0,
+                        usages[i]->indexBytes / 1048576.0, usages[i]->mappedBytes / 1048576.0);
+        }
+        std::printf("  %-10s %-7s %-13s %10s %14s %14s\n", "column", "order", "encoding", "B/value", "scan ns/value", "lookup ns");
+        for (const CompressionResult &c : result.compression)
+        {
+            std::printf("  %-10s %-7s %-13s %10.2f %14.3f %14.1f\n", c.column.c_str(), c.order.c_str(), c.encoding.c_str(),
+                        c.bytesPerValue, c.scanNsPerValue, c.lookupNs);
+        }
+    }
+
+    std::string jsonString(const std::string &text)
+    {
+        std::string quoted = "\"";
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                quoted.push_back('\\');
+            }
+            quoted.push_back(c);
+        }
+        return quoted + "\"";
+    }
+
+    bool writeJson(const std::string &path, const Config &config, const std::vector<SizeResult> &results)
+    {
+        std::ofstream out(path);
+        if (!out)
+        {
+            return false;
+        }
+        out.setf(std::ios::fixed);
+        out.precision(1);
+        out << "{\n  \"benchmark\": \"StockAnalyzer\",\n  \"format\": 2,\n";
+        out << "  \"scan_kernel\": " << jsonString(scanKernelName(activeScanKernel())) << ",\n";
+        out << "  \"options\": {\"years\": " << config.data.years << ", \"start_year\": " << config.data.startYear
+            << ", \"dividend_frequency\": " << config.data.dividendFrequency << ", \"seed\": " << config.data.seed
+            << ", \"repetitions\": " << config.repetitions << "},\n";
+        out << "  \"sizes\": [\n";
+        for (size_t s = 0; s < results.size(); ++s)
+        {
+            const SizeResult &result = results[s];
+            out << "    {\"tickers\": " << result.tickers << ", \"rows\": " << result.rows << ", \"csv_bytes\": "
+                << result.csvBytes << ", \"peak_rss_kb\": " << result.peakRssKb << ",\n     \"results\": [\n";
+            for (size_t i = 0; i < result.measurements.size(); ++i)
+            {
+                const Measurement &m = result.measurements[i];
+                out << "       {\"name\": " << jsonString(m.name) << ", \"operations\": " << m.operations
+                    << ", \"ns_per_op\": " << m.nsPerOp << ", \"best_ns_per_op\": " << m.bestNsPerOp
+                    << ", \"ops_per_sec\": " << 1e9 / m.nsPerOp;
+                if (m.bytesPerOp > 0)
+                {
+                    out << ", \"mb_per_sec\": " << m.bytesPerOp / 1048576.0 / (m.nsPerOp * 1e-9);
+                }
+                out << "}" << (i + 1 < result.measurements.size() ? "," : "") << "\n";
+            }
+            out << "     ],\n     \"cold_segment_bytes\": " << result.coldSegmentBytes << ", \"compressed_segment_bytes\": "
+                << result.compressedSegmentBytes << ",\n     \"memory\": [\n";
+            const char *states[] = {"in_memory", "cold", "compressed"};
+            const MemoryUsage *usages[] = {&result.memory, &result.coldMemory, &result.compressedMemory};
+            for (size_t i = 0; i < 3; ++i)
+            {
+                out << "       {\"state\": " << jsonString(states[i]) << ", \"column_bytes\": " << usages[i]->columnBytes
+                    << ", \"index_bytes\": " << usages[i]->indexBytes << ", \"mapped_bytes\": " << usages[i]->mappedBytes << "}"
+                    << (i + 1 < 3 ? "," : "") << "\n";
+            }
+            out << "     ],\n     \"compression\": [\n";
+            out.precision(3);
+            for (size_t i = 0; i < result.compression.size(); ++i)
+            {
+                const CompressionResult &c = result.compression[i];
+                out << "       {\"column\": " << jsonString(c.column) << ", \"order\": " << jsonString(c.order)
+                    << ", \"encoding\": " << jsonString(c.encoding) << ", \"bytes_per_value\": " << c.bytesPerValue
+                    << ", \"scan_ns_per_value\": " << c.scanNsPerValue << ", \"lookup_ns\": " << c.lookupNs << "}"
+                    << (i + 1 < result.compression.size() ? "," : "") << "\n";
+            }
+            out.precision(1);
+            out << "     ]}" << (s + 1 < results.size() ? "," : "") << "\n";
+        }
+        out << "  ]\n}\n";
+        return static_cast<bool>(out);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Config config;
+    if (!parseArguments(argc, argv, config))
+    {
+        std::cerr << "Usage: " << argv[0]
+                  << " [--tickers N[,N...]] [--years Y] [--dividends PER_YEAR] [--seed S] [--repetitions R] [--json FILE]\n"
+                  << "       " << argv[0] << " --generate FILE [--tickers N] [--years Y] [--dividends PER_YEAR] [--seed S]\n"
+                  << "       " << argv[0] << " --check\n";
+        return 1;
+    }
+
+    if (!config.generatePath.empty())
+    {
+        config.data.tickers = config.tickerCounts.front();
+        if (!writeMarketDataCsv(config.generatePath, config.data))
+        {
+            std::cerr << "Could not write " << config.generatePath << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    if (!checkScanKernels() || !checkEncodings() || !checkNanOrdering())
+    {
+        return 1;
+    }
+    if (config.checkOnly)
+    {
+        return 0;
+    }
+
+    std::printf("scan kernel: %s\n", scanKernelName(activeScanKernel()));
+    std::vector<size_t> sizes = config.tickerCounts;
+    std::sort(sizes.begin(), sizes.end()); // peak RSS only grows, so go from small to large
+    std::vector<SizeResult> results;
+    for (size_t tickers : sizes)
+    {
+        results.push_back(runSize(config, tickers, std::filesystem::temp_directory_path()));
+        printText(results.back());
+    }
+
+    if (!config.jsonPath.empty() && !writeJson(config.jsonPath, config, results))
+    {
+        std::cerr << "Could not write " << config.jsonPath << std::endl;
+        return 1;
+    }
+    return 0;
+}
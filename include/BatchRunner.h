@@ -0,0 +1,54 @@
+#pragma once
+
+#include "StockDatabase.h"
+#include "RowFilter.h"
+#include <iosfwd>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// One line of a batch file: the menu number of a query followed by its inputs,
+// whitespace separated, in the order the interactive menu asks for them:
+//
+//   1 DATE                  7 TICKER DATE          13 DATE
+//   2 TICKER                8 TICKER               14
+//   3 TICKER START END      9 TICKER               15
+//   4                       10 TICKER DATE         16 DATE TICKER OPEN HIGH LOW CLOSE VOLUME DIVIDENDS
+//   5 TICKER                11 TICKER DATE         17 TICKER
+//   6 THRESHOLD             12 TICKER DATE         18 text|json  (latency and counters so far)
+//                                                  19 TICKER sma|ema|vwap|return|volatility WINDOW
+//                                                  20 START END PAIRS  (most correlated ticker pairs)
+//                                                  21 OUTPUT CONDITION...  (filter query, see RowFilter.h)
+//                                                  0  (stop reading)
+//
+// Blank lines and lines starting with '#' are ignored.
+struct BatchQuery
+{
+    int choice = -1;
+    size_t line = 0;
+    std::vector<std::string> args;
+    double threshold = 0;                      // query 6
+    StockData record;                          // query 16
+    RollingMetric metric = RollingMetric::Sma; // query 19
+    size_t count = 0;                          // window of query 19, pairs of query 20
+    FilterQuery filter;                        // query 21
+};
+
+// Returns false (and leaves an explanation in `error`) for a malformed line
+bool parseBatchQuery(std::string_view text, BatchQuery &query, std::string &error);
+
+class BufferedWriter;
+
+// Result text of a filter query (21), the same for the menu and batch files
+void writeFilterResult(const StockDatabase &db, const FilterQuery &query, BufferedWriter &writer);
+
+// Queries 16 and 17 modify the database and 18 reports on everything before it;
+// every other query only reads it
+bool isReadOnlyQuery(int choice);
+
+// Run every query read from `in` and write the results to `out` in input order.
+// Consecutive read-only queries run in parallel on a work-stealing pool of
+// `threadCount` threads (0 = hardware concurrency); a write waits for the
+// queries before it and runs alone, so later queries see its effect. A run of
+// consecutive adds is applied as one bulk insert.
+void runBatch(StockDatabase &db, std::istream &in, std::ostream &out, unsigned threadCount = 0);
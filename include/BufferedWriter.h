@@ -0,0 +1,50 @@
+#pragma once
+
+#include "DateUtils.h"
+#include <ostream>
+#include <string>
+#include <string_view>
+
+// Collects formatted output in one buffer and hands it to the stream in large
+// writes. Doubles are formatted like the default std::ostream (%g, 6 digits).
+// Without a stream the writer only captures; take() returns the text.
+class BufferedWriter
+{
+private:
+    std::ostream *out = nullptr;
+    std::string buffer;
+    static constexpr size_t FLUSH_BYTES = 64 * 1024;
+
+    void flushIfFull()
+    {
+        if (out != nullptr && buffer.size() >= FLUSH_BYTES)
+        {
+            flush();
+        }
+    }
+
+public:
+    BufferedWriter() = default;
+    explicit BufferedWriter(std::ostream &out) : out(&out) { buffer.reserve(FLUSH_BYTES + 256); }
+    ~BufferedWriter() { flush(); }
+    BufferedWriter(const BufferedWriter &) = delete;
+    BufferedWriter &operator=(const BufferedWriter &) = delete;
+
+    BufferedWriter &operator<<(std::string_view text);
+    BufferedWriter &operator<<(char c);
+    BufferedWriter &operator<<(double value);
+    BufferedWriter &operator<<(long long value);
+    BufferedWriter &operator<<(int value) { return *this << static_cast<long long>(value); }
+    BufferedWriter &operator<<(size_t value);
+    BufferedWriter &operator<<(const DateText &date) { return *this << date.view(); }
+    BufferedWriter &operator<<(const char *text) { return *this << std::string_view(text); }
+    BufferedWriter &operator<<(const std::string &text) { return *this << std::string_view(text); }
+
+    void flush();
+    std::string take()
+    {
+        std::string text = std::move(buffer);
+        buffer.clear();
+        return text;
+    }
+};
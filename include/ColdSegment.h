@@ -0,0 +1,61 @@
+#pragma once
+
+#include "StockColumns.h"
+#include "CompressedColumn.h"
+#include "MappedFile.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Cold segment layout (native endianness, every section padded to 8 bytes):
+//   ColdSegmentHeader
+//   ticker id column    uint32[rowCount]
+//   date column         int32[rowCount]
+//   open .. dividends   double[rowCount], one section per column; in a
+//                       compressed segment a uint64 byte count followed by
+//                       the column as encodeColumn writes it
+//   index tables        double[tableCount], the ticker series' tables over
+//                       these rows (see TickerSeries::freeze)
+// A segment is mapped by the process that wrote it, so it carries no checksum.
+struct ColdSegmentHeader
+{
+    char magic[8];
+    std::uint64_t rowCount;
+    std::uint64_t compressed;
+    std::uint64_t tableCount;
+};
+
+constexpr char COLD_SEGMENT_MAGIC[8] = {'S', 'T', 'K', 'C', 'O', 'L', 'D', '\0'};
+
+// Rows [begin, end) of the database all fall in `month` (see monthOf())
+struct ColdMonthRun
+{
+    int month;
+    RowIndex begin;
+    RowIndex end;
+};
+
+// A mapped file backing cold rows: a cold segment, with views of its double
+// columns when they are compressed, or a snapshot whose columns are read in place
+struct ColdSegment
+{
+    MappedFile file;
+    CompressedColumn packed[6]; // open .. dividends
+    const double *tables = nullptr; // the index tables written with a cold segment
+    std::vector<ColdMonthRun> months; // its rows by month, in row order
+
+    explicit ColdSegment(const std::string &filename) : file(filename, AccessPattern::Random) {}
+};
+
+// Runs of consecutive rows in one month over `count` days, the first at row `firstRow`
+std::vector<ColdMonthRun> monthRuns(const DayNumber *days, size_t count, RowIndex firstRow);
+
+// Serve the first `rowCount` in-memory rows of `columns` (the rows from
+// coldRows() on) from a new segment written to `filename`; earlier segments
+// are left as they are, and row positions do not change. With `compress`
+// prices are stored as fixed-point deltas and volumes as integer deltas (see
+// CompressedColumn.h). `tables` are stored after the columns and mapped as
+// the segment's `tables`. Returns false and leaves `columns` untouched when
+// the segment cannot be written or mapped.
+bool moveToColdSegment(StockColumns &columns, size_t rowCount, const std::string &filename, bool compress,
+                       const std::vector<double> &tables);
@@ -0,0 +1,222 @@
+#pragma once
+
+#include "CompressedColumn.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// One column of StockColumns. The first coldSize() values may live in
+// read-only mapped segments (see ColdSegment.h), one part per segment, raw
+// or, for doubles, compressed; the rest are kept in memory and are the only
+// part that grows. TickerSeries keeps its tables in columns too, so their
+// frozen part is mapped the same way.
+template <typename T>
+class Column
+{
+private:
+    struct ColdPart
+    {
+        const T *raw = nullptr;
+        const CompressedColumn *packed = nullptr; // replaces `raw` when the part is compressed
+        size_t first = 0;                         // row of its first value
+        size_t count = 0;
+    };
+
+    std::vector<ColdPart> parts; // in row order
+    size_t coldCount = 0;
+    std::vector<T> hot;
+
+    const ColdPart &partOf(size_t i) const
+    {
+        if (parts.size() == 1)
+        {
+            return parts.front();
+        }
+        return *(std::upper_bound(parts.begin(), parts.end(), i, [](size_t row, const ColdPart &part)
+                                  { return row < part.first; }) -
+                 1);
+    }
+
+    T coldValue(size_t i) const
+    {
+        const ColdPart &part = partOf(i);
+        if constexpr (std::is_same_v<T, double>)
+        {
+            if (part.packed != nullptr)
+            {
+                return (*part.packed)[i - part.first];
+            }
+        }
+        return part.raw[i - part.first];
+    }
+
+public:
+    size_t size() const { return coldCount + hot.size(); }
+    size_t coldSize() const { return coldCount; }
+    bool isPacked() const
+    {
+        return std::any_of(parts.begin(), parts.end(), [](const ColdPart &part)
+                           { return part.packed != nullptr; });
+    }
+    T operator[](size_t i) const { return i < coldCount ? coldValue(i) : hot[i - coldCount]; }
+
+    const std::vector<T> &hotValues() const { return hot; }
+    // Only index tables change values in place; StockColumns' values never do
+    std::vector<T> &hotValues() { return hot; }
+
+    // fn(values, n, firstRow) over the rows [first, last) in contiguous runs;
+    // compressed rows are decoded a block at a time
+    template <typename Fn>
+    void forEachBlock(size_t first, size_t last, Fn fn) const
+    {
+        for (const ColdPart &part : parts)
+        {
+            size_t partLast = std::min(last, part.first + part.count);
+            if (first >= partLast)
+            {
+                continue;
+            }
+            if constexpr (std::is_same_v<T, double>)
+            {
+                if (part.packed != nullptr)
+                {
+                    part.packed->forEachBlock(first - part.first, partLast - part.first,
+                                              [&fn, &part](const double *values, size_t n, size_t position)
+                                              { fn(values, n, part.first + position); });
+                    first = partLast;
+                    continue;
+                }
+            }
+            fn(part.raw + (first - part.first), partLast - first, first);
+            first = partLast;
+        }
+        if (first < last)
+        {
+            fn(hot.data() + (first - coldCount), last - first, first);
+        }
+    }
+
+    // Every value in row order, decoded
+    std::vector<T> values() const
+    {
+        std::vector<T> all(size());
+        forEachBlock(0, size(), [&all](const T *run, size_t n, size_t row)
+                     { std::memcpy(all.data() + row, run, n * sizeof(T)); });
+        return all;
+    }
+
+    // Room for `rows` rows in all. Capacity at least doubles when it has to
+    // grow, so reserving ahead of every small append (a followed file's new
+    // lines) does not copy the whole column each time.
+    void reserve(size_t rows)
+    {
+        size_t needed = rows > coldCount ? rows - coldCount : 0;
+        if (needed > hot.capacity())
+        {
+            hot.reserve(std::max(needed, hot.capacity() * 2));
+        }
+    }
+    void push_back(T value) { hot.push_back(value); }
+
+    void append(const Column &other)
+    {
+        reserve(size() + other.size());
+        other.forEachBlock(0, other.coldCount, [this](const T *run, size_t n, size_t)
+                           { hot.insert(hot.end(), run, run + n); });
+        hot.insert(hot.end(), other.hot.begin(), other.hot.end());
+    }
+
+    // Replace the contents with a copy of [first, last), all in memory
+    void assign(const T *first, const T *last)
+    {
+        parts.clear();
+        coldCount = 0;
+        hot.assign(first, last);
+    }
+
+    // Replace the contents with the values at `rows`, all in memory
+    void gather(const std::vector<std::uint32_t> &rows)
+    {
+        // Compressed rows are decoded once rather than a block per row
+        std::vector<T> decoded = isPacked() ? values() : std::vector<T>();
+        std::vector<T> picked;
+        picked.reserve(rows.size());
+        for (std::uint32_t row : rows)
+        {
+            picked.push_back(isPacked() ? decoded[row] : (*this)[row]);
+        }
+        parts.clear();
+        coldCount = 0;
+        hot = std::move(picked);
+    }
+
+    // Keep the cold values and replace the in-memory ones with the values at
+    // `rows`, none of them cold
+    void gatherHot(const std::vector<std::uint32_t> &rows)
+    {
+        std::vector<T> picked;
+        picked.reserve(rows.size());
+        for (std::uint32_t row : rows)
+        {
+            picked.push_back(hot[row - coldCount]);
+        }
+        hot = std::move(picked);
+    }
+
+    // `count` mapped values follow the cold ones; only while no value is in
+    // memory. The mapping must outlive the column (StockColumns keeps it alive).
+    void attach(const T *mapped, size_t count)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+        parts.push_back({mapped, nullptr, coldCount, count});
+        coldCount += count;
+    }
+
+    // The first `count` in-memory values become cold, read from `mapped`
+    // from now on, which holds the same values; their memory is released
+    void freeze(const T *mapped, size_t count)
+    {
+        hot.erase(hot.begin(), hot.begin() + static_cast<std::ptrdiff_t>(count));
+        hot.shrink_to_fit();
+        attach(mapped, count);
+    }
+
+    void freeze(const CompressedColumn *mapped)
+    {
+        hot.erase(hot.begin(), hot.begin() + static_cast<std::ptrdiff_t>(mapped->size()));
+        hot.shrink_to_fit();
+        parts.push_back({nullptr, mapped, coldCount, mapped->size()});
+        coldCount += mapped->size();
+    }
+};
+
+// Many scattered reads of one column, e.g. every row of a ranking in value
+// order. A cold read finds its part and may fault in a released page or, when
+// compressed, decode its whole block, so a column with cold rows is copied
+// (decoded) once up front and read from that copy; otherwise the reads go
+// straight to the in-memory values.
+template <typename T>
+class ColumnReader
+{
+private:
+    const Column<T> *column;
+    std::vector<T> decoded;
+
+public:
+    explicit ColumnReader(const Column<T> &column) : column(&column)
+    {
+        if (column.coldSize() > 0)
+        {
+            decoded = column.values();
+        }
+    }
+
+    T operator[](size_t i) const { return decoded.empty() ? column->hotValues()[i] : decoded[i]; }
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// How encodeColumn packs a block of doubles
+enum class ColumnEncoding
+{
+    Raw,         // 8 bytes per value
+    Xor,         // Gorilla: each value XORed with the previous one, only the changed bits are stored
+    DeltaVarint, // integers: zigzag varint of the difference to the previous value
+    FixedPoint   // like DeltaVarint on value * 10^d, with the fewest decimals d that round-trip exactly
+};
+
+const char *columnEncodingName(ColumnEncoding encoding);
+
+// Encoded layout (native endianness):
+//   uint64 count
+//   uint64 offsets[blockCount + 1]   byte offset of each block inside the payload
+//   payload                          per block: a tag byte, then the block's values
+//   8 zero bytes, then padding to a multiple of 8
+// Every block of BLOCK values is encoded on its own, so reading a value
+// decodes at most one block. Encoding is lossless: a block the requested
+// encoding cannot hold exactly falls back to Xor, and a block that would not
+// shrink is stored raw.
+std::vector<std::uint8_t> encodeColumn(const double *values, size_t count, ColumnEncoding encoding);
+
+// Read-only view of an encoded column; the bytes must outlive it
+class CompressedColumn
+{
+public:
+    static constexpr size_t BLOCK = 64;
+
+private:
+    const std::uint8_t *encoded = nullptr;
+    const std::uint8_t *payload = nullptr;
+    size_t count = 0;
+    size_t byteCount = 0;
+    std::uint64_t id = 0; // tells views apart in the per-thread block cache
+
+    size_t blockOffset(size_t block) const;
+    // Decode the first `limit` values of `block` into `out`
+    void decodeBlock(size_t block, size_t limit, double *out) const;
+
+public:
+    CompressedColumn() = default;
+    // `size` bytes produced by encodeColumn; an empty view when they are malformed
+    CompressedColumn(const std::uint8_t *data, size_t size);
+
+    size_t size() const { return count; }
+    size_t bytes() const { return byteCount; }
+    // Keeps the block it decodes in a per-thread cache, so reading the rows of
+    // a block one by one decodes it once
+    double operator[](size_t i) const;
+    void decode(size_t first, size_t n, double *out) const;
+
+    // fn(values, n, position) for [first, last), one decoded block at a time
+    template <typename Fn>
+    void forEachBlock(size_t first, size_t last, Fn fn) const
+    {
+        double buffer[BLOCK];
+        while (first < last)
+        {
+            size_t block = first / BLOCK;
+            size_t end = std::min(last, (block + 1) * BLOCK);
+            decodeBlock(block, end - block * BLOCK, buffer);
+            fn(buffer + (first - block * BLOCK), end - first, first);
+            first = end;
+        }
+    }
+
+    // Scan kernels over [first, last), run on each decoded block
+    double sum(size_t first, size_t last) const;
+    double max(size_t first, size_t last) const;
+    double min(size_t first, size_t last) const;
+    size_t countBetween(size_t first, size_t last, double lower, double upper) const;
+};
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "ConcurrentStockDatabase.h"
+
+// Run `readerCount` threads issuing all read-only queries (menu 1-15) against
+// `db` for `seconds`, while one writer keeps adding and deleting tickers.
+// Every read cross-checks several queries against the same point-in-time view.
+// Prints a summary and returns the number of inconsistencies found.
+size_t runConcurrencyStress(ConcurrentStockDatabase &db, unsigned readerCount, double seconds);
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "Instrumentation.h"
+#include "StockDatabase.h"
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// StockDatabase shared by concurrent readers and writers (left-right scheme).
+//
+// Two copies of the database are kept. Readers use whichever copy is
+// published and never block: entering and leaving a read is one atomic
+// increment and decrement. Writers are serialized; a write is applied to the
+// unpublished copy, that copy is published, the writer waits for readers still
+// on the old copy to leave, and then applies the same write to it.
+//
+// Every read sees one consistent point-in-time state. Results that point into
+// the database (RowRange, string_view) are only valid inside the read callback.
+// The price is twice the memory of a single StockDatabase and every write
+// being done twice. Instrumentation records each write once, timed across both
+// applications.
+class ConcurrentStockDatabase
+{
+private:
+    // Count of readers that entered through one version slot, on its own cache line
+    struct alignas(64) ReadIndicator
+    {
+        std::atomic<long> readers{0};
+    };
+
+    StockDatabase instances[2];
+    std::atomic<int> published{0};    // instance readers use
+    std::atomic<int> versionIndex{0}; // read indicator new readers register with
+    mutable ReadIndicator indicators[2];
+    std::mutex writerMutex;
+
+    void waitForReaders(int version) const;
+    void toggleVersionAndWait();
+    // Apply `write` to both copies, recorded once as `operation`; returns what
+    // the first application returned
+    template <typename Write>
+    auto writeBoth(Operation operation, Write write) -> decltype(write(instances[0]));
+
+public:
+    // Run `read` against the current point-in-time view and return its result
+    template <typename Read>
+    auto read(Read read) const -> decltype(read(instances[0]))
+    {
+        int version = versionIndex.load();
+        indicators[version].readers.fetch_add(1);
+        struct Leave
+        {
+            std::atomic<long> &readers;
+            ~Leave() { readers.fetch_sub(1); }
+        } leave{indicators[version].readers};
+        return read(static_cast<const StockDatabase &>(instances[published.load()]));
+    }
+
+    void loadData(const std::string &filename);
+    bool loadSnapshot(const std::string &filename);
+    bool saveSnapshot(const std::string &filename) const;
+    bool insertRecord(const StockData &record);
+    size_t addStockRecords(const std::vector<StockData> &records);
+    bool eraseTicker(std::string_view ticker);
+    void compact();
+    void setCompactionRatio(double ratio);
+};
+
+template <typename Write>
+auto ConcurrentStockDatabase::writeBoth(Operation operation, Write write) -> decltype(write(instances[0]))
+{
+    std::lock_guard<std::mutex> lock(writerMutex);
+    OperationTimer timer(operation);
+    int current = published.load();
+    auto result = [&]
+    {
+        // The first application's counters stand for the write; its latency is the timer's
+        InstrumentationPause pause(false);
+        return write(instances[1 - current]);
+    }();
+    published.store(1 - current);
+    toggleVersionAndWait();
+    {
+        InstrumentationPause pause(true);
+        write(instances[current]);
+    }
+    return result;
+}
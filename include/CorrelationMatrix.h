@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// One-bar returns of several tickers on a shared date axis, demeaned, one row
+// per ticker (row-major, `days` values each)
+struct ReturnMatrix
+{
+    size_t tickers = 0;
+    size_t days = 0;
+    std::vector<double> values;
+
+    const double *row(size_t i) const { return values.data() + i * days; }
+};
+
+// Covariance of every pair of rows: N x N, row-major
+std::vector<double> covarianceMatrix(const ReturnMatrix &returns, unsigned threadCount = 0);
+
+struct PairScore
+{
+    size_t first;  // rows of the ReturnMatrix, first < second
+    size_t second;
+    double correlation;
+    double covariance;
+};
+
+// The `n` pairs with the highest correlation (ties by row), computed tile by
+// tile without materializing the N x N matrix. Rows with zero variance are skipped.
+std::vector<PairScore> topCorrelatedPairs(const ReturnMatrix &returns, size_t n, unsigned threadCount = 0);
+
+// Pairwise return covariance and correlation of a set of tickers over a period
+class CorrelationMatrix
+{
+private:
+    std::vector<std::string_view> names;
+    std::vector<double> covariances;
+    size_t observations = 0;
+
+public:
+    CorrelationMatrix() = default;
+    CorrelationMatrix(std::vector<std::string_view> names, std::vector<double> covariances, size_t observations)
+        : names(std::move(names)), covariances(std::move(covariances)), observations(observations) {}
+
+    size_t size() const { return names.size(); }
+    std::string_view ticker(size_t i) const { return names[i]; }
+    size_t returnCount() const { return observations; } // returns per ticker the matrix was computed from
+    double covariance(size_t i, size_t j) const { return covariances[i * names.size() + j]; }
+
+    // 0 when either ticker's returns have zero variance
+    double correlation(size_t i, size_t j) const;
+};
+
+// A pair of tickers from StockDatabase::getTopCorrelatedPairs
+struct CorrelatedPair
+{
+    std::string_view first;
+    std::string_view second;
+    double correlation;
+    double covariance;
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "CsvLoader.h"
+#include <string>
+#include <vector>
+
+// Follows a CSV file that keeps being appended to. The byte offset of the
+// first unread line is remembered, and each poll parses only the complete
+// lines written since the previous one; a trailing partial line waits for its
+// newline. The first poll reads the whole file (header skipped).
+class CsvFollower
+{
+private:
+    std::string filename;
+    size_t offset = 0;
+    int inotifyFd = -1; // -1 when inotify is unavailable: every wait just sleeps
+    int watch = -1;
+    bool replaced = false; // the watched file was moved or deleted
+    bool restarted = false; // the last poll read from the start of the file
+
+    void addWatch();
+
+public:
+    explicit CsvFollower(std::string filename);
+    ~CsvFollower();
+
+    CsvFollower(const CsvFollower &) = delete;
+    CsvFollower &operator=(const CsvFollower &) = delete;
+
+    // Parse the newly appended complete lines into `chunks` (empty when there
+    // are none). Returns false when the file cannot be opened. A file that was
+    // replaced (or shrank) is followed again from its start, see fromStart.
+    bool poll(std::vector<CsvChunk> &chunks, unsigned threadCount = 0);
+    // True when the last poll read the file from its start (the first poll, or
+    // the file was replaced): its rows replace everything read before
+    bool fromStart() const { return restarted; }
+
+    // Wait up to `timeoutMs` (0 = just check) for the file to be written to.
+    // Returns true when it may have grown; without inotify it sleeps and returns true.
+    bool waitForAppend(int timeoutMs);
+
+    size_t position() const { return offset; }
+};
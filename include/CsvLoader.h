@@ -0,0 +1,29 @@
+#pragma once
+
+#include "StockColumns.h"
+#include <string>
+#include <vector>
+
+// Rows parsed from one newline-aligned slice of a CSV file. Ticker ids in
+// `columns` are local to the chunk until it is merged into a database.
+struct CsvChunk
+{
+    StockColumns columns;
+    std::vector<std::vector<RowIndex>> tickerRows; // partial tickerMap, by local ticker id
+    std::string errors;                            // skipped-line messages, in file order
+};
+
+struct CsvParseResult
+{
+    bool opened = false;
+    size_t bytes = 0;
+    std::vector<CsvChunk> chunks; // in file order
+};
+
+// Parse CSV data lines (no header) in [begin, end) on `threadCount` threads
+// (0 = hardware concurrency), split at newlines into one chunk per thread
+std::vector<CsvChunk> parseCsvText(const char *begin, const char *end, unsigned threadCount = 0);
+
+// Memory-map `filename` and parse it in parallel on `threadCount` threads
+// (0 = hardware concurrency). The header line is skipped.
+CsvParseResult parseCsvFile(const std::string &filename, unsigned threadCount = 0);
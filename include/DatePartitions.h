@@ -0,0 +1,70 @@
+#pragma once
+
+#include "StockColumns.h"
+#include "StockField.h"
+#include <array>
+#include <cstddef>
+#include <limits>
+#include <utility>
+#include <vector>
+
+// Metadata of the rows of one calendar month. The field bounds only widen
+// between rebuilds, so after deletes they may be loose, but they never
+// exclude a live row.
+struct DatePartition
+{
+    static constexpr size_t FIELD_COUNT = 6;
+
+    int month = 0;               // see monthOf()
+    std::vector<DayNumber> days; // dates with rows, ascending
+    size_t rows = 0;             // live rows
+    std::array<double, FIELD_COUNT> minimum; // by StockField
+    std::array<double, FIELD_COUNT> maximum;
+    // Its rows inside cold segments, one [begin, end) span per segment holding any
+    std::vector<std::pair<RowIndex, RowIndex>> coldSpans;
+
+    DatePartition()
+    {
+        minimum.fill(std::numeric_limits<double>::infinity());
+        maximum.fill(-std::numeric_limits<double>::infinity());
+    }
+
+    DayNumber firstDay() const { return days.front(); }
+    DayNumber lastDay() const { return days.back(); }
+    bool isCold() const { return !coldSpans.empty(); }
+};
+
+// The rows partitioned by month, ordered by month, so date-bounded queries can
+// skip the months outside their period
+class DatePartitions
+{
+private:
+    std::vector<DatePartition> partitions;
+
+    DatePartition *find(DayNumber day);
+
+public:
+    size_t size() const { return partitions.size(); }
+    const DatePartition &operator[](size_t i) const { return partitions[i]; }
+    void clear() { partitions.clear(); }
+    // Adopt partitions saved in a snapshot, ordered by month
+    void assign(std::vector<DatePartition> restored) { partitions = std::move(restored); }
+
+    void addDay(DayNumber day);    // `day` got its first row; call before addRow for it
+    void removeDay(DayNumber day); // `day` lost its last row; drops a partition left without dates
+    void addRow(const StockColumns &columns, RowIndex row);
+    // addRow for every live row, a column at a time, so each compressed block
+    // is decoded once rather than once per row and field
+    void addRows(const StockColumns &columns);
+    void removeRow(const StockColumns &columns, RowIndex row);
+    // Record which rows of each partition the cold segments hold
+    void setColdRows(const StockColumns &columns);
+
+    // Positions [first, last) of the partitions with dates in [startDay, endDay]
+    std::pair<size_t, size_t> overlapping(DayNumber startDay, DayNumber endDay) const;
+    bool overlaps(DayNumber startDay, DayNumber endDay) const;
+    // False when no partition can hold `day`
+    bool mayContain(DayNumber day) const;
+    // Dates in [startDay, endDay] with rows, ascending
+    std::vector<DayNumber> daysBetween(DayNumber startDay, DayNumber endDay) const;
+};
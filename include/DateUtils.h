@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Dates are stored as days since 1970-01-01 so they compare and hash as integers
+using DayNumber = std::int32_t;
+
+// Parse "YYYY-MM-DD" (an optional trailing time part is ignored). Returns false on malformed input.
+bool parseDate(std::string_view text, DayNumber &day);
+
+// Fixed-size "YYYY-MM-DD" text, formatted without touching the heap
+struct DateText
+{
+    char chars[10];
+    std::string_view view() const { return std::string_view(chars, sizeof(chars)); }
+};
+
+// Format a day number back to "YYYY-MM-DD"
+DateText formatDateText(DayNumber day);
+std::string formatDate(DayNumber day);
+
+// Calendar month of a day as year * 12 + (month - 1), and the first day of such a month
+int monthOf(DayNumber day);
+DayNumber firstDayOfMonth(int month);
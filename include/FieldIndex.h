@@ -0,0 +1,298 @@
+#pragma once
+
+#include "RowBitmap.h"
+#include "StockField.h"
+#include "TickerSeries.h"
+#include <algorithm>
+#include <vector>
+
+// Rows kept in ascending order of one field. Rows live in sorted blocks of
+// bounded size, so an insert or erase is a binary search plus a short memmove
+// and walking the K smallest or largest rows touches only K entries.
+template <StockField F>
+class FieldIndex
+{
+private:
+    static constexpr size_t MAX_BLOCK = 512;
+    std::vector<std::vector<RowIndex>> blocks; // non-empty, concatenation is sorted
+
+    // First block whose last row does not order before `row`
+    size_t findBlock(RowIndex row, const FieldComparator<F> &less) const
+    {
+        auto it = std::lower_bound(blocks.begin(), blocks.end(), row, [&less](const std::vector<RowIndex> &block, RowIndex r)
+                                   { return less(block.back(), r); });
+        return it - blocks.begin();
+    }
+
+public:
+    // `values` reads the field (see ColumnReader)
+    void assign(std::vector<RowIndex> rows, const ColumnReader<double> &values)
+    {
+        std::sort(rows.begin(), rows.end(), ReaderComparator<>{&values});
+        blocks.clear();
+        for (size_t i = 0; i < rows.size(); i += MAX_BLOCK / 2)
+        {
+            blocks.emplace_back(rows.begin() + i, rows.begin() + std::min(rows.size(), i + MAX_BLOCK / 2));
+        }
+    }
+
+    void insert(RowIndex row, const StockColumns &columns)
+    {
+        FieldComparator<F> less{&columns};
+        if (blocks.empty())
+        {
+            blocks.push_back({row});
+            return;
+        }
+        size_t b = std::min(findBlock(row, less), blocks.size() - 1);
+        std::vector<RowIndex> &block = blocks[b];
+        block.insert(std::lower_bound(block.begin(), block.end(), row, less), row);
+        if (block.size() > MAX_BLOCK)
+        {
+            std::vector<RowIndex> upper(block.begin() + MAX_BLOCK / 2, block.end());
+            block.resize(MAX_BLOCK / 2);
+            blocks.insert(blocks.begin() + b + 1, std::move(upper));
+        }
+    }
+
+    void erase(RowIndex row, const StockColumns &columns)
+    {
+        FieldComparator<F> less{&columns};
+        size_t b = findBlock(row, less);
+        if (b == blocks.size())
+        {
+            return;
+        }
+        std::vector<RowIndex> &block = blocks[b];
+        auto it = std::lower_bound(block.begin(), block.end(), row, less);
+        if (it != block.end() && *it == row)
+        {
+            block.erase(it);
+            if (block.empty())
+            {
+                blocks.erase(blocks.begin() + b);
+            }
+        }
+    }
+
+    // Drop every row marked in `marked` in one pass, reading no values
+    void eraseMarked(const RowBitmap &marked)
+    {
+        for (auto &block : blocks)
+        {
+            block.erase(std::remove_if(block.begin(), block.end(), [&marked](RowIndex row)
+                                       { return marked.test(row); }),
+                        block.end());
+        }
+        blocks.erase(std::remove_if(blocks.begin(), blocks.end(), [](const std::vector<RowIndex> &block)
+                                    { return block.empty(); }),
+                     blocks.end());
+    }
+
+    size_t residentBytes() const
+    {
+        size_t bytes = blocks.capacity() * sizeof(std::vector<RowIndex>);
+        for (const auto &block : blocks)
+        {
+            bytes += block.capacity() * sizeof(RowIndex);
+        }
+        return bytes;
+    }
+
+    // Call visit(row) from the smallest value up until it returns false
+    template <typename Visit>
+    void visitAscending(Visit visit) const
+    {
+        for (const auto &block : blocks)
+        {
+            for (RowIndex row : block)
+            {
+                if (!visit(row))
+                {
+                    return;
+                }
+            }
+        }
+    }
+
+    // Call visit(row) from the largest value down until it returns false
+    template <typename Visit>
+    void visitDescending(Visit visit) const
+    {
+        for (auto block = blocks.rbegin(); block != blocks.rend(); ++block)
+        {
+            for (auto row = block->rbegin(); row != block->rend(); ++row)
+            {
+                if (!visit(*row))
+                {
+                    return;
+                }
+            }
+        }
+    }
+};
+
+// Everything topK/bottomK needs for one field: all rows in value order, plus
+// each ticker's highest and lowest row in value order for distinct-ticker
+// queries. Rows whose value is NaN are left out, as the filter engine's scan
+// skips them. Built on first use and maintained incrementally afterwards.
+template <StockField F>
+class FieldRanking
+{
+private:
+    bool built = false;
+    FieldIndex<F> rows;
+    FieldIndex<F> tickerMaxRows;
+    FieldIndex<F> tickerMinRows;
+    std::vector<RowIndex> tickerMax; // by ticker id, NO_ROW when the ticker has no rows
+    std::vector<RowIndex> tickerMin;
+
+    std::vector<RowIndex> take(const FieldIndex<F> &index, size_t k, bool descending) const
+    {
+        std::vector<RowIndex> result;
+        if (k == 0)
+        {
+            return result;
+        }
+        auto visit = [&result, k](RowIndex row)
+        {
+            result.push_back(row);
+            return result.size() < k;
+        };
+        if (descending)
+        {
+            index.visitDescending(visit);
+        }
+        else
+        {
+            index.visitAscending(visit);
+        }
+        return result;
+    }
+
+public:
+    bool isBuilt() const { return built; }
+
+    void reset() { *this = FieldRanking(); }
+
+    size_t residentBytes() const
+    {
+        return rows.residentBytes() + tickerMaxRows.residentBytes() + tickerMinRows.residentBytes() +
+               (tickerMax.capacity() + tickerMin.capacity()) * sizeof(RowIndex);
+    }
+
+    // The field is decoded at most once (see ColumnReader), as the build reads
+    // every row and the sorts read each many times
+    void build(const StockColumns &columns, const std::vector<TickerSeries> &tickerMap)
+    {
+        ColumnReader<double> values(fieldColumn<F>(columns));
+        ReaderComparator<> less{&values};
+        std::vector<RowIndex> allRows, maxRows, minRows;
+        tickerMax.assign(tickerMap.size(), NO_ROW);
+        tickerMin.assign(tickerMap.size(), NO_ROW);
+        for (std::uint32_t tickerId = 0; tickerId < tickerMap.size(); ++tickerId)
+        {
+            std::vector<RowIndex> series;
+            for (RowIndex row : tickerMap[tickerId].rowIndices())
+            {
+                if (!std::isnan(values[row]))
+                {
+                    series.push_back(row);
+                }
+            }
+            if (series.empty())
+            {
+                continue;
+            }
+            allRows.insert(allRows.end(), series.begin(), series.end());
+            tickerMax[tickerId] = *std::max_element(series.begin(), series.end(), less);
+            tickerMin[tickerId] = *std::min_element(series.begin(), series.end(), less);
+            maxRows.push_back(tickerMax[tickerId]);
+            minRows.push_back(tickerMin[tickerId]);
+        }
+        rows.assign(std::move(allRows), values);
+        tickerMaxRows.assign(std::move(maxRows), values);
+        tickerMinRows.assign(std::move(minRows), values);
+        built = true;
+    }
+
+    void insert(RowIndex row, const StockColumns &columns)
+    {
+        if (!built || std::isnan(fieldColumn<F>(columns)[row]))
+        {
+            return;
+        }
+        FieldComparator<F> less{&columns};
+        rows.insert(row, columns);
+
+        std::uint32_t tickerId = columns.ticker[row];
+        if (tickerId >= tickerMax.size())
+        {
+            tickerMax.resize(tickerId + 1, NO_ROW);
+            tickerMin.resize(tickerId + 1, NO_ROW);
+        }
+        if (tickerMax[tickerId] == NO_ROW || less(tickerMax[tickerId], row))
+        {
+            if (tickerMax[tickerId] != NO_ROW)
+            {
+                tickerMaxRows.erase(tickerMax[tickerId], columns);
+            }
+            tickerMax[tickerId] = row;
+            tickerMaxRows.insert(row, columns);
+        }
+        if (tickerMin[tickerId] == NO_ROW || less(row, tickerMin[tickerId]))
+        {
+            if (tickerMin[tickerId] != NO_ROW)
+            {
+                tickerMinRows.erase(tickerMin[tickerId], columns);
+            }
+            tickerMin[tickerId] = row;
+            tickerMinRows.insert(row, columns);
+        }
+    }
+
+    void eraseTicker(std::uint32_t tickerId, const std::vector<RowIndex> &tickerRows, const StockColumns &columns)
+    {
+        if (!built)
+        {
+            return;
+        }
+        // Each erase's binary search reads values around the row, a block
+        // decode apiece when compressed, so there the rows are dropped by number
+        if (fieldColumn<F>(columns).isPacked())
+        {
+            RowBitmap marked(columns.size());
+            for (RowIndex row : tickerRows)
+            {
+                marked.set(row);
+            }
+            rows.eraseMarked(marked);
+        }
+        else
+        {
+            for (RowIndex row : tickerRows)
+            {
+                rows.erase(row, columns);
+            }
+        }
+        if (tickerId < tickerMax.size() && tickerMax[tickerId] != NO_ROW)
+        {
+            tickerMaxRows.erase(tickerMax[tickerId], columns);
+            tickerMinRows.erase(tickerMin[tickerId], columns);
+            tickerMax[tickerId] = NO_ROW;
+            tickerMin[tickerId] = NO_ROW;
+        }
+    }
+
+    // Rows with the largest values, largest first; at most one row per ticker when distinctTicker
+    std::vector<RowIndex> highest(size_t k, bool distinctTicker) const
+    {
+        return take(distinctTicker ? tickerMaxRows : rows, k, true);
+    }
+
+    // Rows with the smallest values, smallest first; at most one row per ticker when distinctTicker
+    std::vector<RowIndex> lowest(size_t k, bool distinctTicker) const
+    {
+        return take(distinctTicker ? tickerMinRows : rows, k, false);
+    }
+};
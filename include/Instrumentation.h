@@ -0,0 +1,131 @@
+#pragma once
+
+#include "LatencyHistogram.h"
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+
+// Operations of StockDatabase whose latency is recorded
+enum class Operation
+{
+    LoadData,
+    LoadSnapshot,
+    SaveSnapshot,
+    AddStockRecord,
+    AddStockRecords,
+    IngestChunks,
+    DeleteTicker,
+    Compact,
+    FreezeColdPartitions,
+    GetDataByDate,
+    GetAverageClosePrice,
+    GetHighestPriceInPeriod,
+    GetLowestPriceInPeriod,
+    GetAllUniqueTickers,
+    DoesTickerExist,
+    CountDatesAboveThreshold,
+    CountDatesBelowThreshold,
+    CountDatesBetweenThresholds,
+    GetClosingPrice,
+    GetDatesAndClosingPrices,
+    GetRollingSeries,
+    GetTotalVolume,
+    GetTotalDividends,
+    DoesDataExist,
+    GetOpeningAndClosingPrices,
+    GetDividend,
+    GetTop10StocksByVolume,
+    GetTopStocksOnDate,
+    GetTopTickersByVolume,
+    GetCorrelationMatrix,
+    GetTopCorrelatedPairs,
+    GetBottom5StocksByClosingPrice,
+    GetTop5StocksByDividends,
+    TopK,
+    BottomK,
+    FilterRows,
+    CountFilteredDates,
+    AggregateRows,
+    TopRows,
+    Count // number of operations
+};
+
+enum class Counter
+{
+    RowsScanned, // rows visited by a scan
+    IndexHits,   // lookups answered by an index
+    IndexMisses, // lookups that found nothing
+    Scans,       // queries that had to scan instead of using an index
+    Allocations, // result buffers allocated
+    CacheHits,   // queries answered from the result cache
+    CacheMisses, // cacheable queries that had to be computed
+    Count
+};
+
+const char *operationName(Operation operation);
+const char *counterName(Counter counter);
+
+// Recording goes to the calling thread's own histograms and counters, so the
+// hot path takes no lock. Readers merge all threads on demand.
+bool instrumentationEnabled();
+void setInstrumentationEnabled(bool enabled);
+void recordLatency(Operation operation, std::uint64_t nanoseconds);
+void addCount(Counter counter, std::uint64_t amount = 1);
+bool latencyRecordingEnabled(); // enabled and not paused on the calling thread
+
+// Pauses recording on the calling thread for the enclosing scope: latencies,
+// and counters too when `counters` is set. Used while one logical operation is
+// applied more than once, so it is recorded once by an outer OperationTimer.
+class InstrumentationPause
+{
+private:
+    bool latencyWasPaused;
+    bool countersWerePaused;
+
+public:
+    explicit InstrumentationPause(bool counters);
+    ~InstrumentationPause();
+
+    InstrumentationPause(const InstrumentationPause &) = delete;
+    InstrumentationPause &operator=(const InstrumentationPause &) = delete;
+};
+
+// Records the lifetime of the enclosing scope as one `operation`
+class OperationTimer
+{
+private:
+    Operation operation;
+    bool active;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    explicit OperationTimer(Operation operation)
+        : operation(operation), active(latencyRecordingEnabled())
+    {
+        if (active)
+        {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~OperationTimer()
+    {
+        if (active)
+        {
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            recordLatency(operation, static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+        }
+    }
+
+    OperationTimer(const OperationTimer &) = delete;
+    OperationTimer &operator=(const OperationTimer &) = delete;
+};
+
+// All threads merged
+LatencyHistogram::Snapshot latencySnapshot(Operation operation);
+std::uint64_t counterValue(Counter counter);
+void resetInstrumentation();
+
+// count, mean, min, p50, p99, p99.9 and max per operation that ran, then the counters
+void writeInstrumentationText(std::ostream &out);
+void writeInstrumentationJson(std::ostream &out);
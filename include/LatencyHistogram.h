@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// HDR-style log-linear histogram of nanosecond latencies. Values below 16 are
+// exact; larger values fall into one of 16 linear sub-buckets of their power
+// of two, so a reported percentile is at most 1/16 (6.25%) above the true
+// one. Covers up to 2^40 ns (about 18 minutes); longer values are clamped.
+//
+// Written by a single thread; counts are relaxed atomics so other threads can
+// read a snapshot at any time without locking the writer.
+class LatencyHistogram
+{
+public:
+    static constexpr unsigned SUB_BITS = 4;
+    static constexpr size_t SUB_BUCKETS = size_t(1) << SUB_BITS;
+    static constexpr unsigned MAX_MAGNITUDE = 40;
+    static constexpr size_t BUCKETS = (MAX_MAGNITUDE - SUB_BITS + 1) * SUB_BUCKETS;
+
+    static size_t bucketFor(std::uint64_t value)
+    {
+        if (value < SUB_BUCKETS)
+        {
+            return static_cast<size_t>(value);
+        }
+        unsigned magnitude = 63 - static_cast<unsigned>(__builtin_clzll(value));
+        if (magnitude >= MAX_MAGNITUDE)
+        {
+            return BUCKETS - 1;
+        }
+        unsigned shift = magnitude - SUB_BITS;
+        return shift * SUB_BUCKETS + static_cast<size_t>(value >> shift);
+    }
+
+    // Largest value that lands in `bucket`
+    static std::uint64_t bucketUpperBound(size_t bucket)
+    {
+        if (bucket < SUB_BUCKETS)
+        {
+            return bucket;
+        }
+        unsigned shift = static_cast<unsigned>(bucket / SUB_BUCKETS) - 1;
+        std::uint64_t sub = bucket % SUB_BUCKETS + SUB_BUCKETS;
+        return ((sub + 1) << shift) - 1;
+    }
+
+    void record(std::uint64_t nanoseconds)
+    {
+        bump(counts[bucketFor(nanoseconds)], 1);
+        bump(total, 1);
+        bump(sum, nanoseconds);
+        if (nanoseconds > max.load(std::memory_order_relaxed))
+        {
+            max.store(nanoseconds, std::memory_order_relaxed);
+        }
+        if (nanoseconds < min.load(std::memory_order_relaxed))
+        {
+            min.store(nanoseconds, std::memory_order_relaxed);
+        }
+    }
+
+    void reset()
+    {
+        for (auto &count : counts)
+        {
+            count.store(0, std::memory_order_relaxed);
+        }
+        total.store(0, std::memory_order_relaxed);
+        sum.store(0, std::memory_order_relaxed);
+        min.store(UINT64_MAX, std::memory_order_relaxed);
+        max.store(0, std::memory_order_relaxed);
+    }
+
+    // Plain copy for merging and percentile math
+    struct Snapshot
+    {
+        std::uint64_t counts[BUCKETS] = {};
+        std::uint64_t total = 0;
+        std::uint64_t sum = 0;
+        std::uint64_t min = UINT64_MAX;
+        std::uint64_t max = 0;
+
+        // Smallest bucket bound with at least `quantile` of the values at or below it
+        std::uint64_t percentile(double quantile) const
+        {
+            if (total == 0)
+            {
+                return 0;
+            }
+            std::uint64_t rank = static_cast<std::uint64_t>(quantile * static_cast<double>(total) + 0.5);
+            rank = rank == 0 ? 1 : rank;
+            std::uint64_t seen = 0;
+            for (size_t b = 0; b < BUCKETS; ++b)
+            {
+                seen += counts[b];
+                if (seen >= rank)
+                {
+                    return bucketUpperBound(b) < max ? bucketUpperBound(b) : max;
+                }
+            }
+            return max;
+        }
+
+        double mean() const { return total == 0 ? 0 : static_cast<double>(sum) / static_cast<double>(total); }
+    };
+
+    void addTo(Snapshot &snapshot) const
+    {
+        for (size_t b = 0; b < BUCKETS; ++b)
+        {
+            snapshot.counts[b] += counts[b].load(std::memory_order_relaxed);
+        }
+        snapshot.total += total.load(std::memory_order_relaxed);
+        snapshot.sum += sum.load(std::memory_order_relaxed);
+        std::uint64_t low = min.load(std::memory_order_relaxed), high = max.load(std::memory_order_relaxed);
+        snapshot.min = low < snapshot.min ? low : snapshot.min;
+        snapshot.max = high > snapshot.max ? high : snapshot.max;
+    }
+
+private:
+    std::atomic<std::uint64_t> counts[BUCKETS] = {};
+    std::atomic<std::uint64_t> total{0};
+    std::atomic<std::uint64_t> sum{0};
+    std::atomic<std::uint64_t> min{UINT64_MAX};
+    std::atomic<std::uint64_t> max{0};
+
+    // Single writer: a plain load and store, no locked read-modify-write
+    static void bump(std::atomic<std::uint64_t> &value, std::uint64_t amount)
+    {
+        value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// How a mapping will be read, passed to the kernel as a readahead hint
+enum class AccessPattern
+{
+    Sequential, // front to back once, e.g. parsing a CSV
+    Random      // by row index, e.g. snapshot and cold segment columns
+};
+
+// Read-only memory mapping of a whole file, unmapped on destruction
+class MappedFile
+{
+private:
+    const char *mapped = nullptr;
+    size_t length = 0;
+    bool ok = false;
+
+public:
+    MappedFile(const std::string &filename, AccessPattern pattern);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool isOpen() const { return ok; }
+    const char *data() const { return mapped; } // nullptr for an empty file
+    size_t size() const { return length; }
+
+    // Let the kernel drop the resident pages; they are read back on the next access
+    void releasePages() const;
+};
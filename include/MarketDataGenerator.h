@@ -0,0 +1,59 @@
+#pragma once
+
+#include "DateUtils.h"
+#include "StockData.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct MarketDataOptions
+{
+    size_t tickers = 100;
+    int years = 5;
+    int startYear = 2015;
+    double dividendFrequency = 4;    // payments per year by a dividend-paying ticker
+    double dividendPayerShare = 0.4; // fraction of tickers that pay dividends
+    std::uint64_t seed = 42;
+};
+
+// Synthetic daily OHLCV bars on weekdays. Each ticker follows a geometric
+// random walk with its own drift and volatility; highs and lows bracket the
+// open and close, volume grows with the size of the move, and payers receive
+// dividends on a fixed schedule. Every ticker draws from its own generator
+// seeded from (seed, ticker index), so the output only depends on the options
+// and a ticker's series does not change when more tickers are requested.
+class MarketDataGenerator
+{
+private:
+    struct TickerState
+    {
+        std::string name;
+        std::uint64_t random;
+        double close;
+        double drift;
+        double volatility;
+        double baseVolume;
+        double dividendYield; // 0 for tickers that pay none
+        int dividendPhase;
+    };
+
+    MarketDataOptions options;
+    std::vector<TickerState> states;
+    std::vector<DayNumber> tradingDays;
+    size_t dayIndex = 0;
+    size_t tickerIndex = 0;
+
+public:
+    explicit MarketDataGenerator(const MarketDataOptions &options);
+
+    // Next bar in file order (by date, then ticker); false after the last one
+    bool next(StockData &bar);
+
+    size_t rowCount() const { return states.size() * tradingDays.size(); }
+    const std::vector<DayNumber> &days() const { return tradingDays; }
+    // "AAA", "AAB", ... then four letters
+    static std::string tickerName(size_t index);
+};
+
+// Write the generated bars as a CSV in the layout loadData reads
+bool writeMarketDataCsv(const std::string &filename, const MarketDataOptions &options);
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "Column.h"
+#include "ScanKernels.h"
+#include <cstddef>
+#include <vector>
+
+// Running totals over a sequence: sum of any [first, last) is one subtraction.
+// Appends are O(1); an insert in the middle only updates the totals after it.
+// The totals of a frozen prefix may be read from a mapping (see freeze); the
+// values there can no longer move, so inserts go after it.
+class PrefixSums
+{
+private:
+    Column<double> sums; // sums[i] = total of the first i values
+
+public:
+    PrefixSums() { sums.push_back(0.0); }
+
+    size_t size() const { return sums.size() - 1; }
+
+    void assign(const std::vector<double> &values)
+    {
+        std::vector<double> totals(1, 0.0);
+        totals.reserve(values.size() + 1);
+        for (double value : values)
+        {
+            totals.push_back(totals.back() + value);
+        }
+        sums.assign(totals.data(), totals.data() + totals.size());
+    }
+
+    // The size() + 1 running totals, for snapshots, and adopting saved ones in
+    // place: they are read from `saved`, which must stay mapped
+    std::vector<double> totals() const { return sums.values(); }
+    void restore(const double *saved, size_t count)
+    {
+        sums = Column<double>();
+        sums.attach(saved, count);
+    }
+
+    // Values at positions before this one are frozen
+    size_t frozenSize() const { return sums.coldSize() == 0 ? 0 : sums.coldSize() - 1; }
+
+    // The first `count` values are frozen: frozenTotals appends the totals up
+    // to them that are still in memory, and freeze reads those from `mapped`
+    // (a copy of them) from now on. Returns the number of totals mapped.
+    void frozenTotals(size_t count, std::vector<double> &out) const
+    {
+        const std::vector<double> &hot = sums.hotValues();
+        out.insert(out.end(), hot.begin(), hot.begin() + (count + 1 - sums.coldSize()));
+    }
+    size_t freeze(size_t count, const double *mapped)
+    {
+        size_t newlyFrozen = count + 1 - sums.coldSize();
+        sums.freeze(mapped, newlyFrozen);
+        return newlyFrozen;
+    }
+
+    // Bring every total back into memory, so inserts may go anywhere again
+    void thaw()
+    {
+        std::vector<double> all = sums.values();
+        sums.assign(all.data(), all.data() + all.size());
+    }
+
+    size_t residentBytes() const { return sums.hotValues().capacity() * sizeof(double); }
+
+    void push_back(double value) { sums.push_back(sums[sums.size() - 1] + value); }
+
+    // Requires pos >= frozenSize()
+    void insert(size_t pos, double value)
+    {
+        std::vector<double> &hot = sums.hotValues();
+        size_t at = pos + 1 - sums.coldSize();
+        hot.insert(hot.begin() + at, sums[pos] + value);
+        scanAddToAll(hot.data() + at + 1, hot.size() - at - 1, value);
+    }
+
+    // Insert values[i] before the value now at positions[i] (ascending, may
+    // repeat, from frozenSize() on). Totals before positions[0] stay; each
+    // later one is shifted by the values inserted ahead of it, a run at a time.
+    void insert(const std::vector<size_t> &positions, const std::vector<double> &values)
+    {
+        if (values.empty())
+        {
+            return;
+        }
+        std::vector<double> &hot = sums.hotValues();
+        size_t cold = sums.coldSize();
+        size_t first = positions[0];
+        std::vector<double> tail;
+        tail.reserve(sums.size() - first + values.size());
+        double added = 0;
+        double total = sums[first];
+        size_t next = first;
+        for (size_t i = 0; i <= values.size(); ++i)
+        {
+            size_t end = i < values.size() ? positions[i] : size();
+            size_t start = tail.size();
+            tail.insert(tail.end(), hot.begin() + (next + 1 - cold), hot.begin() + (end + 1 - cold));
+            scanAddToAll(tail.data() + start, end - next, added);
+            total = tail.empty() ? total : tail.back();
+            next = end;
+            if (i < values.size())
+            {
+                total += values[i];
+                added += values[i];
+                tail.push_back(total);
+            }
+        }
+        hot.resize(first + 1 - cold);
+        hot.insert(hot.end(), tail.begin(), tail.end());
+    }
+
+    double sum(size_t first, size_t last) const { return sums[last] - sums[first]; }
+};
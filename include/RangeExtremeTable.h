@@ -0,0 +1,297 @@
+#pragma once
+
+#include "Column.h"
+#include "ScanKernels.h"
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Insert inserted[i] into `values` before the element now at positions[i]
+// (ascending, may repeat), moving only the elements from positions[0] on
+template <typename T>
+void mergeInto(std::vector<T> &values, const std::vector<size_t> &positions, const std::vector<T> &inserted)
+{
+    size_t old = values.size();
+    values.resize(old + inserted.size());
+    size_t write = values.size();
+    for (size_t i = inserted.size(); i-- > 0;)
+    {
+        while (old > positions[i])
+        {
+            values[--write] = values[--old];
+        }
+        values[--write] = inserted[i];
+    }
+}
+
+// Range maximum/minimum over a growing sequence of doubles. A sparse table over
+// fixed-size blocks answers the full blocks of a query in O(1); at most two
+// partial blocks are scanned. Appends cost O(log n); inserts in the middle
+// rebuild the table from their block on. `Better(a, b)` is true when a should
+// win over b.
+//
+// Once a prefix is frozen (see freeze) the entries over its whole blocks are
+// read from a mapping and its values are not kept: the caller passes
+// valueAt(position) to query, which reads those from the column instead.
+template <typename Better>
+class RangeExtremeTable
+{
+private:
+    static constexpr size_t BLOCK = 16;
+
+    size_t firstValue = 0;              // values before this position (whole frozen blocks) are not kept
+    std::vector<double> values;         // from position firstValue on
+    std::vector<Column<double>> levels; // levels[k][b] = best of blocks [b, b + 2^k)
+
+    static double pick(double a, double b) { return Better()(b, a) ? b : a; }
+
+    static size_t floorLog2(size_t x) { return 63 - __builtin_clzll(static_cast<unsigned long long>(x)); }
+
+    // Entries of level k that cover only the first `blocks` blocks
+    static size_t entriesWithin(size_t blocks, size_t k)
+    {
+        return blocks >= (size_t(1) << k) ? blocks - (size_t(1) << k) + 1 : 0;
+    }
+
+    // Max and min of kept values run on the SIMD scan kernels; other orders,
+    // and values that are not kept, fall back to a loop
+    template <typename ValueAt>
+    double scan(size_t first, size_t last, ValueAt valueAt) const
+    {
+        if (first < firstValue)
+        {
+            double best = valueAt(first);
+            for (size_t i = first + 1; i < last; ++i)
+            {
+                best = pick(best, valueAt(i));
+            }
+            return best;
+        }
+        const double *kept = values.data() - firstValue;
+        if constexpr (std::is_same_v<Better, std::greater<double>>)
+        {
+            return scanMax(kept + first, last - first);
+        }
+        else if constexpr (std::is_same_v<Better, std::less<double>>)
+        {
+            return scanMin(kept + first, last - first);
+        }
+        else
+        {
+            double best = kept[first];
+            for (size_t i = first + 1; i < last; ++i)
+            {
+                best = pick(best, kept[i]);
+            }
+            return best;
+        }
+    }
+
+    // Recompute the entries that cover a block from `firstBlock` on; the
+    // values from that block on must be kept
+    void rebuild(size_t firstBlock)
+    {
+        size_t blockCount = (size() + BLOCK - 1) / BLOCK;
+        auto none = [](size_t) { return 0.0; };
+        size_t k = 0;
+        for (; (size_t(1) << k) <= blockCount; ++k)
+        {
+            if (k == levels.size())
+            {
+                levels.emplace_back();
+            }
+            // Entries past the level's old end are new and computed too
+            size_t span = size_t(1) << k;
+            size_t from = std::min(levels[k].size(), firstBlock + 1 >= span ? firstBlock + 1 - span : 0);
+            size_t cold = levels[k].coldSize();
+            std::vector<double> &level = levels[k].hotValues();
+            level.resize(blockCount - span + 1 - cold);
+            for (size_t b = from; b < blockCount - span + 1; ++b)
+            {
+                level[b - cold] = k == 0 ? scan(b * BLOCK, std::min(size(), (b + 1) * BLOCK), none)
+                                         : pick(levels[k - 1][b], levels[k - 1][b + span / 2]);
+            }
+        }
+        levels.resize(k);
+    }
+
+public:
+    size_t size() const { return firstValue + values.size(); }
+
+    void assign(std::vector<double> newValues)
+    {
+        firstValue = 0;
+        values = std::move(newValues);
+        levels.clear();
+        rebuild(0);
+    }
+
+    // Doubles the levels of a table over `count` values take
+    static size_t levelSize(size_t count)
+    {
+        size_t blockCount = (count + BLOCK - 1) / BLOCK;
+        size_t total = blockCount;
+        for (size_t k = 1; (size_t(1) << k) <= blockCount; ++k)
+        {
+            total += blockCount - (size_t(1) << k) + 1;
+        }
+        return total;
+    }
+
+    // Append the levels to `out`, for snapshots
+    void saveLevels(std::vector<double> &out) const
+    {
+        for (const Column<double> &level : levels)
+        {
+            std::vector<double> entries = level.values();
+            out.insert(out.end(), entries.begin(), entries.end());
+        }
+    }
+
+    // Adopt a table over `count` values, all frozen, from the
+    // levelSize(count) doubles saveLevels wrote for them: the entries over
+    // whole blocks are read from `savedLevels`, which must stay mapped, and
+    // only the values of a partial last block are read, with valueAt
+    template <typename ValueAt>
+    void restore(size_t count, const double *savedLevels, ValueAt valueAt)
+    {
+        size_t blockCount = (count + BLOCK - 1) / BLOCK;
+        firstValue = count / BLOCK * BLOCK;
+        values.clear();
+        for (size_t i = firstValue; i < count; ++i)
+        {
+            values.push_back(valueAt(i));
+        }
+        levels.clear();
+        for (size_t k = 0; blockCount > 0 && (size_t(1) << k) <= blockCount; ++k)
+        {
+            size_t length = blockCount - (size_t(1) << k) + 1;
+            size_t mapped = entriesWithin(count / BLOCK, k);
+            levels.emplace_back();
+            levels[k].attach(savedLevels, mapped);
+            levels[k].hotValues().assign(savedLevels + mapped, savedLevels + length);
+            savedLevels += length;
+        }
+    }
+
+    // The first `count` positions are frozen: frozenLevels appends the entries
+    // over their whole blocks that are still in memory, and freeze reads
+    // those from `mapped` (a copy of them) from now on and drops the values of
+    // those blocks. Returns the number of entries mapped.
+    void frozenLevels(size_t count, std::vector<double> &out) const
+    {
+        for (size_t k = 0; k < levels.size(); ++k)
+        {
+            const std::vector<double> &hot = levels[k].hotValues();
+            out.insert(out.end(), hot.begin(), hot.begin() + (entriesWithin(count / BLOCK, k) - levels[k].coldSize()));
+        }
+    }
+    size_t freeze(size_t count, const double *mapped)
+    {
+        size_t total = 0;
+        for (size_t k = 0; k < levels.size(); ++k)
+        {
+            size_t newlyFrozen = entriesWithin(count / BLOCK, k) - levels[k].coldSize();
+            levels[k].freeze(mapped + total, newlyFrozen);
+            total += newlyFrozen;
+        }
+        size_t newFirst = count / BLOCK * BLOCK;
+        values.erase(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(newFirst - firstValue));
+        values.shrink_to_fit();
+        firstValue = newFirst;
+        return total;
+    }
+
+    size_t residentBytes() const
+    {
+        size_t bytes = values.capacity() * sizeof(double) + levels.capacity() * sizeof(Column<double>);
+        for (const Column<double> &level : levels)
+        {
+            bytes += level.hotValues().capacity() * sizeof(double);
+        }
+        return bytes;
+    }
+
+    void push_back(double value)
+    {
+        values.push_back(value);
+        size_t block = (size() - 1) / BLOCK;
+        if (levels.empty())
+        {
+            levels.emplace_back();
+        }
+        // Entries of the last block are never frozen, as it is the one growing
+        if (block == levels[0].size())
+        {
+            levels[0].push_back(value);
+        }
+        else
+        {
+            double &entry = levels[0].hotValues()[block - levels[0].coldSize()];
+            entry = pick(entry, value);
+        }
+        // Exactly one entry per level ends at the last block
+        for (size_t k = 1; (size_t(1) << k) <= block + 1; ++k)
+        {
+            size_t first = block + 1 - (size_t(1) << k);
+            if (k == levels.size())
+            {
+                levels.emplace_back();
+            }
+            double best = pick(levels[k - 1][first], levels[k - 1][first + (size_t(1) << (k - 1))]);
+            if (first == levels[k].size())
+            {
+                levels[k].push_back(best);
+            }
+            else
+            {
+                levels[k].hotValues()[first - levels[k].coldSize()] = best;
+            }
+        }
+    }
+
+    // Requires pos >= the frozen positions' whole blocks
+    void insert(size_t pos, double value)
+    {
+        values.insert(values.begin() + static_cast<std::ptrdiff_t>(pos - firstValue), value);
+        rebuild(pos / BLOCK);
+    }
+
+    // Insert newValues[i] before the value now at positions[i] (ascending, may
+    // repeat, past the frozen blocks), rebuilding the table once from the
+    // first of them on
+    void insert(const std::vector<size_t> &positions, const std::vector<double> &newValues)
+    {
+        std::vector<size_t> kept = positions;
+        for (size_t &position : kept)
+        {
+            position -= firstValue;
+        }
+        mergeInto(values, kept, newValues);
+        rebuild(positions[0] / BLOCK);
+    }
+
+    // Best value in [first, last); requires first < last <= size().
+    // valueAt(position) reads the values of frozen blocks.
+    template <typename ValueAt>
+    double query(size_t first, size_t last, ValueAt valueAt) const
+    {
+        size_t firstBlock = first / BLOCK;
+        size_t lastBlock = (last - 1) / BLOCK;
+        if (firstBlock == lastBlock)
+        {
+            return scan(first, last, valueAt);
+        }
+        double best = pick(scan(first, (firstBlock + 1) * BLOCK, valueAt), scan(lastBlock * BLOCK, last, valueAt));
+        if (lastBlock - firstBlock > 1)
+        {
+            size_t count = lastBlock - firstBlock - 1;
+            size_t k = floorLog2(count);
+            best = pick(best, pick(levels[k][firstBlock + 1], levels[k][lastBlock - (size_t(1) << k)]));
+        }
+        return best;
+    }
+};
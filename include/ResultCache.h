@@ -0,0 +1,119 @@
+#pragma once
+
+#include "StockColumns.h"
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Queries whose results StockDatabase keeps in its ResultCache
+enum class CachedQuery : std::uint8_t
+{
+    AverageClosePrice,
+    TotalVolume,
+    TotalDividends,
+    HighestPrice,
+    LowestPrice,
+    TopStocksOnDate,
+    TopTickersByVolume
+};
+
+// A query with its arguments already translated to ids and day numbers. The
+// result depends on the rows of `tickerId` (or of every ticker, ANY_TICKER)
+// dated within [startDay, endDay].
+struct CacheKey
+{
+    static constexpr std::uint32_t ANY_TICKER = UINT32_MAX;
+
+    CachedQuery query = CachedQuery::AverageClosePrice;
+    std::uint8_t field = 0;
+    std::uint32_t tickerId = ANY_TICKER;
+    DayNumber startDay = 0;
+    DayNumber endDay = 0;
+    std::uint64_t k = 0;
+
+    bool operator==(const CacheKey &other) const
+    {
+        return query == other.query && field == other.field && tickerId == other.tickerId &&
+               startDay == other.startDay && endDay == other.endDay && k == other.k;
+    }
+};
+
+struct CacheKeyHash
+{
+    size_t operator()(const CacheKey &key) const
+    {
+        std::uint64_t h = (static_cast<std::uint64_t>(key.query) << 8 | key.field) * 0x9E3779B97F4A7C15ull;
+        h ^= (static_cast<std::uint64_t>(key.tickerId) << 32 | static_cast<std::uint32_t>(key.startDay)) + (h << 6) + (h >> 2);
+        h ^= (static_cast<std::uint64_t>(static_cast<std::uint32_t>(key.endDay)) << 32 ^ key.k) + (h << 6) + (h >> 2);
+        return static_cast<size_t>(h * 0x9E3779B97F4A7C15ull);
+    }
+};
+
+// Only the member the query produces is filled in
+struct CachedResult
+{
+    double value = 0;
+    std::vector<RowIndex> rows;
+    std::vector<std::pair<std::uint32_t, double>> totals; // (ticker id, value)
+};
+
+// Bounded LRU cache of query results. A write names the tickers and days it
+// touched and only the entries depending on them are dropped. Safe to use from
+// concurrent readers; a copy starts empty with the same budget.
+class ResultCache
+{
+public:
+    struct Stats
+    {
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+        std::uint64_t evictions = 0;     // dropped to stay within the budget
+        std::uint64_t invalidations = 0; // dropped because a write touched their rows
+        size_t entries = 0;
+        size_t bytes = 0;
+        size_t budget = 0;
+    };
+
+    static constexpr size_t DEFAULT_BUDGET = size_t(4) << 20;
+
+    ResultCache() = default;
+    ResultCache(const ResultCache &other) : budget(other.budget) {}
+    ResultCache &operator=(const ResultCache &other);
+
+    // Copies the cached result into `result`; false on a miss
+    bool find(const CacheKey &key, CachedResult &result);
+    void insert(const CacheKey &key, CachedResult result);
+
+    // Drop the entries that depend on `tickerId` on any of `days` (sorted)
+    void invalidate(std::uint32_t tickerId, const std::vector<DayNumber> &days);
+    void clear();
+
+    // Bytes the cached results may take; 0 disables the cache
+    void setBudget(size_t bytes);
+    Stats stats() const;
+
+private:
+    struct Entry
+    {
+        CacheKey key;
+        CachedResult result;
+        size_t bytes = 0;
+        size_t tickerSlot = 0; // position in byTicker[key.tickerId]
+    };
+
+    mutable std::mutex mutex;
+    size_t budget = DEFAULT_BUDGET;
+    size_t bytes = 0;
+    std::list<Entry> lru; // most recently used first
+    std::unordered_map<CacheKey, std::list<Entry>::iterator, CacheKeyHash> entries;
+    std::unordered_map<std::uint32_t, std::vector<Entry *>> byTicker;
+    Stats counts;
+
+    void erase(std::list<Entry>::iterator it);
+    void evictToBudget();
+    size_t invalidateList(std::vector<Entry *> &list, const std::vector<DayNumber> &days);
+};
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "RowRange.h"
+#include "TickerSeries.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Per-ticker series computed over a sliding window of `window` bars
+enum class RollingMetric : std::uint8_t
+{
+    Sma,       // mean close of the last `window` bars
+    Ema,       // exponential average of the close, alpha = 2 / (window + 1), seeded with the first SMA
+    Vwap,      // typical price (high + low + close) / 3 weighted by volume over the last `window` bars
+    Return,    // close / close `window` bars earlier - 1
+    Volatility // sample standard deviation of the last `window` one-bar returns
+};
+
+bool parseRollingMetric(std::string_view text, RollingMetric &metric);
+const char *rollingMetricName(RollingMetric metric);
+
+// One metric of one ticker, from the first bar with a full window to the
+// newest bar. Appending bars extends it in O(1) per bar from the window state.
+class RollingSeries
+{
+private:
+    RollingMetric metric;
+    size_t window;
+    std::vector<double> values; // values[i] belongs to series position firstPosition() + i
+    size_t consumed = 0;        // series positions folded into the state
+    RowIndex lastRow = NO_ROW;  // row at position consumed - 1, to detect inserts before it
+    double sum = 0;             // close (SMA, EMA seed), price * volume (VWAP) or return (volatility)
+    double volumeSum = 0;       // VWAP
+    double mean = 0, m2 = 0;    // volatility (Welford over the window)
+    double ema = 0;
+
+    double windowValue(const TickerSeries &series, const StockColumns &columns, size_t position) const;
+
+public:
+    RollingSeries(RollingMetric metric, size_t window) : metric(metric), window(window) {}
+
+    size_t firstPosition() const { return metric == RollingMetric::Return || metric == RollingMetric::Volatility ? window : window - 1; }
+    const std::vector<double> &data() const { return values; }
+
+    // True when the bars folded in so far are still the series' first bars,
+    // i.e. everything added since went after them
+    bool isPrefixOf(const TickerSeries &series) const;
+
+    // Fold in the bars from position consumed up to the end of the series
+    void extend(const TickerSeries &series, const StockColumns &columns);
+};
+
+// A rolling series as returned by a query: value(i) belongs to row(i).
+// Valid as long as a RowRange would be (see RowRange.h); it shares ownership
+// of the series, so the cache evicting it does not end that.
+class RollingRange
+{
+private:
+    const StockColumns *columns = nullptr;
+    const RowIndex *rows = nullptr;
+    std::shared_ptr<const RollingSeries> series;
+    const double *values = nullptr;
+    size_t count = 0;
+
+public:
+    RollingRange() = default;
+    RollingRange(const StockColumns &columns, const RowIndex *rows, std::shared_ptr<const RollingSeries> series)
+        : columns(&columns), rows(rows + series->firstPosition()), series(std::move(series)),
+          values(this->series->data().data()), count(this->series->data().size()) {}
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    RowRef row(size_t i) const { return RowRef(*columns, rows[i]); }
+    double value(size_t i) const { return values[i]; }
+};
+
+// Rolling series computed so far, by (ticker, metric, window). Readers add
+// series on first use; writers extend them as bars are appended. Both trim it
+// to the MAX_SERIES most recently used. A copy starts empty.
+class RollingCache
+{
+private:
+    static constexpr size_t MAX_SERIES = 256;
+
+    struct Entry
+    {
+        std::shared_ptr<RollingSeries> series;
+        std::uint64_t lastUse;
+    };
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::uint64_t, Entry> entries;
+    std::uint64_t useClock = 0;
+
+    static std::uint64_t key(std::uint32_t tickerId, RollingMetric metric, size_t window)
+    {
+        return (static_cast<std::uint64_t>(tickerId) << 32) | (static_cast<std::uint64_t>(metric) << 24) | window;
+    }
+
+    // Over MAX_SERIES: keep the most recently used half, and always `keep`.
+    // Called with the mutex held.
+    void trim(std::uint64_t keep);
+
+public:
+    static constexpr size_t MAX_WINDOW = (size_t(1) << 24) - 1;
+
+    RollingCache() = default;
+    RollingCache(const RollingCache &) {}
+    RollingCache &operator=(const RollingCache &other);
+
+    // Cached series, computed on a miss (which may evict others); `hit` tells
+    // which. Requires 0 < window <= MAX_WINDOW.
+    std::shared_ptr<const RollingSeries> find(std::uint32_t tickerId, RollingMetric metric, size_t window,
+                                              const TickerSeries &series, const StockColumns &columns, bool &hit);
+
+    // After bars were added to a ticker: extend its series when the bars went
+    // after the ones they hold, drop them otherwise. Also trims the cache.
+    void update(std::uint32_t tickerId, const TickerSeries &series, const StockColumns &columns);
+    void erase(std::uint32_t tickerId);
+    void clear();
+    size_t size() const;
+};
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One bit per row of the column store, set for the rows a filter selects.
+// Row i is bit i % 64 of word i / 64, as in StockColumns::tombstones.
+class RowBitmap
+{
+private:
+    std::vector<std::uint64_t> words;
+    size_t bitCount = 0;
+
+    // The bits of [first, last) that fall in word w
+    static std::uint64_t maskFor(size_t w, size_t first, size_t last)
+    {
+        size_t begin = std::max(first, w * 64) - w * 64;
+        size_t end = std::min(last, w * 64 + 64) - w * 64;
+        std::uint64_t high = end == 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << end) - 1;
+        return high & ~((std::uint64_t(1) << begin) - 1);
+    }
+
+public:
+    RowBitmap() = default;
+    explicit RowBitmap(size_t size) : words((size + 63) / 64, 0), bitCount(size) {}
+
+    size_t size() const { return bitCount; }
+    size_t wordCount() const { return words.size(); }
+    std::uint64_t word(size_t w) const { return words[w]; }
+    const std::vector<std::uint64_t> &data() const { return words; }
+
+    // New bits are clear
+    void resize(size_t size)
+    {
+        words.resize((size + 63) / 64, 0);
+        if (size < bitCount && size % 64 != 0)
+        {
+            words.back() &= (std::uint64_t(1) << (size % 64)) - 1;
+        }
+        bitCount = size;
+    }
+
+    void clear() { std::fill(words.begin(), words.end(), 0); }
+
+    // Adopt (size + 63) / 64 words of bits, e.g. from a snapshot
+    void assign(const std::uint64_t *bits, size_t size)
+    {
+        words.assign(bits, bits + (size + 63) / 64);
+        bitCount = size;
+    }
+
+    bool test(size_t i) const { return (words[i >> 6] >> (i & 63)) & 1; }
+    void set(size_t i) { words[i >> 6] |= std::uint64_t(1) << (i & 63); }
+    void reset(size_t i) { words[i >> 6] &= ~(std::uint64_t(1) << (i & 63)); }
+
+    void setRange(size_t first, size_t last)
+    {
+        for (size_t w = first / 64; first < last && w <= (last - 1) / 64; ++w)
+        {
+            words[w] |= maskFor(w, first, last);
+        }
+    }
+
+    void clearRange(size_t first, size_t last)
+    {
+        for (size_t w = first / 64; first < last && w <= (last - 1) / 64; ++w)
+        {
+            words[w] &= ~maskFor(w, first, last);
+        }
+    }
+
+    // True when no bit of [first, last) is set
+    bool noneIn(size_t first, size_t last) const
+    {
+        for (size_t w = first / 64; first < last && w <= (last - 1) / 64; ++w)
+        {
+            if (words[w] & maskFor(w, first, last))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    size_t count() const
+    {
+        size_t n = 0;
+        for (std::uint64_t w : words)
+        {
+            n += static_cast<size_t>(__builtin_popcountll(w));
+        }
+        return n;
+    }
+
+    // Keep only the bits also set in `other`; bits past its end are cleared
+    RowBitmap &operator&=(const RowBitmap &other)
+    {
+        size_t shared = std::min(words.size(), other.words.size());
+        for (size_t w = 0; w < shared; ++w)
+        {
+            words[w] &= other.words[w];
+        }
+        std::fill(words.begin() + shared, words.end(), 0);
+        return *this;
+    }
+
+    // Clear the bits set in `mask` (a bitmap of the same layout, e.g. tombstones)
+    void clearMasked(const std::vector<std::uint64_t> &mask)
+    {
+        size_t shared = std::min(words.size(), mask.size());
+        for (size_t w = 0; w < shared; ++w)
+        {
+            words[w] &= ~mask[w];
+        }
+    }
+
+    // AND `n` bits (bit 0 of bits[0] first) into [position, position + n);
+    // bits outside that range are left alone
+    void andBits(size_t position, const std::uint64_t *bits, size_t n)
+    {
+        size_t shift = position % 64;
+        size_t w = position / 64;
+        for (size_t i = 0; i * 64 < n; ++i)
+        {
+            size_t valid = std::min<size_t>(64, n - i * 64);
+            std::uint64_t covered = valid == 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << valid) - 1;
+            std::uint64_t value = bits[i] & covered;
+            words[w + i] &= (value << shift) | ~(covered << shift);
+            if (shift != 0 && (covered >> (64 - shift)) != 0)
+            {
+                words[w + i + 1] &= (value >> (64 - shift)) | ~(covered >> (64 - shift));
+            }
+        }
+    }
+
+    // Call visit(i) for every set bit, ascending
+    template <typename Visit>
+    void forEach(Visit visit) const
+    {
+        for (size_t w = 0; w < words.size(); ++w)
+        {
+            for (std::uint64_t bits = words[w]; bits != 0; bits &= bits - 1)
+            {
+                visit(w * 64 + static_cast<size_t>(__builtin_ctzll(bits)));
+            }
+        }
+    }
+};
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "DatePartitions.h"
+#include "DateUtils.h"
+#include "StockField.h"
+#include <cstddef>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Values of one field in (lower, upper], the interval the scan kernels test
+struct FieldRange
+{
+    StockField field;
+    double lower;
+    double upper;
+
+    bool contains(double value) const { return value > lower && value <= upper; }
+};
+
+// A conjunction of conditions on rows: a date range, optionally one ticker, the
+// dividend flag and value ranges of fields. Conditions on one field intersect.
+// An empty filter selects every row.
+struct RowFilter
+{
+    DayNumber firstDay = std::numeric_limits<DayNumber>::min();
+    DayNumber lastDay = std::numeric_limits<DayNumber>::max();
+    std::string ticker;        // empty for every ticker
+    bool paysDividend = false; // dividends > 0; answered by a bitmap index
+    std::vector<FieldRange> ranges;
+    bool useIndexShortcuts = true; // false forces the scan, to check the shortcuts against it
+
+    RowFilter &between(DayNumber first, DayNumber last);
+    RowFilter &on(DayNumber day) { return between(day, day); }
+    RowFilter &forTicker(std::string_view name);
+    RowFilter &withDividend();
+    RowFilter &where(StockField field, double lower, double upper);
+    RowFilter &above(StockField field, double value);   // > value
+    RowFilter &atLeast(StockField field, double value); // >= value
+    RowFilter &below(StockField field, double value);   // < value
+    RowFilter &atMost(StockField field, double value);  // <= value
+    RowFilter &equals(StockField field, double value);
+
+    bool isEmpty() const;
+    bool restrictsDates() const;
+    bool excludesAll() const; // true when the conditions contradict each other
+    const FieldRange *range(StockField field) const;
+    // False when the partition's date range and field bounds rule out every row
+    bool mayMatch(const DatePartition &partition) const;
+};
+
+// Aggregate of one field over the rows a filter selects
+struct FilterAggregate
+{
+    size_t count = 0;
+    double sum = 0;
+    double minimum = std::numeric_limits<double>::infinity();
+    double maximum = -std::numeric_limits<double>::infinity();
+
+    double average() const { return count == 0 ? 0 : sum / static_cast<double>(count); }
+};
+
+// What a filter query reports over the selected rows
+enum class FilterOutput
+{
+    Count,  // rows
+    Dates,  // distinct dates
+    Sum,
+    Average,
+    Max,
+    Min,
+    Top,    // K rows with the largest values of the field
+    Bottom  // K rows with the smallest values of the field
+};
+
+struct FilterQuery
+{
+    FilterOutput output = FilterOutput::Count;
+    StockField field = StockField::Close;
+    size_t k = 0;
+    RowFilter filter;
+};
+
+bool parseStockField(std::string_view text, StockField &field);
+const char *stockFieldName(StockField field);
+
+// Parse the text form of a filter query, one token per word:
+//
+//   count|dates|sum FIELD|avg FIELD|max FIELD|min FIELD|top FIELD K|bottom FIELD K  CONDITION...
+//
+// A condition is NAME OP VALUE without spaces, OP one of < <= > >= =, NAME a
+// field (open high low close volume dividends), `date` or `ticker` (= only);
+// the word `dividend` selects the rows that pay one. For example:
+//
+//   avg close date>=2020-01-01 date<=2020-12-31 dividends>0 close<10
+//
+// Returns false (and leaves an explanation in `error`) for malformed text
+bool parseFilterQuery(const std::vector<std::string> &words, FilterQuery &query, std::string &error);
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "StockColumns.h"
+#include "StockField.h"
+#include <string_view>
+#include <vector>
+
+// Read-only reference to one row of the column store
+class RowRef
+{
+private:
+    const StockColumns *columns;
+    RowIndex index;
+
+public:
+    RowRef(const StockColumns &columns, RowIndex index) : columns(&columns), index(index) {}
+
+    RowIndex row() const { return index; }
+    std::string_view ticker() const { return columns->tickers.name(columns->ticker[index]); }
+    DayNumber day() const { return columns->date[index]; }
+    DateText date() const { return formatDateText(columns->date[index]); }
+    double open() const { return columns->open[index]; }
+    double high() const { return columns->high[index]; }
+    double low() const { return columns->low[index]; }
+    double close() const { return columns->close[index]; }
+    double volume() const { return columns->volume[index]; }
+    double dividends() const { return columns->dividends[index]; }
+    double value(StockField field) const { return fieldColumn(*columns, field)[index]; }
+
+    StockData materialize() const { return columns->row(index); }
+};
+
+// Rows returned by a query: either a view of row indices held by an index of
+// the database, or a short list of row indices owned by the range itself.
+// Records are never copied; RowRef reads the columns on access.
+//
+// Lifetime: a RowRange (and every RowRef taken from it) is valid until the next
+// call that modifies the database: loadData, loadSnapshot, addStockRecord(s),
+// insertRecord, ingestChunks, deleteTicker, eraseTicker, compact,
+// freezeColdPartitions or clear (compact and freezeColdPartitions reorder the
+// rows and may replace the columns). Call materialize() to keep results past
+// that point.
+class RowRange
+{
+private:
+    const StockColumns *columns = nullptr;
+    const RowIndex *viewData = nullptr;
+    size_t viewSize = 0;
+    std::vector<RowIndex> owned;
+    bool isView = true;
+
+    const RowIndex *data() const { return isView ? viewData : owned.data(); }
+
+public:
+    class iterator
+    {
+    private:
+        const StockColumns *columns;
+        const RowIndex *position;
+
+    public:
+        iterator(const StockColumns *columns, const RowIndex *position) : columns(columns), position(position) {}
+        RowRef operator*() const { return RowRef(*columns, *position); }
+        iterator &operator++()
+        {
+            ++position;
+            return *this;
+        }
+        bool operator!=(const iterator &other) const { return position != other.position; }
+        bool operator==(const iterator &other) const { return position == other.position; }
+    };
+
+    RowRange() = default;
+
+    RowRange(const StockColumns &columns, const RowIndex *first, size_t count)
+        : columns(&columns), viewData(first), viewSize(count) {}
+
+    RowRange(const StockColumns &columns, std::vector<RowIndex> rows)
+        : columns(&columns), owned(std::move(rows)), isView(false) {}
+
+    size_t size() const { return isView ? viewSize : owned.size(); }
+    bool empty() const { return size() == 0; }
+    RowRef operator[](size_t i) const { return RowRef(*columns, data()[i]); }
+    iterator begin() const { return iterator(columns, data()); }
+    iterator end() const { return iterator(columns, data() + size()); }
+
+    // Copy the rows out as owning StockData records
+    std::vector<StockData> materialize() const
+    {
+        std::vector<StockData> result;
+        result.reserve(size());
+        for (RowRef row : *this)
+        {
+            result.push_back(row.materialize());
+        }
+        return result;
+    }
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Scan kernels over contiguous double columns, dispatched at runtime to
+// AVX-512, AVX2 or a scalar fallback.
+//
+// Every kernel gives bit-identical results on all three paths: sums and
+// extremes are accumulated in 8 lanes (element i goes to lane i % 8) and the
+// lanes are combined in one fixed order, which the scalar code follows too.
+// Extremes ignore NaNs; comparisons with NaN are false, as in scalar code.
+enum class ScanKernel
+{
+    Scalar,
+    Avx2,
+    Avx512
+};
+
+ScanKernel activeScanKernel();
+// Use `kernel`, or the best supported one below it; returns the kernel in use
+ScanKernel setScanKernel(ScanKernel kernel);
+const char *scanKernelName(ScanKernel kernel);
+
+double scanSum(const double *values, size_t count);
+double scanMax(const double *values, size_t count); // -infinity when count == 0
+double scanMin(const double *values, size_t count); // +infinity when count == 0
+double scanDot(const double *a, const double *b, size_t count); // sum of a[i] * b[i], lanes as for scanSum
+size_t scanCountAbove(const double *values, size_t count, double threshold);          // values > threshold
+size_t scanCountBetween(const double *values, size_t count, double lower, double upper); // lower < value <= upper
+// Write the positions of values in (lower, upper] to `out` in ascending order; returns how many
+size_t scanFilterBetween(const double *values, size_t count, double lower, double upper, std::uint32_t *out);
+// Set bit i % 64 of bits[i / 64] for each value in (lower, upper], clear the
+// others; writes (count + 63) / 64 words
+void scanMaskBetween(const double *values, size_t count, double lower, double upper, std::uint64_t *bits);
+// values[i] += delta for every i
+void scanAddToAll(double *values, size_t count, double delta);
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Binary snapshot layout (native endianness, every section padded to 8 bytes):
+//   SnapshotHeader
+//   ticker id column    uint32[rowCount]
+//   date column         int32[rowCount]
+//   open .. dividends   double[rowCount], one section per column
+//   tombstones          uint64[(rowCount + 63) / 64], one bit per deleted row
+//   dividend rows       uint64[(rowCount + 63) / 64], the dividend bitmap index
+//   ticker names        uint64 offsets[tickerCount + 1], then the concatenated characters
+//   tickerMap           uint64 offsets[tickerCount + 1], then RowIndex rows
+//   ticker tables       uint64 offsets[tickerCount + 1], then per ticker its
+//                       running totals and extreme tables (TickerSeries::savedTables)
+//   dateMap             int32 days[dateCount], uint64 offsets[dateCount + 1], then
+//                       RowIndex rows, RowIndex rows by volume, double maxClose[dateCount]
+//   date partitions     int32 months[partitionCount], uint64 rows[partitionCount],
+//                       double bounds[partitionCount][12] (minimum then maximum per field)
+// The checksum covers every byte after the header. Loading serves the columns
+// and the ticker tables from the mapped file and adopts every other index but
+// the (ticker, date) hash map, which holds no cold rows.
+struct SnapshotHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t headerSize;
+    std::uint64_t rowCount;
+    std::uint64_t tickerCount;
+    std::uint64_t dateCount;
+    std::uint64_t partitionCount;
+    std::uint64_t payloadSize;
+    std::uint64_t checksum;
+};
+
+constexpr char SNAPSHOT_MAGIC[8] = {'S', 'T', 'K', 'S', 'N', 'A', 'P', '\0'};
+constexpr std::uint32_t SNAPSHOT_VERSION = 3;
+
+// FNV-1a style hash over 64-bit words; size must be a multiple of 8
+std::uint64_t snapshotChecksum(const char *data, size_t size);
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "StockData.h"
+#include "DateUtils.h"
+#include "TickerDictionary.h"
+#include "Column.h"
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+struct ColdSegment;
+
+using RowIndex = std::uint32_t;
+constexpr RowIndex NO_ROW = UINT32_MAX;
+
+// Columnar (struct-of-arrays) storage. Every accepted record is stored here
+// exactly once; all indexes in StockDatabase refer to rows by position.
+// The first coldRows() rows may be served from mapped cold segments.
+struct StockColumns
+{
+    Column<std::uint32_t> ticker; // id in tickers
+    Column<DayNumber> date;
+    Column<double> open;
+    Column<double> high;
+    Column<double> low;
+    Column<double> close;
+    Column<double> volume;
+    Column<double> dividends;
+
+    TickerDictionary tickers;
+
+    std::vector<std::shared_ptr<const ColdSegment>> coldSegments; // back the cold rows, oldest first; shared by copies
+
+    std::vector<std::uint64_t> tombstones; // one bit per row, set once the row is deleted
+    size_t deletedRows = 0;
+    size_t coldDeletedRows = 0; // of deletedRows; they stay in their segment
+
+    size_t size() const { return open.size(); }
+    size_t coldRows() const { return open.coldSize(); }
+
+    // Bytes of the in-memory rows and the tombstones; the cold rows are mapped
+    size_t residentBytes() const
+    {
+        size_t bytes = ticker.hotValues().capacity() * sizeof(std::uint32_t) + date.hotValues().capacity() * sizeof(DayNumber) +
+                       tombstones.capacity() * sizeof(std::uint64_t);
+        for (const Column<double> *column : {&open, &high, &low, &close, &volume, &dividends})
+        {
+            bytes += column->hotValues().capacity() * sizeof(double);
+        }
+        return bytes;
+    }
+
+    void reserve(size_t rows)
+    {
+        ticker.reserve(rows);
+        date.reserve(rows);
+        open.reserve(rows);
+        high.reserve(rows);
+        low.reserve(rows);
+        close.reserve(rows);
+        volume.reserve(rows);
+        dividends.reserve(rows);
+    }
+
+    // Grow the tombstone bitmap after rows were appended to the columns directly
+    void extendTombstones() { tombstones.resize((size() + 63) / 64, 0); }
+
+    bool isDeleted(RowIndex i) const { return (tombstones[i >> 6] >> (i & 63)) & 1; }
+
+    void markDeleted(RowIndex i)
+    {
+        tombstones[i >> 6] |= std::uint64_t(1) << (i & 63);
+        ++deletedRows;
+        if (i < coldRows())
+        {
+            ++coldDeletedRows;
+        }
+    }
+
+    // Keep only `rows`, in that order and in memory. Row indices change, so
+    // every index must be rebuilt afterwards.
+    void keepRows(const std::vector<RowIndex> &rows)
+    {
+        ticker.gather(rows);
+        date.gather(rows);
+        open.gather(rows);
+        high.gather(rows);
+        low.gather(rows);
+        close.gather(rows);
+        volume.gather(rows);
+        dividends.gather(rows);
+        coldSegments.clear();
+        tombstones.assign((rows.size() + 63) / 64, 0);
+        deletedRows = 0;
+        coldDeletedRows = 0;
+    }
+
+    // Keep the cold rows and, after them, only the in-memory `rows` (none of
+    // them cold), in that order. In-memory row indices change; the cold rows
+    // and their tombstones stay as they are.
+    void keepHotRows(const std::vector<RowIndex> &rows)
+    {
+        ticker.gatherHot(rows);
+        date.gatherHot(rows);
+        open.gatherHot(rows);
+        high.gatherHot(rows);
+        low.gatherHot(rows);
+        close.gatherHot(rows);
+        volume.gatherHot(rows);
+        dividends.gatherHot(rows);
+        size_t cold = coldRows();
+        tombstones.resize((cold + rows.size() + 63) / 64);
+        if (cold % 64 != 0)
+        {
+            tombstones[cold / 64] &= (std::uint64_t(1) << (cold % 64)) - 1;
+        }
+        std::fill(tombstones.begin() + static_cast<std::ptrdiff_t>((cold + 63) / 64), tombstones.end(), 0);
+        deletedRows = coldDeletedRows;
+    }
+
+    // Drop deleted rows, keeping the survivors in order
+    void compact()
+    {
+        std::vector<RowIndex> kept;
+        kept.reserve(size() - deletedRows);
+        for (size_t i = 0; i < size(); ++i)
+        {
+            if (!isDeleted(static_cast<RowIndex>(i)))
+            {
+                kept.push_back(static_cast<RowIndex>(i));
+            }
+        }
+        keepRows(kept);
+    }
+
+    RowIndex append(std::uint32_t tickerId, DayNumber day, const StockData &record)
+    {
+        if (size() % 64 == 0)
+        {
+            tombstones.push_back(0);
+        }
+        ticker.push_back(tickerId);
+        date.push_back(day);
+        open.push_back(record.open);
+        high.push_back(record.high);
+        low.push_back(record.low);
+        close.push_back(record.close);
+        volume.push_back(record.volume);
+        dividends.push_back(record.dividends);
+        return static_cast<RowIndex>(size() - 1);
+    }
+
+    // Materialize a row as a StockData record (for output only)
+    StockData row(RowIndex i) const
+    {
+        return {formatDate(date[i]), tickers.name(ticker[i]), open[i], high[i], low[i], close[i], volume[i], dividends[i]};
+    }
+};
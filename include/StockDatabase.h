@@ -1,64 +1,186 @@
 #pragma once
 
 #include "StockData.h"
+#include "StockColumns.h"
+#include "TickerSeries.h"
+#include "ThresholdIndex.h"
+#include "FieldIndex.h"
+#include "RowRange.h"
+#include "ResultCache.h"
+#include "RollingWindow.h"
+#include "CorrelationMatrix.h"
+#include "DatePartitions.h"
+#include "RowBitmap.h"
+#include "RowFilter.h"
 #include <vector>
 #include <unordered_map>
 #include <string>
-#include <set>
-#include <queue>
+#include <string_view>
+#include <optional>
+#include <limits>
+#include <tuple>
+#include <mutex>
 
-// Comparator for sorting stocks by volume (13)
-struct VolumeComparator
-{
-    bool operator()(const StockData &a, const StockData &b)
-    {
-        return a.volume > b.volume;
-    }
-};
+struct CsvChunk;
 
-// Comparator for sorting stocks by closing price (14)
-struct ClosePriceComparator
+// All rows sharing one date, with the highest close among them and the same
+// rows ranked by volume (largest first)
+struct DateBucket
 {
-    bool operator()(const StockData &a, const StockData &b)
-    {
-        return a.close < b.close;
-    }
+    std::vector<RowIndex> rows;
+    std::vector<RowIndex> byVolume;
+    double maxClose = -std::numeric_limits<double>::infinity();
 };
 
-// Comparator for sorting stocks by dividends (query 15)
-struct DividendsComparator
+// Bytes the rows take in memory: the column values and tombstones kept there,
+// and every index (the result and rolling caches are budgeted on their own).
+// Cold rows add the size of their mapped segments, resident only while their
+// pages are.
+struct MemoryUsage
 {
-    bool operator()(const StockData &a, const StockData &b)
-    {
-        return a.dividends < b.dividends;
-    }
+    size_t columnBytes = 0;
+    size_t indexBytes = 0;
+    size_t mappedBytes = 0;
 };
 
 class StockDatabase
 {
 private:
-    std::vector<StockData> data;                                                               
-    std::unordered_map<std::string, std::vector<StockData>> tickerMap;                         
-    std::unordered_map<std::string, std::vector<StockData>> dateMap;                           
-    std::unordered_map<std::string, std::unordered_map<std::string, StockData>> tickerDateMap; 
+    StockColumns columns;
+    std::vector<TickerSeries> tickerMap;                       // by ticker id, empty when the ticker is absent
+    std::unordered_map<DayNumber, DateBucket> dateMap;
+    std::unordered_map<std::uint64_t, RowIndex> tickerDateMap; // keyed by tickerDateKey(), in-memory rows only
+    ThresholdIndex dateMaxCloses;                              // one DateBucket::maxClose per date
+    DatePartitions datePartitions;                             // the dates of dateMap grouped by month
+    RowBitmap dividendRows;                                    // rows with dividends > 0, deleted ones included
+    double compactionRatio = 0.25;                             // compact once this fraction of the rows is deleted
+    std::string coldSegmentPath;                               // empty unless cold partitions are kept on disk
+    int hotMonths = 0;                                         // newest months kept in memory when they are
+    bool compressCold = false;                                 // cold prices and volumes stored compressed
+
+    // A copy gets its own unlocked mutex, so StockDatabase stays copyable
+    struct BuildMutex
+    {
+        std::mutex mutex;
+        BuildMutex() = default;
+        BuildMutex(const BuildMutex &) {}
+        BuildMutex &operator=(const BuildMutex &) { return *this; }
+    };
+
+    // Indexed by StockField. Built on first use, so const queries may fill them
+    // in; rankingMutex makes that first build safe for concurrent readers.
+    mutable BuildMutex rankingMutex;
+    mutable std::tuple<FieldRanking<StockField::Open>, FieldRanking<StockField::High>, FieldRanking<StockField::Low>,
+                       FieldRanking<StockField::Close>, FieldRanking<StockField::Volume>, FieldRanking<StockField::Dividends>>
+        fieldRankings;
+
+    // Results of the costlier queries; writes drop only the entries of the tickers and dates they touch
+    mutable ResultCache resultCache;
+
+    // Rolling series already computed; extended as bars are appended to their ticker
+    mutable RollingCache rollingCache;
+
+    // Point lookups translate (ticker, date) to this key and probe the map once
+    static std::uint64_t tickerDateKey(std::uint32_t tickerId, DayNumber day)
+    {
+        return (static_cast<std::uint64_t>(tickerId) << 32) | static_cast<std::uint32_t>(day);
+    }
+
+    void mergeChunk(const CsvChunk &chunk, std::vector<std::vector<RowIndex>> &newTickerRows);
+    size_t indexAppendedRows(RowIndex firstRow, const std::vector<std::vector<RowIndex>> &newTickerRows);
+    void rebuildIndexes();
+    void rebuildDateIndexes();
+    void indexRow(RowIndex row);
+    void indexDividendRows(RowIndex firstRow);
+    bool moveColdPartitions();
+    void renumberHotRows(const std::vector<RowIndex> &order);
+    const TickerSeries *findSeries(std::string_view ticker) const;
+    const RowIndex *findRow(std::string_view ticker, std::string_view date) const;
+    void resetFieldRankings();
+    void invalidateResults(const std::vector<RowIndex> &rows);
+    ReturnMatrix buildReturnMatrix(std::string_view startDate, std::string_view endDate, const std::vector<std::string_view> &tickers,
+                                   std::vector<std::string_view> &names) const;
+    template <typename Compute>
+    double cachedPeriodValue(CachedQuery query, std::string_view ticker, std::string_view startDate, std::string_view endDate,
+                             Compute compute) const;
+    template <StockField F>
+    std::vector<RowIndex> rankRows(size_t k, bool distinctTicker, bool highest) const;
+    std::vector<RowIndex> rankRows(StockField field, size_t k, bool distinctTicker, bool highest) const;
+    RowBitmap selectRows(const RowFilter &filter) const;
+    template <typename Visit>
+    void visitSelected(const RowBitmap &selected, StockField field, Visit visit) const;
 
 public:
+    // Query results that are RowRanges or string_views point into the database
+    // and stay valid until the next loadData, loadSnapshot, addStockRecord(s),
+    // insertRecord, ingestChunks, deleteTicker, eraseTicker, compact,
+    // freezeColdPartitions or clear (see RowRange.h).
     void loadData(const std::string &filename);
+    bool saveSnapshot(const std::string &filename) const;
+    bool loadSnapshot(const std::string &filename);
     void addStockRecord(const StockData &record);
+    size_t addStockRecords(const StockData *records, size_t count, bool report = false);
+    size_t addStockRecords(const std::vector<StockData> &records, bool report = false);
+    size_t ingestChunks(const std::vector<CsvChunk> &chunks);
+    // Drop every row and index; settings (cold storage, cache budget, compaction ratio) stay
+    void clear();
     void deleteTicker(const std::string &ticker);
-    std::vector<StockData> getDataByDate(const std::string &date);
-    double getAverageClosePrice(const std::string &ticker);
-    double getHighestPriceInPeriod(const std::string &ticker, const std::string &startDate, const std::string &endDate);
-    std::set<std::string> getAllUniqueTickers();
-    bool doesTickerExist(const std::string &ticker);
-    int countDatesAboveThreshold(double threshold);
-    double getClosingPrice(const std::string &ticker, const std::string &date);
-    std::vector<std::pair<std::string, double>> getDatesAndClosingPrices(const std::string &ticker);
-    double getTotalVolume(const std::string &ticker);
-    bool doesDataExist(const std::string &ticker, const std::string &date);
-    std::pair<double, double> getOpeningAndClosingPrices(const std::string &ticker, const std::string &date);
-    double getDividend(const std::string &ticker, const std::string &date);
-    std::vector<StockData> getTop10StocksByVolume(const std::string &date);
-    std::vector<StockData> getBottom5StocksByClosingPrice();
-    std::vector<StockData> getTop5StocksByDividends();
+    bool insertRecord(const StockData &record); // addStockRecord without the report; false on a bad date
+    bool eraseTicker(std::string_view ticker);  // deleteTicker without the report; false when absent
+    void compact();
+    void setCompactionRatio(double ratio);
+    // Move the rows of all but the newest `months` months to a mapped segment
+    // at `filename`, optionally compressed. Loads, snapshot loads and
+    // compactions repeat this for the in-memory rows that aged out since,
+    // writing each batch to a new segment (`filename`.1, .2, ...) and leaving
+    // the earlier ones as they are; appended rows stay in memory until then.
+    // Returns the number of cold rows.
+    size_t freezeColdPartitions(const std::string &filename, int months, bool compress = false);
+    const DatePartitions &partitions() const;
+    MemoryUsage memoryUsage() const;
+    void setResultCacheBudget(size_t bytes); // 0 disables the result cache
+    ResultCache::Stats resultCacheStats() const;
+    RowRange getDataByDate(std::string_view date) const;
+    double getAverageClosePrice(std::string_view ticker) const;
+    double getAverageClosePrice(std::string_view ticker, std::string_view startDate, std::string_view endDate) const;
+    double getHighestPriceInPeriod(std::string_view ticker, std::string_view startDate, std::string_view endDate) const;
+    double getLowestPriceInPeriod(std::string_view ticker, std::string_view startDate, std::string_view endDate) const;
+    std::vector<std::string_view> getAllUniqueTickers() const;
+    bool doesTickerExist(std::string_view ticker) const;
+    int countDatesAboveThreshold(double threshold) const;
+    int countDatesBelowThreshold(double threshold) const;
+    int countDatesBetweenThresholds(double lower, double upper) const;
+    std::optional<double> getClosingPrice(std::string_view ticker, std::string_view date) const;
+    RowRange getDatesAndClosingPrices(std::string_view ticker) const;
+    RollingRange getRollingSeries(std::string_view ticker, RollingMetric metric, size_t window) const;
+    double getTotalVolume(std::string_view ticker) const;
+    double getTotalVolume(std::string_view ticker, std::string_view startDate, std::string_view endDate) const;
+    double getTotalDividends(std::string_view ticker, std::string_view startDate, std::string_view endDate) const;
+    bool doesDataExist(std::string_view ticker, std::string_view date) const;
+    std::optional<std::pair<double, double>> getOpeningAndClosingPrices(std::string_view ticker, std::string_view date) const;
+    std::optional<double> getDividend(std::string_view ticker, std::string_view date) const;
+    RowRange getTop10StocksByVolume(std::string_view date) const;
+    RowRange getTopStocksOnDate(std::string_view date, StockField field, size_t k) const;
+    std::vector<std::pair<std::string_view, double>> getTopTickersByVolume(std::string_view startDate, std::string_view endDate, size_t k) const;
+    // Returns of each ticker (all, or `tickers`) between consecutive dates of the period
+    CorrelationMatrix getCorrelationMatrix(std::string_view startDate, std::string_view endDate,
+                                           const std::vector<std::string_view> &tickers = {}, unsigned threadCount = 0) const;
+    std::vector<CorrelatedPair> getTopCorrelatedPairs(std::string_view startDate, std::string_view endDate, size_t n,
+                                                      const std::vector<std::string_view> &tickers = {}, unsigned threadCount = 0) const;
+    RowRange getBottom5StocksByClosingPrice() const;
+    RowRange getTop5StocksByDividends() const;
+    RowRange topK(StockField field, size_t k, bool distinctTicker = false) const;
+    RowRange bottomK(StockField field, size_t k, bool distinctTicker = false) const;
+
+    // Filter engine: every live row that meets all conditions of `filter` (see
+    // RowFilter.h). Partitions the zone maps rule out are skipped, the
+    // dividend flag is a bitmap index and value ranges are scanned with the
+    // scan kernels; filters that one index answers on its own go to that index.
+    RowBitmap filterRows(const RowFilter &filter) const;
+    size_t countRows(const RowFilter &filter) const;
+    size_t countDates(const RowFilter &filter) const; // distinct dates of the selected rows
+    FilterAggregate aggregateRows(const RowFilter &filter, StockField field) const;
+    // The K selected rows with the largest (or smallest) values of a field, in
+    // that order; at most one row per ticker when distinctTicker
+    RowRange topRows(const RowFilter &filter, StockField field, size_t k, bool highest = true, bool distinctTicker = false) const;
 };
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "StockColumns.h"
+#include <cmath>
+#include <functional>
+#include <vector>
+
+enum class StockField
+{
+    Open,
+    High,
+    Low,
+    Close,
+    Volume,
+    Dividends
+};
+
+// Compile-time selection of the column that stores a field
+template <StockField F>
+const Column<double> &fieldColumn(const StockColumns &columns)
+{
+    if constexpr (F == StockField::Open)
+    {
+        return columns.open;
+    }
+    else if constexpr (F == StockField::High)
+    {
+        return columns.high;
+    }
+    else if constexpr (F == StockField::Low)
+    {
+        return columns.low;
+    }
+    else if constexpr (F == StockField::Close)
+    {
+        return columns.close;
+    }
+    else if constexpr (F == StockField::Volume)
+    {
+        return columns.volume;
+    }
+    else
+    {
+        return columns.dividends;
+    }
+}
+
+// Runtime counterpart of fieldColumn
+inline const Column<double> &fieldColumn(const StockColumns &columns, StockField field)
+{
+    switch (field)
+    {
+    case StockField::Open:
+        return columns.open;
+    case StockField::High:
+        return columns.high;
+    case StockField::Low:
+        return columns.low;
+    case StockField::Close:
+        return columns.close;
+    case StockField::Volume:
+        return columns.volume;
+    default:
+        return columns.dividends;
+    }
+}
+
+// True when row a with value x orders before row b with value y: by Compare
+// on the values, NaN after every number, ties (NaN with NaN too) by row index.
+// NaN has to be placed explicitly, as Compare is false both ways for it and
+// the sorts and binary searches over these orders need a strict weak ordering.
+template <typename Compare>
+bool ordersBefore(double x, RowIndex a, double y, RowIndex b)
+{
+    bool xNan = std::isnan(x), yNan = std::isnan(y);
+    if (xNan || yNan)
+    {
+        return xNan != yNan ? yNan : a < b;
+    }
+    if (x != y)
+    {
+        return Compare()(x, y);
+    }
+    return a < b;
+}
+
+// Orders rows by one field as ordersBefore does, so the order is total
+template <StockField F, typename Compare = std::less<double>>
+struct FieldComparator
+{
+    const StockColumns *columns;
+    bool operator()(RowIndex a, RowIndex b) const
+    {
+        const Column<double> &column = fieldColumn<F>(*columns);
+        return ordersBefore<Compare>(column[a], a, column[b], b);
+    }
+};
+
+// The same order over a ColumnReader, for sorts that read every row once or more
+template <typename Compare = std::less<double>>
+struct ReaderComparator
+{
+    const ColumnReader<double> *values;
+    bool operator()(RowIndex a, RowIndex b) const
+    {
+        return ordersBefore<Compare>((*values)[a], a, (*values)[b], b);
+    }
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Sorted multiset of values (one per date) so "how many values lie above /
+// below / between thresholds" is a binary search instead of a scan
+class ThresholdIndex
+{
+private:
+    std::vector<double> values;
+
+public:
+    size_t size() const { return values.size(); }
+
+    void assign(std::vector<double> newValues)
+    {
+        values = std::move(newValues);
+        std::sort(values.begin(), values.end());
+    }
+
+    void add(double value)
+    {
+        values.insert(std::upper_bound(values.begin(), values.end(), value), value);
+    }
+
+    void remove(double value)
+    {
+        auto it = std::lower_bound(values.begin(), values.end(), value);
+        if (it != values.end() && *it == value)
+        {
+            values.erase(it);
+        }
+    }
+
+    void replace(double oldValue, double newValue)
+    {
+        remove(oldValue);
+        add(newValue);
+    }
+
+    // Values strictly greater than threshold
+    size_t countAbove(double threshold) const
+    {
+        return values.end() - std::upper_bound(values.begin(), values.end(), threshold);
+    }
+
+    // Values strictly less than threshold
+    size_t countBelow(double threshold) const
+    {
+        return std::lower_bound(values.begin(), values.end(), threshold) - values.begin();
+    }
+
+    // Values in (lower, upper]
+    size_t countBetween(double lower, double upper) const
+    {
+        return lower < upper ? countAbove(lower) - countAbove(upper) : 0;
+    }
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Maps ticker symbols to dense uint32 ids. Ids are never reused, so they stay
+// valid for the lifetime of the database even after a ticker is deleted.
+class TickerDictionary
+{
+private:
+    std::deque<std::string> names; // deque keeps the strings (and views into them) stable
+    std::unordered_map<std::string_view, std::uint32_t> ids;
+
+public:
+    static constexpr std::uint32_t npos = UINT32_MAX;
+
+    TickerDictionary() = default;
+    TickerDictionary(TickerDictionary &&) = default;
+    TickerDictionary &operator=(TickerDictionary &&) = default;
+
+    // Copies re-intern every name so the views point into the new storage
+    TickerDictionary(const TickerDictionary &other)
+    {
+        for (const std::string &name : other.names)
+        {
+            intern(name);
+        }
+    }
+
+    TickerDictionary &operator=(const TickerDictionary &other)
+    {
+        if (this != &other)
+        {
+            *this = TickerDictionary(other);
+        }
+        return *this;
+    }
+
+    std::uint32_t intern(std::string_view symbol)
+    {
+        auto it = ids.find(symbol);
+        if (it != ids.end())
+        {
+            return it->second;
+        }
+        std::uint32_t id = static_cast<std::uint32_t>(names.size());
+        names.emplace_back(symbol);
+        ids.emplace(names.back(), id);
+        return id;
+    }
+
+    // Returns npos for unknown symbols; never inserts
+    std::uint32_t find(std::string_view symbol) const
+    {
+        auto it = ids.find(symbol);
+        return it == ids.end() ? npos : it->second;
+    }
+
+    const std::string &name(std::uint32_t id) const { return names[id]; }
+    size_t size() const { return names.size(); }
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "StockColumns.h"
+#include "RangeExtremeTable.h"
+#include "PrefixSums.h"
+#include <functional>
+#include <utility>
+#include <vector>
+
+// All rows of one ticker ordered by date (rows sharing a date keep insertion
+// order), with range-max of `high`, range-min of `low` and prefix sums of
+// `close`, `volume` and `dividends` over that order. The tables over a
+// leading run of cold rows are frozen into their cold segment (see freeze),
+// so only the rows and dates of that run stay in memory.
+class TickerSeries
+{
+private:
+    size_t frozen = 0; // leading positions whose tables are mapped
+    std::vector<RowIndex> rows;
+    std::vector<DayNumber> days; // days[i] is the date of rows[i], kept for binary search
+    RangeExtremeTable<std::greater<double>> highs;
+    RangeExtremeTable<std::less<double>> lows;
+    PrefixSums closeSums;
+    PrefixSums volumeSums;
+    PrefixSums dividendSums;
+
+    // Bring the frozen tables back into memory, before an insert among frozen rows
+    void thaw(const StockColumns &columns);
+
+public:
+    bool empty() const { return rows.empty(); }
+    size_t size() const { return rows.size(); }
+    const std::vector<RowIndex> &rowIndices() const { return rows; }
+    DayNumber day(size_t i) const { return days[i]; }
+
+    // Insert one row; O(log n) when it is not older than the newest row, O(n)
+    // otherwise. A row older than a frozen row brings the tables back into memory.
+    void insert(RowIndex row, const StockColumns &columns);
+
+    // Insert a batch of rows: appended one by one when none is older than the
+    // newest row, otherwise merged in one pass, the prefix sums shifted and
+    // the extreme tables rebuilt from the first insert position on
+    void insert(const std::vector<RowIndex> &newRows, const StockColumns &columns);
+
+    void clear();
+
+    // Snapshot support: the running totals and extreme tables one after
+    // another, and adopting them for `newRows`, all cold, instead of
+    // recomputing them; they are read in place, from the mapped snapshot.
+    // restore returns false when `count` does not fit that many rows.
+    std::vector<double> savedTables() const;
+    bool restore(std::vector<RowIndex> newRows, const StockColumns &columns, const double *tables, size_t count);
+
+    // Freezing, once the rows before `coldEnd` are cold: frozenTables returns
+    // how many leading positions hold such rows and appends their tables'
+    // entries that are still in memory to `out`; freeze(count) then reads
+    // those from `mapped`, a copy of them in the new segment, and returns how
+    // many doubles it took from there.
+    size_t frozenTables(RowIndex coldEnd, std::vector<double> &out) const;
+    size_t freeze(size_t count, const double *mapped);
+
+    // Bytes of the series kept in memory
+    size_t residentBytes() const;
+
+    // Rows from `firstRow` on moved: row r is now newRows[r - firstRow]. Only
+    // the row numbers change; the values and their order stay.
+    void renumber(RowIndex firstRow, const std::vector<RowIndex> &newRows);
+
+    // Positions [first, last) of the rows dated within [startDay, endDay]
+    std::pair<size_t, size_t> findRange(DayNumber startDay, DayNumber endDay) const;
+
+    // Require first < last; frozen edge blocks are read from `columns`
+    double maxHigh(size_t first, size_t last, const StockColumns &columns) const
+    {
+        return highs.query(first, last, [this, &columns](size_t i)
+                           { return columns.high[rows[i]]; });
+    }
+    double minLow(size_t first, size_t last, const StockColumns &columns) const
+    {
+        return lows.query(first, last, [this, &columns](size_t i)
+                          { return columns.low[rows[i]]; });
+    }
+
+    double sumClose(size_t first, size_t last) const { return closeSums.sum(first, last); }
+    double sumVolume(size_t first, size_t last) const { return volumeSums.sum(first, last); }
+    double sumDividends(size_t first, size_t last) const { return dividendSums.sum(first, last); }
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads, each with its own task deque. A worker takes
+// its newest task first and, when its deque is empty, steals the oldest task
+// of another worker, so uneven tasks still keep every core busy.
+class WorkStealingPool
+{
+public:
+    using Task = std::function<void()>;
+
+    explicit WorkStealingPool(unsigned threadCount = 0); // 0 = hardware concurrency
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    // Queue a task; tasks are spread round-robin over the workers
+    void submit(Task task);
+    // Block until every submitted task has finished
+    void wait();
+    unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> nextQueue{0};
+    std::atomic<size_t> queued{0}; // tasks waiting in some deque
+
+    std::mutex stateMutex;
+    std::condition_variable wake; // tasks queued or stopping
+    std::condition_variable idle; // pending dropped to zero
+    size_t pending = 0;           // submitted and not yet finished
+    bool stopping = false;
+
+    bool popLocal(size_t worker, Task &task);
+    bool steal(size_t worker, Task &task);
+    void run(size_t worker);
+};
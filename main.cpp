@@ -1,6 +1,16 @@
 #include "StockDatabase.h"
+#include "BufferedWriter.h"
+#include "BatchRunner.h"
+#include "ConcurrencyStress.h"
+#include "CsvFollower.h"
+#include "Instrumentation.h"
 #include <iostream>
 #include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
 
 void displayMenu()
 {
@@ -22,30 +32,204 @@ void displayMenu()
     std::cout << "15. Maintain a list of the top 5 stocks with the highest dividends paid\n";
     std::cout << "16. Add a new stock record\n";
     std::cout << "17. Delete a ticker and its data\n";
+    std::cout << "18. Show query latency and counters (text or json)\n";
+    std::cout << "19. Rolling analytics for a ticker (sma, ema, vwap, return, volatility)\n";
+    std::cout << "20. Find the most correlated ticker pairs in a given time period\n";
+    std::cout << "21. Filter rows by conditions and aggregate them (count, dates, sum, avg, max, min, top, bottom)\n";
     std::cout << "0. Exit\n";
     std::cout << "Enter your choice: ";
 }
 
-#include <chrono>
+// Prefer the binary snapshot when it is newer than the CSV; otherwise parse the CSV and refresh the snapshot
+template <typename Database>
+void loadDatabase(Database &db, const std::string &csvPath, const std::string &snapshotPath)
+{
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    bool csvExists = fs::exists(csvPath, ec);
+    if (fs::exists(snapshotPath, ec) && (!csvExists || fs::last_write_time(snapshotPath, ec) > fs::last_write_time(csvPath, ec)))
+    {
+        auto start = std::chrono::steady_clock::now();
+        if (db.loadSnapshot(snapshotPath))
+        {
+            auto duration = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+            std::cout << "Loaded snapshot " << snapshotPath << " in " << duration.count() << " ms\n";
+            return;
+        }
+        std::cerr << "Snapshot " << snapshotPath << " is invalid, loading " << csvPath << " instead" << std::endl;
+    }
+
+    db.loadData(csvPath);
+    if (csvExists && !db.saveSnapshot(snapshotPath))
+    {
+        std::cerr << "Could not write snapshot " << snapshotPath << std::endl;
+    }
+}
 
-int main()
+// Parse and index whatever was appended to the followed CSV since the last
+// call; a replaced or truncated file is loaded again from scratch
+size_t ingestAppended(StockDatabase &db, CsvFollower &follower)
+{
+    std::vector<CsvChunk> chunks;
+    if (!follower.poll(chunks))
+    {
+        return 0;
+    }
+    if (follower.fromStart())
+    {
+        db.clear();
+    }
+    return db.ingestChunks(chunks);
+}
+
+// Non-interactive mode: app --batch <file|-> [--threads N]
+int runBatchMode(StockDatabase &db, const std::string &path, unsigned threadCount)
+{
+    // Keep stdout for query results only
+    std::streambuf *stdoutBuffer = std::cout.rdbuf(std::cerr.rdbuf());
+    loadDatabase(db, "data/new.csv", "data/new.snapshot");
+    std::cout.rdbuf(stdoutBuffer);
+
+    if (path == "-")
+    {
+        runBatch(db, std::cin, std::cout, threadCount);
+        return 0;
+    }
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::cerr << "Could not open batch file " << path << std::endl;
+        return 1;
+    }
+    runBatch(db, file, std::cout, threadCount);
+    return 0;
+}
+
+// Readers against a continuous writer: app --stress [--threads N] [--seconds S]
+int runStressMode(unsigned threadCount, double seconds)
+{
+    ConcurrentStockDatabase db;
+    loadDatabase(db, "data/new.csv", "data/new.snapshot");
+    return runConcurrencyStress(db, threadCount, seconds) == 0 ? 0 : 1;
+}
+
+int main(int argc, char *argv[])
 {
     StockDatabase db;
-    db.loadData("data/new.csv");
+
+    std::string batchPath;
+    unsigned threadCount = 0;
+    bool stress = false;
+    bool follow = false;
+    double stressSeconds = 5;
+    double cacheMegabytes = -1;
+    std::string coldSegmentPath;
+    int hotMonths = 12;
+    bool compressCold = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--batch") == 0 && i + 1 < argc)
+        {
+            batchPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--stress") == 0)
+        {
+            stress = true;
+        }
+        else if (std::strcmp(argv[i], "--follow") == 0)
+        {
+            follow = true;
+        }
+        else if (std::strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+        {
+            stressSeconds = std::strtod(argv[++i], nullptr);
+        }
+        else if (std::strcmp(argv[i], "--cache-mb") == 0 && i + 1 < argc)
+        {
+            cacheMegabytes = std::strtod(argv[++i], nullptr);
+        }
+        else if (std::strcmp(argv[i], "--cold-segment") == 0 && i + 1 < argc)
+        {
+            coldSegmentPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--hot-months") == 0 && i + 1 < argc)
+        {
+            hotMonths = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--compress-cold") == 0)
+        {
+            compressCold = true;
+        }
+        else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            threadCount = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--batch <file|-> | --stress [--seconds S] | --follow] [--threads N] [--cache-mb M]"
+                      << " [--cold-segment FILE [--hot-months N] [--compress-cold]]" << std::endl;
+            return 1;
+        }
+    }
+    if (cacheMegabytes >= 0)
+    {
+        db.setResultCacheBudget(static_cast<size_t>(cacheMegabytes * 1024 * 1024));
+    }
+    // Applied again once the data is loaded
+    if (!coldSegmentPath.empty())
+    {
+        db.freezeColdPartitions(coldSegmentPath, hotMonths, compressCold);
+    }
+    if (stress)
+    {
+        return runStressMode(threadCount, stressSeconds);
+    }
+    if (!batchPath.empty())
+    {
+        return runBatchMode(db, batchPath, threadCount);
+    }
+
+    // Follow mode reads the CSV itself and keeps reading what gets appended to it
+    std::optional<CsvFollower> follower;
+    if (follow)
+    {
+        follower.emplace("data/new.csv");
+        std::cout << "Following data/new.csv, " << ingestAppended(db, *follower) << " rows loaded\n";
+    }
+    else
+    {
+        loadDatabase(db, "data/new.csv", "data/new.snapshot");
+    }
 
     int choice;
     std::string date, ticker, startDate, endDate;
     double threshold;
-    std::vector<StockData> result;
-    std::vector<std::pair<std::string, double>> datePricePairs;
-    std::pair<double, double> openClosePrices;
-    double value;
+    RowRange result;
+    RowRange datePrices;
+    RollingRange rolling;
+    RollingMetric metric = RollingMetric::Sma;
+    size_t window = 0;
+    std::vector<CorrelatedPair> pairs;
+    std::string filterResult;
+    BufferedWriter writer(std::cout);
+    std::pair<double, double> openClosePrices(0, 0);
+    bool openCloseFound = false;
+    std::optional<double> price;
+    double value = 0;
 
     while (true)
     {
         displayMenu();
         std::cin >> choice;
 
+        if (follower && follower->waitForAppend(0))
+        {
+            if (size_t added = ingestAppended(db, *follower))
+            {
+                std::cout << "Ingested " << added << " new rows\n";
+            }
+        }
+
         auto start = std::chrono::high_resolution_clock::now();
 
         switch (choice)
@@ -79,11 +263,12 @@ int main()
             start = std::chrono::high_resolution_clock::now();
             {
                 auto uniqueTickers = db.getAllUniqueTickers();
-                std::cout << "Unique tickers:\n";
-                for (const auto &t : uniqueTickers)
+                writer << "Unique tickers:\n";
+                for (std::string_view t : uniqueTickers)
                 {
-                    std::cout << t << "\n";
+                    writer << t << '\n';
                 }
+                writer.flush();
             }
             break;
 
@@ -102,12 +287,14 @@ int main()
             break;
 
         case 6:
+        {
             std::cout << "Enter threshold: ";
             std::cin >> threshold;
             start = std::chrono::high_resolution_clock::now();
-            value = db.countDatesAboveThreshold(threshold);
-            std::cout << "Number of dates with at least one stock closing above " << threshold << ": " << value << "\n";
+            size_t dates = static_cast<size_t>(db.countDatesAboveThreshold(threshold));
+            std::cout << "Number of dates with at least one stock closing above " << threshold << ": " << dates << "\n";
             break;
+        }
 
         case 7:
             std::cout << "Enter ticker: ";
@@ -115,14 +302,14 @@ int main()
             std::cout << "Enter date (YYYY-MM-DD): ";
             std::cin >> date;
             start = std::chrono::high_resolution_clock::now();
-            value = db.getClosingPrice(ticker, date);
+            price = db.getClosingPrice(ticker, date);
             break;
 
         case 8:
             std::cout << "Enter ticker: ";
             std::cin >> ticker;
             start = std::chrono::high_resolution_clock::now();
-            datePricePairs = db.getDatesAndClosingPrices(ticker);
+            datePrices = db.getDatesAndClosingPrices(ticker);
             break;
 
         case 9:
@@ -154,7 +341,15 @@ int main()
             std::cout << "Enter date (YYYY-MM-DD): ";
             std::cin >> date;
             start = std::chrono::high_resolution_clock::now();
-            openClosePrices = db.getOpeningAndClosingPrices(ticker, date);
+            if (auto prices = db.getOpeningAndClosingPrices(ticker, date))
+            {
+                openClosePrices = *prices;
+                openCloseFound = true;
+            }
+            else
+            {
+                openCloseFound = false;
+            }
             break;
 
         case 12:
@@ -163,7 +358,7 @@ int main()
             std::cout << "Enter date (YYYY-MM-DD): ";
             std::cin >> date;
             start = std::chrono::high_resolution_clock::now();
-            value = db.getDividend(ticker, date);
+            price = db.getDividend(ticker, date);
             break;
 
         case 13:
@@ -215,6 +410,79 @@ int main()
             break;
         }
 
+        case 18:
+        {
+            std::string format;
+            std::cout << "Enter format (text/json): ";
+            std::cin >> format;
+            if (format == "json")
+            {
+                writeInstrumentationJson(std::cout);
+            }
+            else
+            {
+                writeInstrumentationText(std::cout);
+            }
+            break;
+        }
+
+        case 19:
+        {
+            std::string metricName;
+            std::cout << "Enter ticker: ";
+            std::cin >> ticker;
+            std::cout << "Enter metric (sma/ema/vwap/return/volatility): ";
+            std::cin >> metricName;
+            std::cout << "Enter window (bars): ";
+            std::cin >> window;
+            if (!parseRollingMetric(metricName, metric))
+            {
+                std::cout << "Unknown metric " << metricName << ".\n";
+                continue;
+            }
+            start = std::chrono::high_resolution_clock::now();
+            rolling = db.getRollingSeries(ticker, metric, window);
+            break;
+        }
+
+        case 20:
+        {
+            size_t count;
+            std::cout << "Enter start date (YYYY-MM-DD): ";
+            std::cin >> startDate;
+            std::cout << "Enter end date (YYYY-MM-DD): ";
+            std::cin >> endDate;
+            std::cout << "Enter number of pairs: ";
+            std::cin >> count;
+            start = std::chrono::high_resolution_clock::now();
+            pairs = db.getTopCorrelatedPairs(startDate, endDate, count);
+            break;
+        }
+
+        case 21:
+        {
+            std::string line, error;
+            std::cout << "Enter output and conditions (e.g. avg close date>=2020-01-01 dividends>0 close<10): ";
+            std::getline(std::cin >> std::ws, line);
+            std::vector<std::string> words;
+            std::istringstream in(line);
+            for (std::string word; in >> word;)
+            {
+                words.push_back(word);
+            }
+            FilterQuery query;
+            if (!parseFilterQuery(words, query, error))
+            {
+                std::cout << "Invalid filter: " << error << ".\n";
+                continue;
+            }
+            start = std::chrono::high_resolution_clock::now();
+            BufferedWriter capture;
+            writeFilterResult(db, query, capture);
+            filterResult = capture.take();
+            break;
+        }
+
         case 0:
             std::cout << "Exiting...\n";
             return 0;
@@ -233,87 +501,108 @@ int main()
         switch (choice)
         {
         case 1:
-            for (const auto &record : result)
+            for (RowRef row : result)
             {
-                std::cout << "Ticker: " << record.ticker << ", Open: " << record.open << ", High: " << record.high
-                          << ", Low: " << record.low << ", Close: " << record.close << ", Volume: " << record.volume
-                          << ", Dividends: " << record.dividends << "\n";
+                writer << "Ticker: " << row.ticker() << ", Open: " << row.open() << ", High: " << row.high()
+                       << ", Low: " << row.low() << ", Close: " << row.close() << ", Volume: " << row.volume()
+                       << ", Dividends: " << row.dividends() << '\n';
             }
             break;
 
         case 2:
-            std::cout << "Average closing price for " << ticker << ": " << value << "\n";
+            writer << "Average closing price for " << ticker << ": " << value << "\n";
             break;
 
         case 3:
-            std::cout << "Highest price for " << ticker << " between " << startDate << " and " << endDate << ": " << value << "\n";
+            writer << "Highest price for " << ticker << " between " << startDate << " and " << endDate << ": " << value << "\n";
             break;
 
         case 7:
-            if (value != -1)
+            if (price)
             {
-                std::cout << "Closing price for " << ticker << " on " << date << ": " << value << "\n";
+                writer << "Closing price for " << ticker << " on " << date << ": " << *price << "\n";
             }
             else
             {
-                std::cout << "Data not found.\n";
+                writer << "Data not found.\n";
             }
             break;
 
         case 8:
-            for (const auto &pair : datePricePairs)
+            for (RowRef row : datePrices)
             {
-                std::cout << "Date: " << pair.first << ", Close: " << pair.second << "\n";
+                writer << "Date: " << row.date() << ", Close: " << row.close() << '\n';
             }
             break;
 
         case 9:
-            std::cout << "Total trading volume for " << ticker << ": " << value << "\n";
+            writer << "Total trading volume for " << ticker << ": " << value << "\n";
             break;
 
         case 11:
-            if (openClosePrices.first != -1)
+            if (openCloseFound)
             {
-                std::cout << "Open: " << openClosePrices.first << ", Close: " << openClosePrices.second << "\n";
+                writer << "Open: " << openClosePrices.first << ", Close: " << openClosePrices.second << "\n";
             }
             else
             {
-                std::cout << "Data not found.\n";
+                writer << "Data not found.\n";
             }
             break;
 
         case 12:
-            if (value != -1)
+            if (price)
             {
-                std::cout << "Dividend for " << ticker << " on " << date << ": " << value << "\n";
+                writer << "Dividend for " << ticker << " on " << date << ": " << *price << "\n";
             }
             else
             {
-                std::cout << "Data not found.\n";
+                writer << "Data not found.\n";
             }
             break;
 
         case 13:
-            for (const auto &record : result)
+            for (RowRef row : result)
             {
-                std::cout << "Ticker: " << record.ticker << ", Volume: " << record.volume << "\n";
+                writer << "Ticker: " << row.ticker() << ", Volume: " << row.volume() << '\n';
             }
             break;
 
         case 14:
-            for (const auto &record : result)
+            for (RowRef row : result)
             {
-                std::cout << "Ticker: " << record.ticker << ", Close: " << record.close << "\n";
+                writer << "Ticker: " << row.ticker() << ", Close: " << row.close() << '\n';
             }
             break;
 
         case 15:
-            for (const auto &record : result)
+            for (RowRef row : result)
             {
-                std::cout << "Ticker: " << record.ticker << ", Dividends: " << record.dividends << "\n";
+                writer << "Ticker: " << row.ticker() << ", Dividends: " << row.dividends() << '\n';
             }
             break;
+
+        case 19:
+            for (size_t i = 0; i < rolling.size(); ++i)
+            {
+                writer << "Date: " << rolling.row(i).date() << ", " << rollingMetricName(metric) << "(" << window
+                       << "): " << rolling.value(i) << '\n';
+            }
+            break;
+
+        case 20:
+            for (const CorrelatedPair &pair : pairs)
+            {
+                writer << pair.first << " / " << pair.second << ": correlation " << pair.correlation
+                       << ", covariance " << pair.covariance << '\n';
+            }
+            break;
+
+        case 21:
+            writer << filterResult;
+            break;
         }
+        writer.flush();
     }
 
     return 0;
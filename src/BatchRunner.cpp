@@ -0,0 +1,447 @@
+#include "BatchRunner.h"
+#include "BufferedWriter.h"
+#include "Instrumentation.h"
+#include "WorkStealingPool.h"
+#include <algorithm>
+#include <charconv>
+#include <istream>
+#include <ostream>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+    // Number of inputs each menu choice takes, indexed by choice; query 21 takes at least one
+    constexpr int ARG_COUNTS[] = {0, 1, 1, 3, 0, 1, 1, 2, 1, 1, 2, 2, 2, 1, 0, 0, 8, 1, 1, 3, 3, 1};
+    constexpr int MAX_CHOICE = 21;
+
+    constexpr size_t TASK_QUERIES = 32;      // queries per pool task
+    constexpr size_t SEGMENT_QUERIES = 8192; // read-only queries buffered before their results are written
+
+    bool parseCount(const std::string &text, size_t &value)
+    {
+        auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+        return result.ec == std::errc() && result.ptr == text.data() + text.size();
+    }
+
+    bool parseNumber(const std::string &text, double &value)
+    {
+        const char *first = text.data();
+        const char *last = first + text.size();
+        if (first != last && *first == '+')
+        {
+            ++first;
+        }
+        auto result = std::from_chars(first, last, value);
+        return result.ec == std::errc() && result.ptr == last;
+    }
+
+    // Same result text as the interactive menu prints for the query
+    void writeQueryResult(const StockDatabase &db, const BatchQuery &query, BufferedWriter &writer)
+    {
+        const std::vector<std::string> &args = query.args;
+        switch (query.choice)
+        {
+        case 1:
+            for (RowRef row : db.getDataByDate(args[0]))
+            {
+                writer << "Ticker: " << row.ticker() << ", Open: " << row.open() << ", High: " << row.high()
+                       << ", Low: " << row.low() << ", Close: " << row.close() << ", Volume: " << row.volume()
+                       << ", Dividends: " << row.dividends() << '\n';
+            }
+            break;
+
+        case 2:
+            writer << "Average closing price for " << args[0] << ": " << db.getAverageClosePrice(args[0]) << "\n";
+            break;
+
+        case 3:
+            writer << "Highest price for " << args[0] << " between " << args[1] << " and " << args[2] << ": "
+                   << db.getHighestPriceInPeriod(args[0], args[1], args[2]) << "\n";
+            break;
+
+        case 4:
+            writer << "Unique tickers:\n";
+            for (std::string_view ticker : db.getAllUniqueTickers())
+            {
+                writer << ticker << '\n';
+            }
+            break;
+
+        case 5:
+            writer << "Ticker " << args[0] << (db.doesTickerExist(args[0]) ? " exists.\n" : " does not exist.\n");
+            break;
+
+        case 6:
+            writer << "Number of dates with at least one stock closing above " << query.threshold << ": "
+                   << db.countDatesAboveThreshold(query.threshold) << "\n";
+            break;
+
+        case 7:
+            if (auto price = db.getClosingPrice(args[0], args[1]))
+            {
+                writer << "Closing price for " << args[0] << " on " << args[1] << ": " << *price << "\n";
+            }
+            else
+            {
+                writer << "Data not found.\n";
+            }
+            break;
+
+        case 8:
+            for (RowRef row : db.getDatesAndClosingPrices(args[0]))
+            {
+                writer << "Date: " << row.date() << ", Close: " << row.close() << '\n';
+            }
+            break;
+
+        case 9:
+            writer << "Total trading volume for " << args[0] << ": " << db.getTotalVolume(args[0]) << "\n";
+            break;
+
+        case 10:
+            if (db.doesDataExist(args[0], args[1]))
+            {
+                writer << "Data exists for " << args[0] << " on " << args[1] << ".\n";
+            }
+            else
+            {
+                writer << "Data does not exist.\n";
+            }
+            break;
+
+        case 11:
+            if (auto prices = db.getOpeningAndClosingPrices(args[0], args[1]))
+            {
+                writer << "Open: " << prices->first << ", Close: " << prices->second << "\n";
+            }
+            else
+            {
+                writer << "Data not found.\n";
+            }
+            break;
+
+        case 12:
+            if (auto dividend = db.getDividend(args[0], args[1]))
+            {
+                writer << "Dividend for " << args[0] << " on " << args[1] << ": " << *dividend << "\n";
+            }
+            else
+            {
+                writer << "Data not found.\n";
+            }
+            break;
+
+        case 13:
+            for (RowRef row : db.getTop10StocksByVolume(args[0]))
+            {
+                writer << "Ticker: " << row.ticker() << ", Volume: " << row.volume() << '\n';
+            }
+            break;
+
+        case 14:
+            for (RowRef row : db.getBottom5StocksByClosingPrice())
+            {
+                writer << "Ticker: " << row.ticker() << ", Close: " << row.close() << '\n';
+            }
+            break;
+
+        case 15:
+            for (RowRef row : db.getTop5StocksByDividends())
+            {
+                writer << "Ticker: " << row.ticker() << ", Dividends: " << row.dividends() << '\n';
+            }
+            break;
+
+        case 19:
+        {
+            RollingRange rolling = db.getRollingSeries(args[0], query.metric, query.count);
+            for (size_t i = 0; i < rolling.size(); ++i)
+            {
+                writer << "Date: " << rolling.row(i).date() << ", " << args[1] << "(" << query.count << "): " << rolling.value(i) << '\n';
+            }
+            break;
+        }
+
+        case 20:
+            // Batch queries already run in parallel, so each one uses a single thread
+            for (const CorrelatedPair &pair : db.getTopCorrelatedPairs(args[0], args[1], query.count, {}, 1))
+            {
+                writer << pair.first << " / " << pair.second << ": correlation " << pair.correlation
+                       << ", covariance " << pair.covariance << '\n';
+            }
+            break;
+
+        case 21:
+            writeFilterResult(db, query.filter, writer);
+            break;
+        }
+    }
+}
+
+void writeFilterResult(const StockDatabase &db, const FilterQuery &query, BufferedWriter &writer)
+{
+    const char *field = stockFieldName(query.field);
+    switch (query.output)
+    {
+    case FilterOutput::Count:
+        writer << "Matching rows: " << db.countRows(query.filter) << "\n";
+        break;
+
+    case FilterOutput::Dates:
+        writer << "Matching dates: " << db.countDates(query.filter) << "\n";
+        break;
+
+    case FilterOutput::Sum:
+    case FilterOutput::Average:
+    case FilterOutput::Max:
+    case FilterOutput::Min:
+    {
+        FilterAggregate aggregate = db.aggregateRows(query.filter, query.field);
+        if (aggregate.count == 0)
+        {
+            writer << "No matching rows.\n";
+            break;
+        }
+        const char *names[] = {"sum", "avg", "max", "min"};
+        double values[] = {aggregate.sum, aggregate.average(), aggregate.maximum, aggregate.minimum};
+        size_t which = static_cast<size_t>(query.output) - static_cast<size_t>(FilterOutput::Sum);
+        writer << names[which] << "(" << field << ") over " << aggregate.count << " rows: " << values[which] << "\n";
+        break;
+    }
+
+    case FilterOutput::Top:
+    case FilterOutput::Bottom:
+        for (RowRef row : db.topRows(query.filter, query.field, query.k, query.output == FilterOutput::Top))
+        {
+            writer << "Ticker: " << row.ticker() << ", Date: " << row.date() << ", " << field << ": "
+                   << row.value(query.field) << '\n';
+        }
+        break;
+    }
+}
+
+bool parseBatchQuery(std::string_view text, BatchQuery &query, std::string &error)
+{
+    query.args.clear();
+    size_t pos = 0;
+    std::string choice;
+    bool first = true;
+    while (pos < text.size())
+    {
+        while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\r'))
+        {
+            ++pos;
+        }
+        size_t start = pos;
+        while (pos < text.size() && text[pos] != ' ' && text[pos] != '\t' && text[pos] != '\r')
+        {
+            ++pos;
+        }
+        if (pos == start)
+        {
+            break;
+        }
+        if (first)
+        {
+            choice.assign(text.substr(start, pos - start));
+            first = false;
+        }
+        else
+        {
+            query.args.emplace_back(text.substr(start, pos - start));
+        }
+    }
+
+    auto result = std::from_chars(choice.data(), choice.data() + choice.size(), query.choice);
+    if (choice.empty() || result.ec != std::errc() || result.ptr != choice.data() + choice.size() ||
+        query.choice < 0 || query.choice > MAX_CHOICE)
+    {
+        error = "unknown query '" + choice + "'";
+        return false;
+    }
+    if (query.choice == 21 ? query.args.empty() : query.args.size() != static_cast<size_t>(ARG_COUNTS[query.choice]))
+    {
+        error = "query " + choice + " takes " + std::to_string(ARG_COUNTS[query.choice]) + " argument(s)";
+        return false;
+    }
+
+    if (query.choice == 6 && !parseNumber(query.args[0], query.threshold))
+    {
+        error = "invalid threshold '" + query.args[0] + "'";
+        return false;
+    }
+    if (query.choice == 18 && query.args[0] != "text" && query.args[0] != "json")
+    {
+        error = "unknown format '" + query.args[0] + "'";
+        return false;
+    }
+    if (query.choice == 19)
+    {
+        if (!parseRollingMetric(query.args[1], query.metric))
+        {
+            error = "unknown metric '" + query.args[1] + "'";
+            return false;
+        }
+        if (!parseCount(query.args[2], query.count))
+        {
+            error = "invalid window '" + query.args[2] + "'";
+            return false;
+        }
+    }
+    if (query.choice == 21 && !parseFilterQuery(query.args, query.filter, error))
+    {
+        return false;
+    }
+    if (query.choice == 20 && !parseCount(query.args[2], query.count))
+    {
+        error = "invalid count '" + query.args[2] + "'";
+        return false;
+    }
+    if (query.choice == 16)
+    {
+        StockData &record = query.record;
+        record.date = query.args[0];
+        record.ticker = query.args[1];
+        double *fields[] = {&record.open, &record.high, &record.low, &record.close, &record.volume, &record.dividends};
+        for (size_t i = 0; i < 6; ++i)
+        {
+            if (!parseNumber(query.args[i + 2], *fields[i]))
+            {
+                error = "invalid number '" + query.args[i + 2] + "'";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool isReadOnlyQuery(int choice)
+{
+    return choice != 16 && choice != 17 && choice != 18;
+}
+
+void runBatch(StockDatabase &db, std::istream &in, std::ostream &out, unsigned threadCount)
+{
+    WorkStealingPool pool(threadCount);
+    BufferedWriter writer(out);
+    std::vector<BatchQuery> segment;
+    std::vector<std::string> results;
+
+    // Answer the buffered read-only queries in parallel, then write their results in order
+    auto runSegment = [&]()
+    {
+        results.assign(segment.size(), std::string());
+        for (size_t first = 0; first < segment.size(); first += TASK_QUERIES)
+        {
+            size_t last = std::min(segment.size(), first + TASK_QUERIES);
+            pool.submit([&db, &segment, &results, first, last]()
+                        {
+                            BufferedWriter capture;
+                            for (size_t i = first; i < last; ++i)
+                            {
+                                writeQueryResult(db, segment[i], capture);
+                                results[i] = capture.take();
+                            } });
+        }
+        pool.wait();
+        for (const std::string &result : results)
+        {
+            writer << result;
+        }
+        segment.clear();
+    };
+
+    // Consecutive adds (16) go to the database as one bulk insert
+    std::vector<StockData> inserts;
+    auto runInserts = [&]()
+    {
+        if (inserts.empty())
+        {
+            return;
+        }
+        db.addStockRecords(inserts);
+        for (const StockData &record : inserts)
+        {
+            DayNumber day;
+            if (parseDate(record.date, day))
+            {
+                writer << "Added stock data for " << record.ticker << " on " << record.date << "\n";
+            }
+            else
+            {
+                writer << "Invalid date " << record.date << ", record not added.\n";
+            }
+        }
+        inserts.clear();
+    };
+
+    std::string text, error;
+    size_t line = 0;
+    while (std::getline(in, text))
+    {
+        ++line;
+        size_t start = text.find_first_not_of(" \t\r");
+        if (start == std::string::npos || text[start] == '#')
+        {
+            continue;
+        }
+
+        BatchQuery query;
+        query.line = line;
+        if (!parseBatchQuery(text, query, error))
+        {
+            std::cerr << "Skipping batch line " << line << ": " << error << std::endl;
+            continue;
+        }
+        if (query.choice == 0)
+        {
+            break;
+        }
+
+        if (isReadOnlyQuery(query.choice))
+        {
+            runInserts();
+            segment.push_back(std::move(query));
+            if (segment.size() == SEGMENT_QUERIES)
+            {
+                runSegment();
+            }
+            continue;
+        }
+
+        // A write or a report waits for every query before it
+        runSegment();
+        if (query.choice == 16)
+        {
+            inserts.push_back(std::move(query.record));
+            continue;
+        }
+        runInserts();
+        if (query.choice == 18)
+        {
+            std::ostringstream report;
+            if (query.args[0] == "json")
+            {
+                writeInstrumentationJson(report);
+            }
+            else
+            {
+                writeInstrumentationText(report);
+            }
+            writer << report.str();
+            continue;
+        }
+        if (db.eraseTicker(query.args[0]))
+        {
+            writer << "Deleted all records for ticker: " << query.args[0] << "\n";
+        }
+        else
+        {
+            writer << "Ticker " << query.args[0] << " not found.\n";
+        }
+    }
+    runInserts();
+    runSegment();
+    writer.flush();
+}
@@ -0,0 +1,57 @@
+#include "BufferedWriter.h"
+#include <charconv>
+
+BufferedWriter &BufferedWriter::operator<<(std::string_view text)
+{
+    buffer.append(text.data(), text.size());
+    flushIfFull();
+    return *this;
+}
+
+BufferedWriter &BufferedWriter::operator<<(char c)
+{
+    buffer.push_back(c);
+    flushIfFull();
+    return *this;
+}
+
+BufferedWriter &BufferedWriter::operator<<(double value)
+{
+    char chars[32];
+    auto result = std::to_chars(chars, chars + sizeof(chars), value, std::chars_format::general, 6);
+    buffer.append(chars, result.ptr);
+    flushIfFull();
+    return *this;
+}
+
+BufferedWriter &BufferedWriter::operator<<(long long value)
+{
+    char chars[24];
+    auto result = std::to_chars(chars, chars + sizeof(chars), value);
+    buffer.append(chars, result.ptr);
+    flushIfFull();
+    return *this;
+}
+
+BufferedWriter &BufferedWriter::operator<<(size_t value)
+{
+    char chars[24];
+    auto result = std::to_chars(chars, chars + sizeof(chars), value);
+    buffer.append(chars, result.ptr);
+    flushIfFull();
+    return *this;
+}
+
+void BufferedWriter::flush()
+{
+    if (out == nullptr)
+    {
+        return;
+    }
+    if (!buffer.empty())
+    {
+        out->write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        buffer.clear();
+    }
+    out->flush();
+}
@@ -0,0 +1,173 @@
+#include "ColdSegment.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <utility>
+
+namespace
+{
+    const char PADDING[8] = {};
+
+    template <typename T>
+    void writeSection(std::ostream &out, const T *values, size_t count)
+    {
+        size_t bytes = count * sizeof(T);
+        out.write(reinterpret_cast<const char *>(values), static_cast<std::streamsize>(bytes));
+        out.write(PADDING, static_cast<std::streamsize>((8 - bytes % 8) % 8));
+    }
+
+    // The first `rowCount` in-memory values of a column
+    template <typename T>
+    void writeColumn(std::ostream &out, const Column<T> &column, size_t rowCount)
+    {
+        writeSection(out, column.hotValues().data(), rowCount);
+    }
+
+    void writeColumn(std::ostream &out, const Column<double> &column, size_t rowCount, bool compress, ColumnEncoding encoding)
+    {
+        if (!compress)
+        {
+            writeSection(out, column.hotValues().data(), rowCount);
+            return;
+        }
+        std::vector<std::uint8_t> encoded = encodeColumn(column.hotValues().data(), rowCount, encoding);
+        std::uint64_t bytes = encoded.size();
+        writeSection(out, &bytes, 1);
+        writeSection(out, encoded.data(), encoded.size());
+    }
+
+    // Sections of the mapped segment in order; nullptr once one runs past the end
+    class SegmentReader
+    {
+    private:
+        const char *cursor;
+        const char *end;
+
+    public:
+        SegmentReader(const char *begin, const char *end) : cursor(begin), end(end) {}
+
+        const char *section(std::uint64_t bytes)
+        {
+            std::uint64_t padded = (bytes + 7) & ~std::uint64_t(7);
+            if (cursor == nullptr || padded > static_cast<std::uint64_t>(end - cursor))
+            {
+                cursor = nullptr;
+                return nullptr;
+            }
+            const char *start = cursor;
+            cursor += padded;
+            return start;
+        }
+    };
+}
+
+std::vector<ColdMonthRun> monthRuns(const DayNumber *days, size_t count, RowIndex firstRow)
+{
+    std::vector<ColdMonthRun> runs;
+    for (size_t i = 0; i < count; ++i)
+    {
+        int month = monthOf(days[i]);
+        if (runs.empty() || runs.back().month != month)
+        {
+            runs.push_back({month, static_cast<RowIndex>(firstRow + i), static_cast<RowIndex>(firstRow + i)});
+        }
+        ++runs.back().end;
+    }
+    return runs;
+}
+
+bool moveToColdSegment(StockColumns &columns, size_t rowCount, const std::string &filename, bool compress,
+                       const std::vector<double> &tables)
+{
+    // Written beside an old file of that name and renamed over it; mappings of
+    // the old file (e.g. in a copy of the database) stay valid
+    std::string tempName = filename + ".tmp";
+    {
+        std::ofstream out(tempName, std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            return false;
+        }
+        ColdSegmentHeader header{};
+        std::memcpy(header.magic, COLD_SEGMENT_MAGIC, sizeof(header.magic));
+        header.rowCount = rowCount;
+        header.compressed = compress ? 1 : 0;
+        header.tableCount = tables.size();
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        writeColumn(out, columns.ticker, rowCount);
+        writeColumn(out, columns.date, rowCount);
+        writeColumn(out, columns.open, rowCount, compress, ColumnEncoding::FixedPoint);
+        writeColumn(out, columns.high, rowCount, compress, ColumnEncoding::FixedPoint);
+        writeColumn(out, columns.low, rowCount, compress, ColumnEncoding::FixedPoint);
+        writeColumn(out, columns.close, rowCount, compress, ColumnEncoding::FixedPoint);
+        writeColumn(out, columns.volume, rowCount, compress, ColumnEncoding::DeltaVarint);
+        writeColumn(out, columns.dividends, rowCount, compress, ColumnEncoding::FixedPoint);
+        writeSection(out, tables.data(), tables.size());
+        if (!out)
+        {
+            return false;
+        }
+    }
+    if (std::rename(tempName.c_str(), filename.c_str()) != 0)
+    {
+        return false;
+    }
+
+    auto segment = std::make_shared<ColdSegment>(filename);
+    if (!segment->file.isOpen() || segment->file.size() < sizeof(ColdSegmentHeader))
+    {
+        return false;
+    }
+    const char *data = segment->file.data();
+    SegmentReader reader(data + sizeof(ColdSegmentHeader), data + segment->file.size());
+    const char *tickerSection = reader.section(rowCount * sizeof(std::uint32_t));
+    const char *dateSection = reader.section(rowCount * sizeof(DayNumber));
+    const char *valueSections[6];
+    for (size_t i = 0; i < 6; ++i)
+    {
+        if (!compress)
+        {
+            valueSections[i] = reader.section(rowCount * sizeof(double));
+            continue;
+        }
+        const char *size = reader.section(sizeof(std::uint64_t));
+        std::uint64_t bytes = 0;
+        if (size != nullptr)
+        {
+            std::memcpy(&bytes, size, sizeof(bytes));
+        }
+        valueSections[i] = reader.section(bytes);
+        if (valueSections[i] != nullptr)
+        {
+            segment->packed[i] = CompressedColumn(reinterpret_cast<const std::uint8_t *>(valueSections[i]), bytes);
+        }
+        if (segment->packed[i].size() != rowCount)
+        {
+            return false;
+        }
+    }
+    const char *tableSection = reader.section(tables.size() * sizeof(double));
+    if (reader.section(0) == nullptr || tickerSection == nullptr || dateSection == nullptr || tableSection == nullptr)
+    {
+        return false;
+    }
+    segment->tables = reinterpret_cast<const double *>(tableSection);
+
+    segment->months = monthRuns(columns.date.hotValues().data(), rowCount, static_cast<RowIndex>(columns.coldRows()));
+    columns.ticker.freeze(reinterpret_cast<const std::uint32_t *>(tickerSection), rowCount);
+    columns.date.freeze(reinterpret_cast<const DayNumber *>(dateSection), rowCount);
+    Column<double> *targets[6] = {&columns.open, &columns.high, &columns.low, &columns.close, &columns.volume, &columns.dividends};
+    for (size_t i = 0; i < 6; ++i)
+    {
+        if (compress)
+        {
+            targets[i]->freeze(&segment->packed[i]);
+        }
+        else
+        {
+            targets[i]->freeze(reinterpret_cast<const double *>(valueSections[i]), rowCount);
+        }
+    }
+    columns.coldSegments.push_back(std::move(segment));
+    return true;
+}
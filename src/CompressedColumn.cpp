@@ -0,0 +1,410 @@
+#include "CompressedColumn.h"
+#include "ScanKernels.h"
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+    enum BlockKind : std::uint8_t
+    {
+        RAW_BLOCK = 0,
+        XOR_BLOCK = 1,
+        DELTA_BLOCK = 2
+    };
+
+    std::atomic<std::uint64_t> nextColumnId{1};
+
+    // The block operator[] decoded last on this thread
+    struct DecodedBlock
+    {
+        std::uint64_t column = 0;
+        size_t block = 0;
+        size_t length = 0;
+        double values[CompressedColumn::BLOCK];
+    };
+    thread_local DecodedBlock lastBlock;
+
+    constexpr int MAX_DECIMALS = 9;
+    const double POW10[MAX_DECIMALS + 1] = {1, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+
+    std::uint64_t bitsOf(double value)
+    {
+        std::uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    double valueOf(std::uint64_t bits)
+    {
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    std::uint64_t load64(const std::uint8_t *p)
+    {
+        std::uint64_t word;
+        std::memcpy(&word, p, sizeof(word));
+        return word;
+    }
+
+    // Most significant bit first
+    class BitWriter
+    {
+    private:
+        std::vector<std::uint8_t> &out;
+        std::uint64_t pending = 0;
+        int pendingBits = 0;
+
+    public:
+        explicit BitWriter(std::vector<std::uint8_t> &out) : out(out) {}
+
+        void write(std::uint64_t value, int bits)
+        {
+            if (bits > 32)
+            {
+                write(value >> 32, bits - 32);
+                bits = 32;
+            }
+            value &= (std::uint64_t(1) << bits) - 1;
+            pending = (pending << bits) | value;
+            pendingBits += bits;
+            while (pendingBits >= 8)
+            {
+                pendingBits -= 8;
+                out.push_back(static_cast<std::uint8_t>(pending >> pendingBits));
+            }
+        }
+
+        void flush()
+        {
+            if (pendingBits > 0)
+            {
+                out.push_back(static_cast<std::uint8_t>(pending << (8 - pendingBits)));
+                pendingBits = 0;
+            }
+        }
+    };
+
+    // Reads up to 8 bytes past its position; the encoded column ends with 8 zero bytes for that
+    class BitReader
+    {
+    private:
+        const std::uint8_t *data;
+        size_t position = 0; // in bits
+
+    public:
+        explicit BitReader(const std::uint8_t *data) : data(data) {}
+
+        std::uint64_t read(int bits)
+        {
+            if (bits > 32)
+            {
+                std::uint64_t high = read(bits - 32);
+                return (high << 32) | read(32);
+            }
+            std::uint64_t word = __builtin_bswap64(load64(data + (position >> 3)));
+            std::uint64_t value = (word << (position & 7)) >> (64 - bits);
+            position += bits;
+            return value;
+        }
+    };
+
+    void writeVarint(std::vector<std::uint8_t> &out, std::uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<std::uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<std::uint8_t>(value));
+    }
+
+    std::uint64_t readVarint(const std::uint8_t *&p)
+    {
+        std::uint64_t value = 0;
+        for (int shift = 0;; shift += 7)
+        {
+            std::uint8_t byte = *p++;
+            value |= std::uint64_t(byte & 0x7f) << shift;
+            if (byte < 0x80)
+            {
+                return value;
+            }
+        }
+    }
+
+    std::uint64_t zigzag(std::int64_t value) { return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63); }
+    std::int64_t unzigzag(std::uint64_t value) { return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1); }
+
+    // value * 10^decimals as an integer, when dividing it back gives exactly `value`
+    bool toFixedPoint(double value, int decimals, std::int64_t &scaled)
+    {
+        double product = value * POW10[decimals];
+        if (!(std::fabs(product) < 9007199254740992.0))
+        {
+            return false;
+        }
+        scaled = std::llround(product);
+        return bitsOf(static_cast<double>(scaled) / POW10[decimals]) == bitsOf(value);
+    }
+
+    bool encodeDelta(const double *values, size_t n, int decimals, std::vector<std::uint8_t> &out)
+    {
+        std::vector<std::uint8_t> block{static_cast<std::uint8_t>(DELTA_BLOCK | decimals << 4)};
+        std::int64_t previous = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            std::int64_t scaled;
+            if (!toFixedPoint(values[i], decimals, scaled))
+            {
+                return false;
+            }
+            writeVarint(block, zigzag(scaled - previous));
+            previous = scaled;
+        }
+        out.insert(out.end(), block.begin(), block.end());
+        return true;
+    }
+
+    void encodeXor(const double *values, size_t n, std::vector<std::uint8_t> &out)
+    {
+        out.push_back(XOR_BLOCK);
+        BitWriter writer(out);
+        std::uint64_t previous = bitsOf(values[0]);
+        writer.write(previous, 64);
+        int windowLeading = -1;
+        int windowTrailing = 0;
+        for (size_t i = 1; i < n; ++i)
+        {
+            std::uint64_t bits = bitsOf(values[i]);
+            std::uint64_t delta = bits ^ previous;
+            previous = bits;
+            if (delta == 0)
+            {
+                writer.write(0, 1);
+                continue;
+            }
+            int leading = std::min(__builtin_clzll(delta), 31);
+            int trailing = __builtin_ctzll(delta);
+            if (windowLeading >= 0 && leading >= windowLeading && trailing >= windowTrailing)
+            {
+                // The changed bits fit in the previous window
+                writer.write(0b10, 2);
+                writer.write(delta >> windowTrailing, 64 - windowLeading - windowTrailing);
+                continue;
+            }
+            int meaningful = 64 - leading - trailing;
+            writer.write(0b11, 2);
+            writer.write(static_cast<std::uint64_t>(leading), 5);
+            writer.write(static_cast<std::uint64_t>(meaningful - 1), 6);
+            writer.write(delta >> trailing, meaningful);
+            windowLeading = leading;
+            windowTrailing = trailing;
+        }
+        writer.flush();
+    }
+
+    void encodeBlock(const double *values, size_t n, ColumnEncoding encoding, std::vector<std::uint8_t> &out)
+    {
+        size_t start = out.size();
+        bool encoded = false;
+        if (encoding == ColumnEncoding::DeltaVarint)
+        {
+            encoded = encodeDelta(values, n, 0, out);
+        }
+        else if (encoding == ColumnEncoding::FixedPoint)
+        {
+            for (int decimals = 0; decimals <= MAX_DECIMALS && !encoded; ++decimals)
+            {
+                encoded = encodeDelta(values, n, decimals, out);
+            }
+        }
+        if (!encoded && encoding != ColumnEncoding::Raw)
+        {
+            encodeXor(values, n, out);
+            encoded = true;
+        }
+        if (!encoded || out.size() - start > 1 + n * sizeof(double))
+        {
+            out.resize(start);
+            out.push_back(RAW_BLOCK);
+            const std::uint8_t *bytes = reinterpret_cast<const std::uint8_t *>(values);
+            out.insert(out.end(), bytes, bytes + n * sizeof(double));
+        }
+    }
+}
+
+const char *columnEncodingName(ColumnEncoding encoding)
+{
+    switch (encoding)
+    {
+    case ColumnEncoding::Raw:
+        return "raw";
+    case ColumnEncoding::Xor:
+        return "xor";
+    case ColumnEncoding::DeltaVarint:
+        return "delta-varint";
+    case ColumnEncoding::FixedPoint:
+        return "fixed-point";
+    }
+    return "?";
+}
+
+std::vector<std::uint8_t> encodeColumn(const double *values, size_t count, ColumnEncoding encoding)
+{
+    size_t blockCount = (count + CompressedColumn::BLOCK - 1) / CompressedColumn::BLOCK;
+    std::vector<std::uint64_t> offsets{0};
+    std::vector<std::uint8_t> payload;
+    for (size_t block = 0; block < blockCount; ++block)
+    {
+        size_t first = block * CompressedColumn::BLOCK;
+        encodeBlock(values + first, std::min(CompressedColumn::BLOCK, count - first), encoding, payload);
+        offsets.push_back(payload.size());
+    }
+
+    std::uint64_t header = count;
+    std::vector<std::uint8_t> encoded(sizeof(header) + offsets.size() * sizeof(std::uint64_t));
+    std::memcpy(encoded.data(), &header, sizeof(header));
+    std::memcpy(encoded.data() + sizeof(header), offsets.data(), offsets.size() * sizeof(std::uint64_t));
+    encoded.insert(encoded.end(), payload.begin(), payload.end());
+    encoded.resize((encoded.size() + 8 + 7) & ~size_t(7), 0);
+    return encoded;
+}
+
+CompressedColumn::CompressedColumn(const std::uint8_t *data, size_t size)
+{
+    if (size < 2 * sizeof(std::uint64_t))
+    {
+        return;
+    }
+    std::uint64_t values = load64(data);
+    std::uint64_t blockCount = (values + BLOCK - 1) / BLOCK;
+    if (blockCount > size / sizeof(std::uint64_t) - 2)
+    {
+        return;
+    }
+    size_t headerBytes = (blockCount + 2) * sizeof(std::uint64_t);
+    std::uint64_t previous = 0;
+    for (std::uint64_t block = 1; block <= blockCount; ++block)
+    {
+        std::uint64_t offset = load64(data + (block + 1) * sizeof(std::uint64_t));
+        if (offset < previous)
+        {
+            return;
+        }
+        previous = offset;
+    }
+    if (previous + 8 > size - headerBytes)
+    {
+        return;
+    }
+    encoded = data;
+    payload = data + headerBytes;
+    count = values;
+    byteCount = size;
+    id = nextColumnId.fetch_add(1, std::memory_order_relaxed);
+}
+
+size_t CompressedColumn::blockOffset(size_t block) const
+{
+    return load64(encoded + (block + 1) * sizeof(std::uint64_t));
+}
+
+void CompressedColumn::decodeBlock(size_t block, size_t limit, double *out) const
+{
+    const std::uint8_t *p = payload + blockOffset(block);
+    std::uint8_t tag = *p++;
+    switch (tag & 15)
+    {
+    case RAW_BLOCK:
+        std::memcpy(out, p, limit * sizeof(double));
+        break;
+    case XOR_BLOCK:
+    {
+        BitReader reader(p);
+        std::uint64_t bits = reader.read(64);
+        out[0] = valueOf(bits);
+        int leading = 0;
+        int meaningful = 64;
+        for (size_t i = 1; i < limit; ++i)
+        {
+            if (reader.read(1) != 0)
+            {
+                if (reader.read(1) != 0)
+                {
+                    leading = static_cast<int>(reader.read(5));
+                    meaningful = static_cast<int>(reader.read(6)) + 1;
+                }
+                bits ^= reader.read(meaningful) << (64 - leading - meaningful);
+            }
+            out[i] = valueOf(bits);
+        }
+        break;
+    }
+    default:
+    {
+        double scale = POW10[tag >> 4];
+        std::int64_t scaled = 0;
+        for (size_t i = 0; i < limit; ++i)
+        {
+            scaled += unzigzag(readVarint(p));
+            out[i] = static_cast<double>(scaled) / scale;
+        }
+        break;
+    }
+    }
+}
+
+double CompressedColumn::operator[](size_t i) const
+{
+    size_t block = i / BLOCK;
+    if (lastBlock.column != id || lastBlock.block != block || lastBlock.length <= i % BLOCK)
+    {
+        lastBlock.column = id;
+        lastBlock.block = block;
+        lastBlock.length = std::min(BLOCK, count - block * BLOCK);
+        decodeBlock(block, lastBlock.length, lastBlock.values);
+    }
+    return lastBlock.values[i % BLOCK];
+}
+
+void CompressedColumn::decode(size_t first, size_t n, double *out) const
+{
+    forEachBlock(first, first + n, [out, first](const double *values, size_t k, size_t position)
+                 { std::memcpy(out + (position - first), values, k * sizeof(double)); });
+}
+
+double CompressedColumn::sum(size_t first, size_t last) const
+{
+    double total = 0;
+    forEachBlock(first, last, [&total](const double *values, size_t n, size_t)
+                 { total += scanSum(values, n); });
+    return total;
+}
+
+double CompressedColumn::max(size_t first, size_t last) const
+{
+    double best = -std::numeric_limits<double>::infinity();
+    forEachBlock(first, last, [&best](const double *values, size_t n, size_t)
+                 { best = std::max(best, scanMax(values, n)); });
+    return best;
+}
+
+double CompressedColumn::min(size_t first, size_t last) const
+{
+    double best = std::numeric_limits<double>::infinity();
+    forEachBlock(first, last, [&best](const double *values, size_t n, size_t)
+                 { best = std::min(best, scanMin(values, n)); });
+    return best;
+}
+
+size_t CompressedColumn::countBetween(size_t first, size_t last, double lower, double upper) const
+{
+    size_t total = 0;
+    forEachBlock(first, last, [&](const double *values, size_t n, size_t)
+                 { total += scanCountBetween(values, n, lower, upper); });
+    return total;
+}
@@ -0,0 +1,212 @@
+#include "ConcurrencyStress.h"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    constexpr int STRESS_TICKERS = 8;     // tickers the writer cycles through
+    constexpr int DAYS_PER_TICKER = 20;   // rows added per ticker before it is deleted
+
+    std::string stressTicker(int i)
+    {
+        return "STRESS" + std::to_string(i);
+    }
+
+    bool closeEnough(double a, double b)
+    {
+        return std::fabs(a - b) <= 1e-9 * std::max(1.0, std::max(std::fabs(a), std::fabs(b)));
+    }
+
+    bool sameRows(const RowRange &a, const RowRange &b)
+    {
+        if (a.size() != b.size())
+        {
+            return false;
+        }
+        auto other = b.begin();
+        for (RowRef row : a)
+        {
+            if (row.row() != (*other).row())
+            {
+                return false;
+            }
+            ++other;
+        }
+        return true;
+    }
+
+    // The filter engine's index shortcuts against its plain scan of the same filter
+    bool checkShortcuts(const StockDatabase &db, const RowFilter &filter, StockField field, bool highest)
+    {
+        RowFilter scan = filter;
+        scan.useIndexShortcuts = false;
+        bool ok = db.countDates(filter) == db.countDates(scan);
+        for (bool distinct : {false, true})
+        {
+            ok &= sameRows(db.topRows(filter, field, 10, highest, distinct), db.topRows(scan, field, 10, highest, distinct));
+        }
+        return ok;
+    }
+
+    // All fifteen read queries for one ticker and date, checked against each other
+    bool checkView(const StockDatabase &db, const std::string &ticker, const std::string &date,
+                   const std::string &endDate, double threshold)
+    {
+        bool ok = true;
+        RowRange series = db.getDatesAndClosingPrices(ticker); // 8
+        ok &= db.doesTickerExist(ticker) == !series.empty();   // 5
+
+        double volume = 0, close = 0;
+        bool dateFound = false;
+        for (RowRef row : series)
+        {
+            volume += row.volume();
+            close += row.close();
+            if (row.date().view() == date)
+            {
+                dateFound = true;
+                ok &= db.getClosingPrice(ticker, date) == row.close();                  // 7
+                ok &= db.doesDataExist(ticker, date);                                   // 10
+                auto prices = db.getOpeningAndClosingPrices(ticker, date);              // 11
+                ok &= prices && prices->first == row.open() && prices->second == row.close();
+                ok &= db.getDividend(ticker, date) == row.dividends();                  // 12
+            }
+        }
+        ok &= dateFound || !db.doesDataExist(ticker, date);
+        ok &= closeEnough(db.getTotalVolume(ticker), volume);                               // 9
+        ok &= series.empty() || closeEnough(db.getAverageClosePrice(ticker), close / series.size()); // 2
+        db.getHighestPriceInPeriod(ticker, date, endDate);                                  // 3
+
+        RowRange onDate = db.getDataByDate(date);                                           // 1
+        bool tickerOnDate = false;
+        for (RowRef row : onDate)
+        {
+            tickerOnDate |= row.ticker() == ticker;
+        }
+        ok &= tickerOnDate == dateFound;
+        RowRange top = db.getTop10StocksByVolume(date);                                     // 13
+        ok &= top.size() == std::min<size_t>(10, onDate.size());
+
+        bool listed = false;
+        for (std::string_view name : db.getAllUniqueTickers())                              // 4
+        {
+            listed |= name == ticker;
+        }
+        ok &= listed == !series.empty();
+
+        db.countDatesAboveThreshold(threshold);                                              // 6
+        ok &= db.getBottom5StocksByClosingPrice().size() <= 5;                               // 14
+        ok &= db.getTop5StocksByDividends().size() <= 5;                                     // 15
+
+        DayNumber day;
+        if (parseDate(date, day))
+        {
+            ok &= checkShortcuts(db, RowFilter().on(day), StockField::Volume, true);
+            ok &= checkShortcuts(db, RowFilter().on(day).above(StockField::Close, threshold), StockField::Volume, true);
+        }
+        ok &= checkShortcuts(db, RowFilter().above(StockField::Close, threshold), StockField::Close, true);
+        ok &= checkShortcuts(db, RowFilter(), StockField::Close, false);
+        ok &= checkShortcuts(db, RowFilter(), StockField::Dividends, true);
+        return ok;
+    }
+}
+
+size_t runConcurrencyStress(ConcurrentStockDatabase &db, unsigned readerCount, double seconds)
+{
+    if (readerCount == 0)
+    {
+        readerCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Sample tickers and dates from the loaded data, plus the writer's tickers
+    std::vector<std::string> tickers, dates;
+    db.read([&](const StockDatabase &view)
+            {
+                for (std::string_view name : view.getAllUniqueTickers())
+                {
+                    tickers.emplace_back(name);
+                }
+                if (!tickers.empty())
+                {
+                    for (RowRef row : view.getDatesAndClosingPrices(tickers.front()))
+                    {
+                        dates.emplace_back(row.date().view());
+                    }
+                } });
+    for (int i = 0; i < STRESS_TICKERS; ++i)
+    {
+        tickers.push_back(stressTicker(i));
+    }
+    for (int day = 1; day <= DAYS_PER_TICKER; ++day)
+    {
+        dates.push_back("2100-01-" + std::string(day < 10 ? "0" : "") + std::to_string(day));
+    }
+
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> reads{0}, failures{0};
+    size_t writes = 0;
+
+    std::vector<std::thread> readers;
+    for (unsigned i = 0; i < readerCount; ++i)
+    {
+        readers.emplace_back([&, i]()
+                             {
+                                 std::mt19937 random(i + 1);
+                                 size_t localReads = 0;
+                                 while (!stop.load(std::memory_order_relaxed))
+                                 {
+                                     const std::string &ticker = tickers[random() % tickers.size()];
+                                     const std::string &date = dates[random() % dates.size()];
+                                     const std::string &endDate = dates[random() % dates.size()];
+                                     double threshold = static_cast<double>(random() % 500);
+                                     if (!db.read([&](const StockDatabase &view)
+                                                  { return checkView(view, ticker, date, endDate, threshold); }))
+                                     {
+                                         failures.fetch_add(1);
+                                     }
+                                     ++localReads;
+                                 }
+                                 reads.fetch_add(localReads); });
+    }
+
+    // Writer: fill a ticker day by day, then delete the one filled before it
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+    for (int round = 0; std::chrono::steady_clock::now() < deadline; ++round)
+    {
+        std::string ticker = stressTicker(round % STRESS_TICKERS);
+        for (int day = 1; day <= DAYS_PER_TICKER; ++day)
+        {
+            StockData record;
+            record.date = dates[dates.size() - DAYS_PER_TICKER + day - 1];
+            record.ticker = ticker;
+            record.open = round + day;
+            record.high = record.open + 2;
+            record.low = record.open - 1;
+            record.close = record.open + 1;
+            record.volume = 1000.0 * day;
+            record.dividends = day % 5 == 0 ? 0.5 : 0;
+            db.insertRecord(record);
+            ++writes;
+        }
+        if (round > 0)
+        {
+            db.eraseTicker(stressTicker((round - 1) % STRESS_TICKERS));
+            ++writes;
+        }
+    }
+    stop.store(true);
+    for (auto &reader : readers)
+    {
+        reader.join();
+    }
+
+    std::cout << "Stress: " << readerCount << " readers, " << reads.load() << " checked reads, " << writes
+              << " writes in " << seconds << " s, " << failures.load() << " inconsistent reads\n";
+    return failures.load();
+}
@@ -0,0 +1,86 @@
+#include "ConcurrentStockDatabase.h"
+#include <thread>
+
+void ConcurrentStockDatabase::waitForReaders(int version) const
+{
+    while (indicators[version].readers.load() != 0)
+    {
+        std::this_thread::yield();
+    }
+}
+
+// After this returns no reader can still be using the unpublished copy
+void ConcurrentStockDatabase::toggleVersionAndWait()
+{
+    int previous = versionIndex.load();
+    int next = 1 - previous;
+    waitForReaders(next);
+    versionIndex.store(next);
+    waitForReaders(previous);
+}
+
+// Loads replace the whole state, so the second copy is a plain copy of the first
+void ConcurrentStockDatabase::loadData(const std::string &filename)
+{
+    std::lock_guard<std::mutex> lock(writerMutex);
+    int current = published.load();
+    instances[1 - current].loadData(filename);
+    published.store(1 - current);
+    toggleVersionAndWait();
+    instances[current] = instances[1 - current];
+}
+
+bool ConcurrentStockDatabase::loadSnapshot(const std::string &filename)
+{
+    std::lock_guard<std::mutex> lock(writerMutex);
+    int current = published.load();
+    StockDatabase loaded;
+    if (!loaded.loadSnapshot(filename))
+    {
+        return false;
+    }
+    instances[1 - current] = loaded;
+    published.store(1 - current);
+    toggleVersionAndWait();
+    instances[current] = std::move(loaded);
+    return true;
+}
+
+bool ConcurrentStockDatabase::saveSnapshot(const std::string &filename) const
+{
+    return read([&filename](const StockDatabase &db)
+                { return db.saveSnapshot(filename); });
+}
+
+bool ConcurrentStockDatabase::insertRecord(const StockData &record)
+{
+    return writeBoth(Operation::AddStockRecord, [&record](StockDatabase &db)
+                     { return db.insertRecord(record); });
+}
+
+size_t ConcurrentStockDatabase::addStockRecords(const std::vector<StockData> &records)
+{
+    return writeBoth(Operation::AddStockRecords, [&records](StockDatabase &db)
+                     { return db.addStockRecords(records); });
+}
+
+bool ConcurrentStockDatabase::eraseTicker(std::string_view ticker)
+{
+    return writeBoth(Operation::DeleteTicker, [ticker](StockDatabase &db)
+                     { return db.eraseTicker(ticker); });
+}
+
+// Readers keep answering from the other copy while each copy compacts
+void ConcurrentStockDatabase::compact()
+{
+    writeBoth(Operation::Compact, [](StockDatabase &db)
+              { db.compact(); return true; });
+}
+
+// Only writers read the ratio, so both copies can be set under the writer lock
+void ConcurrentStockDatabase::setCompactionRatio(double ratio)
+{
+    std::lock_guard<std::mutex> lock(writerMutex);
+    instances[0].setCompactionRatio(ratio);
+    instances[1].setCompactionRatio(ratio);
+}
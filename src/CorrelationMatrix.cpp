@@ -0,0 +1,147 @@
+#include "CorrelationMatrix.h"
+#include "ScanKernels.h"
+#include "WorkStealingPool.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // A task multiplies a tile of TILE_ROWS rows by another, TILE_DAYS days at a
+    // time, so both tiles' slices (2 x 64 x 512 doubles) stay in L2
+    constexpr size_t TILE_ROWS = 64;
+    constexpr size_t TILE_DAYS = 512;
+
+    // Dot products of rows [i0, i1) with rows [j0, j1) into dots[(a - i0) * TILE_ROWS + (b - j0)].
+    // On a diagonal tile (i0 == j0) only b >= a is computed. The day slices are
+    // summed in a fixed order, so results do not depend on the thread count.
+    void tileDots(const ReturnMatrix &returns, size_t i0, size_t i1, size_t j0, size_t j1, double *dots)
+    {
+        std::fill(dots, dots + TILE_ROWS * TILE_ROWS, 0.0);
+        for (size_t t0 = 0; t0 < returns.days; t0 += TILE_DAYS)
+        {
+            size_t length = std::min(TILE_DAYS, returns.days - t0);
+            for (size_t a = i0; a < i1; ++a)
+            {
+                const double *x = returns.row(a) + t0;
+                for (size_t b = (i0 == j0 ? a : j0); b < j1; ++b)
+                {
+                    dots[(a - i0) * TILE_ROWS + (b - j0)] += scanDot(x, returns.row(b) + t0, length);
+                }
+            }
+        }
+    }
+
+    // Run `work(i0, i1, j0, j1, dots)` for every tile pair with j0 >= i0
+    template <typename Work>
+    void forEachTilePair(const ReturnMatrix &returns, unsigned threadCount, Work work)
+    {
+        WorkStealingPool pool(threadCount);
+        for (size_t i0 = 0; i0 < returns.tickers; i0 += TILE_ROWS)
+        {
+            for (size_t j0 = i0; j0 < returns.tickers; j0 += TILE_ROWS)
+            {
+                pool.submit([&returns, &work, i0, j0]()
+                            {
+                                std::vector<double> dots(TILE_ROWS * TILE_ROWS);
+                                size_t i1 = std::min(returns.tickers, i0 + TILE_ROWS);
+                                size_t j1 = std::min(returns.tickers, j0 + TILE_ROWS);
+                                tileDots(returns, i0, i1, j0, j1, dots.data());
+                                work(i0, i1, j0, j1, dots.data()); });
+            }
+        }
+        pool.wait();
+    }
+
+    bool higherCorrelation(const PairScore &a, const PairScore &b)
+    {
+        if (a.correlation != b.correlation)
+        {
+            return a.correlation > b.correlation;
+        }
+        return a.first != b.first ? a.first < b.first : a.second < b.second;
+    }
+}
+
+std::vector<double> covarianceMatrix(const ReturnMatrix &returns, unsigned threadCount)
+{
+    size_t n = returns.tickers;
+    std::vector<double> covariances(n * n);
+    if (returns.days < 2)
+    {
+        return covariances;
+    }
+    double scale = 1.0 / static_cast<double>(returns.days - 1);
+    // Tiles write disjoint cells (and their mirror images), so no locking
+    forEachTilePair(returns, threadCount, [&covariances, n, scale](size_t i0, size_t i1, size_t j0, size_t j1, const double *dots)
+                    {
+                        for (size_t a = i0; a < i1; ++a)
+                        {
+                            for (size_t b = (i0 == j0 ? a : j0); b < j1; ++b)
+                            {
+                                double covariance = dots[(a - i0) * TILE_ROWS + (b - j0)] * scale;
+                                covariances[a * n + b] = covariance;
+                                covariances[b * n + a] = covariance;
+                            }
+                        } });
+    return covariances;
+}
+
+std::vector<PairScore> topCorrelatedPairs(const ReturnMatrix &returns, size_t n, unsigned threadCount)
+{
+    std::vector<PairScore> best;
+    if (returns.days < 2 || n == 0)
+    {
+        return best;
+    }
+    std::vector<double> squares(returns.tickers);
+    for (size_t i = 0; i < returns.tickers; ++i)
+    {
+        squares[i] = scanDot(returns.row(i), returns.row(i), returns.days);
+    }
+    double scale = 1.0 / static_cast<double>(returns.days - 1);
+
+    // Each tile keeps its own n best in a heap (worst on top); the heaps are merged at the end
+    size_t tileCount = (returns.tickers + TILE_ROWS - 1) / TILE_ROWS;
+    std::vector<std::vector<PairScore>> tileBest(tileCount * tileCount);
+    forEachTilePair(returns, threadCount, [&](size_t i0, size_t i1, size_t j0, size_t j1, const double *dots)
+                    {
+                        std::vector<PairScore> &heap = tileBest[(i0 / TILE_ROWS) * tileCount + j0 / TILE_ROWS];
+                        for (size_t a = i0; a < i1; ++a)
+                        {
+                            for (size_t b = (i0 == j0 ? a + 1 : j0); b < j1; ++b)
+                            {
+                                if (squares[a] == 0 || squares[b] == 0)
+                                {
+                                    continue;
+                                }
+                                double dot = dots[(a - i0) * TILE_ROWS + (b - j0)];
+                                PairScore pair{a, b, dot / std::sqrt(squares[a] * squares[b]), dot * scale};
+                                if (heap.size() < n)
+                                {
+                                    heap.push_back(pair);
+                                    std::push_heap(heap.begin(), heap.end(), higherCorrelation);
+                                }
+                                else if (higherCorrelation(pair, heap.front()))
+                                {
+                                    std::pop_heap(heap.begin(), heap.end(), higherCorrelation);
+                                    heap.back() = pair;
+                                    std::push_heap(heap.begin(), heap.end(), higherCorrelation);
+                                }
+                            }
+                        } });
+
+    for (const std::vector<PairScore> &heap : tileBest)
+    {
+        best.insert(best.end(), heap.begin(), heap.end());
+    }
+    n = std::min(n, best.size());
+    std::partial_sort(best.begin(), best.begin() + n, best.end(), higherCorrelation);
+    best.resize(n);
+    return best;
+}
+
+double CorrelationMatrix::correlation(size_t i, size_t j) const
+{
+    double denominator = std::sqrt(covariance(i, i) * covariance(j, j));
+    return denominator == 0 ? 0 : covariance(i, j) / denominator;
+}
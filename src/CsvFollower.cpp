@@ -0,0 +1,128 @@
+#include "CsvFollower.h"
+#include "MappedFile.h"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+CsvFollower::CsvFollower(std::string filename) : filename(std::move(filename))
+{
+#ifdef __linux__
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    addWatch();
+#endif
+}
+
+CsvFollower::~CsvFollower()
+{
+#ifdef __linux__
+    if (inotifyFd >= 0)
+    {
+        ::close(inotifyFd);
+    }
+#endif
+}
+
+// (Re)attach the watch; a replaced file needs a new one
+void CsvFollower::addWatch()
+{
+#ifdef __linux__
+    if (inotifyFd >= 0 && watch < 0)
+    {
+        watch = inotify_add_watch(inotifyFd, filename.c_str(),
+                                  IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF);
+    }
+#endif
+}
+
+bool CsvFollower::poll(std::vector<CsvChunk> &chunks, unsigned threadCount)
+{
+    chunks.clear();
+    restarted = false;
+    MappedFile file(filename, AccessPattern::Sequential);
+    if (!file.isOpen())
+    {
+        return false;
+    }
+    if (replaced || file.size() < offset)
+    {
+        std::cerr << filename << " was replaced, following it from the start" << std::endl;
+        offset = 0;
+        replaced = false;
+    }
+    restarted = offset == 0;
+    if (file.size() == offset)
+    {
+        return true;
+    }
+
+    // Stop after the last complete line
+    const char *data = file.data();
+    const char *end = data + file.size();
+    while (end > data + offset && end[-1] != '\n')
+    {
+        --end;
+    }
+    const char *begin = data + offset;
+    if (end == begin)
+    {
+        return true;
+    }
+    offset = static_cast<size_t>(end - data);
+
+    if (begin == data)
+    {
+        begin = static_cast<const char *>(std::memchr(begin, '\n', static_cast<size_t>(end - begin))) + 1;
+    }
+    if (begin < end)
+    {
+        chunks = parseCsvText(begin, end, threadCount);
+    }
+    return true;
+}
+
+bool CsvFollower::waitForAppend(int timeoutMs)
+{
+#ifdef __linux__
+    bool rewatched = watch < 0;
+    addWatch();
+    if (inotifyFd >= 0 && watch >= 0)
+    {
+        if (rewatched)
+        {
+            // Writes since the old watch went away were not seen
+            return true;
+        }
+        pollfd descriptor{inotifyFd, POLLIN, 0};
+        if (::poll(&descriptor, 1, timeoutMs) <= 0)
+        {
+            return false;
+        }
+        // Drain the queued events; a moved or deleted file loses its watch
+        alignas(inotify_event) char buffer[4096];
+        ssize_t length;
+        while ((length = ::read(inotifyFd, buffer, sizeof(buffer))) > 0)
+        {
+            for (char *p = buffer; p < buffer + length;)
+            {
+                auto *event = reinterpret_cast<inotify_event *>(p);
+                if (event->mask & (IN_MOVE_SELF | IN_DELETE_SELF | IN_IGNORED))
+                {
+                    inotify_rm_watch(inotifyFd, watch);
+                    watch = -1;
+                    replaced = true;
+                }
+                p += sizeof(inotify_event) + event->len;
+            }
+        }
+        return true;
+    }
+#endif
+    std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+    return true;
+}
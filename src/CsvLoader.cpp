@@ -0,0 +1,165 @@
+#include "CsvLoader.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <functional>
+#include <string_view>
+#include <thread>
+
+namespace
+{
+    const size_t MIN_CHUNK_BYTES = 1 << 20;
+    const char *const FIELD_NAMES[] = {"Open", "High", "Low", "Close", "Volume", "Dividends"};
+
+    // Same acceptance rules as std::stod: optional leading whitespace/sign, trailing text ignored
+    bool parseDouble(std::string_view text, double &value)
+    {
+        size_t i = 0;
+        while (i < text.size() && (text[i] == ' ' || text[i] == '\t'))
+        {
+            ++i;
+        }
+        if (i < text.size() && text[i] == '+')
+        {
+            ++i;
+        }
+        auto result = std::from_chars(text.data() + i, text.data() + text.size(), value);
+        return result.ec == std::errc();
+    }
+
+    std::string_view nextField(std::string_view &rest)
+    {
+        size_t comma = rest.find(',');
+        std::string_view field = rest.substr(0, comma);
+        rest = comma == std::string_view::npos ? std::string_view() : rest.substr(comma + 1);
+        return field;
+    }
+
+    void skipLine(CsvChunk &chunk, const char *reason, std::string_view line)
+    {
+        chunk.errors.append(reason).append(line).push_back('\n');
+    }
+
+    void parseChunk(const char *begin, const char *end, CsvChunk &chunk)
+    {
+        chunk.columns.reserve(static_cast<size_t>(end - begin) / 64);
+        StockData record;
+        double *values[] = {&record.open, &record.high, &record.low, &record.close, &record.volume, &record.dividends};
+
+        while (begin < end)
+        {
+            const char *newline = static_cast<const char *>(std::memchr(begin, '\n', static_cast<size_t>(end - begin)));
+            const char *lineEnd = newline == nullptr ? end : newline;
+            std::string_view line(begin, static_cast<size_t>(lineEnd - begin));
+            begin = lineEnd + 1;
+
+            std::string_view rest = line;
+            std::string_view date = nextField(rest);
+            std::string_view ticker = nextField(rest);
+            if (date.empty() || ticker.empty())
+            {
+                skipLine(chunk, "Skipping line with missing Date or Ticker: ", line);
+                continue;
+            }
+
+            bool isValid = true;
+            for (size_t i = 0; i < 6; ++i)
+            {
+                std::string_view field = nextField(rest);
+                if (field.empty())
+                {
+                    chunk.errors.append("Skipping line with empty ").append(FIELD_NAMES[i]).append(" field: ");
+                    skipLine(chunk, "", line);
+                    isValid = false;
+                    break;
+                }
+                if (!parseDouble(field, *values[i]))
+                {
+                    chunk.errors.append("Skipping line with invalid ").append(FIELD_NAMES[i]).append(" value: ");
+                    skipLine(chunk, "", line);
+                    isValid = false;
+                    break;
+                }
+            }
+            if (!isValid)
+            {
+                continue;
+            }
+
+            DayNumber day;
+            if (!parseDate(date, day))
+            {
+                skipLine(chunk, "Skipping line with invalid Date value: ", line);
+                continue;
+            }
+
+            std::uint32_t tickerId = chunk.columns.tickers.intern(ticker);
+            RowIndex row = chunk.columns.append(tickerId, day, record);
+            if (tickerId >= chunk.tickerRows.size())
+            {
+                chunk.tickerRows.resize(tickerId + 1);
+            }
+            chunk.tickerRows[tickerId].push_back(row);
+        }
+    }
+}
+
+std::vector<CsvChunk> parseCsvText(const char *begin, const char *end, unsigned threadCount)
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    size_t bytes = static_cast<size_t>(end - begin);
+    size_t chunkCount = std::max<size_t>(1, std::min<size_t>(threadCount, bytes / MIN_CHUNK_BYTES));
+
+    // Newline-aligned chunk boundaries
+    std::vector<const char *> bounds{begin};
+    for (size_t i = 1; i < chunkCount; ++i)
+    {
+        const char *split = std::max(bounds.back(), begin + bytes * i / chunkCount);
+        const char *newline = static_cast<const char *>(std::memchr(split, '\n', static_cast<size_t>(end - split)));
+        bounds.push_back(newline == nullptr ? end : newline + 1);
+    }
+    bounds.push_back(end);
+
+    std::vector<CsvChunk> chunks(chunkCount);
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < chunkCount; ++i)
+    {
+        workers.emplace_back(parseChunk, bounds[i], bounds[i + 1], std::ref(chunks[i]));
+    }
+    parseChunk(bounds[0], bounds[1], chunks[0]);
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+    return chunks;
+}
+
+CsvParseResult parseCsvFile(const std::string &filename, unsigned threadCount)
+{
+    CsvParseResult result;
+    MappedFile file(filename, AccessPattern::Sequential);
+    if (!file.isOpen())
+    {
+        return result;
+    }
+    result.opened = true;
+    result.bytes = file.size();
+
+    const char *begin = file.data();
+    const char *end = begin + file.size();
+    if (begin == nullptr)
+    {
+        return result;
+    }
+
+    // Skip the header line
+    const char *header = static_cast<const char *>(std::memchr(begin, '\n', file.size()));
+    begin = header == nullptr ? end : header + 1;
+
+    result.chunks = parseCsvText(begin, end, threadCount);
+    return result;
+}
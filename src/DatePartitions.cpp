@@ -0,0 +1,161 @@
+#include "DatePartitions.h"
+#include "ColdSegment.h"
+#include <algorithm>
+
+DatePartition *DatePartitions::find(DayNumber day)
+{
+    int month = monthOf(day);
+    auto it = std::lower_bound(partitions.begin(), partitions.end(), month,
+                               [](const DatePartition &partition, int m)
+                               { return partition.month < m; });
+    return it != partitions.end() && it->month == month ? &*it : nullptr;
+}
+
+void DatePartitions::addDay(DayNumber day)
+{
+    int month = monthOf(day);
+    auto it = std::lower_bound(partitions.begin(), partitions.end(), month,
+                               [](const DatePartition &partition, int m)
+                               { return partition.month < m; });
+    if (it == partitions.end() || it->month != month)
+    {
+        it = partitions.insert(it, DatePartition());
+        it->month = month;
+    }
+    it->days.insert(std::lower_bound(it->days.begin(), it->days.end(), day), day);
+}
+
+void DatePartitions::removeDay(DayNumber day)
+{
+    DatePartition *partition = find(day);
+    if (partition == nullptr)
+    {
+        return;
+    }
+    auto it = std::lower_bound(partition->days.begin(), partition->days.end(), day);
+    if (it != partition->days.end() && *it == day)
+    {
+        partition->days.erase(it);
+    }
+    if (partition->days.empty())
+    {
+        partitions.erase(partitions.begin() + (partition - partitions.data()));
+    }
+}
+
+void DatePartitions::addRow(const StockColumns &columns, RowIndex row)
+{
+    DatePartition *partition = find(columns.date[row]);
+    if (partition == nullptr)
+    {
+        return;
+    }
+    ++partition->rows;
+    for (size_t f = 0; f < DatePartition::FIELD_COUNT; ++f)
+    {
+        double value = fieldColumn(columns, static_cast<StockField>(f))[row];
+        partition->minimum[f] = std::min(partition->minimum[f], value);
+        partition->maximum[f] = std::max(partition->maximum[f], value);
+    }
+}
+
+void DatePartitions::addRows(const StockColumns &columns)
+{
+    // Rows of one month usually follow each other, so the last partition is tried first
+    auto partitionOf = [this](DatePartition *last, DayNumber day)
+    {
+        return last != nullptr && day >= last->firstDay() && day <= last->lastDay() ? last : find(day);
+    };
+    DatePartition *partition = nullptr;
+    for (RowIndex row = 0; row < columns.size(); ++row)
+    {
+        if (!columns.isDeleted(row) && (partition = partitionOf(partition, columns.date[row])) != nullptr)
+        {
+            ++partition->rows;
+        }
+    }
+    for (size_t f = 0; f < DatePartition::FIELD_COUNT; ++f)
+    {
+        auto widen = [&](const double *values, size_t n, size_t first)
+        {
+            for (size_t i = 0; i < n; ++i)
+            {
+                RowIndex row = static_cast<RowIndex>(first + i);
+                if (columns.isDeleted(row) || (partition = partitionOf(partition, columns.date[row])) == nullptr)
+                {
+                    continue;
+                }
+                partition->minimum[f] = std::min(partition->minimum[f], values[i]);
+                partition->maximum[f] = std::max(partition->maximum[f], values[i]);
+            }
+        };
+        fieldColumn(columns, static_cast<StockField>(f)).forEachBlock(0, columns.size(), widen);
+    }
+}
+
+void DatePartitions::removeRow(const StockColumns &columns, RowIndex row)
+{
+    DatePartition *partition = find(columns.date[row]);
+    if (partition != nullptr && partition->rows > 0)
+    {
+        --partition->rows;
+    }
+}
+
+void DatePartitions::setColdRows(const StockColumns &columns)
+{
+    for (DatePartition &partition : partitions)
+    {
+        partition.coldSpans.clear();
+    }
+    for (const auto &segment : columns.coldSegments)
+    {
+        for (const ColdMonthRun &run : segment->months)
+        {
+            DatePartition *partition = find(firstDayOfMonth(run.month));
+            if (partition != nullptr)
+            {
+                partition->coldSpans.push_back({run.begin, run.end});
+            }
+        }
+    }
+}
+
+std::pair<size_t, size_t> DatePartitions::overlapping(DayNumber startDay, DayNumber endDay) const
+{
+    if (startDay > endDay)
+    {
+        return {0, 0};
+    }
+    auto first = std::lower_bound(partitions.begin(), partitions.end(), startDay,
+                                  [](const DatePartition &partition, DayNumber day)
+                                  { return partition.lastDay() < day; });
+    auto last = std::upper_bound(first, partitions.end(), endDay,
+                                 [](DayNumber day, const DatePartition &partition)
+                                 { return day < partition.firstDay(); });
+    return {static_cast<size_t>(first - partitions.begin()), static_cast<size_t>(last - partitions.begin())};
+}
+
+bool DatePartitions::overlaps(DayNumber startDay, DayNumber endDay) const
+{
+    auto range = overlapping(startDay, endDay);
+    return range.first != range.second;
+}
+
+bool DatePartitions::mayContain(DayNumber day) const
+{
+    return overlaps(day, day);
+}
+
+std::vector<DayNumber> DatePartitions::daysBetween(DayNumber startDay, DayNumber endDay) const
+{
+    std::vector<DayNumber> days;
+    auto range = overlapping(startDay, endDay);
+    for (size_t i = range.first; i < range.second; ++i)
+    {
+        const std::vector<DayNumber> &monthDays = partitions[i].days;
+        days.insert(days.end(), std::lower_bound(monthDays.begin(), monthDays.end(), startDay),
+                    std::upper_bound(monthDays.begin(), monthDays.end(), endDay));
+    }
+    return days;
+}
@@ -0,0 +1,130 @@
+#include "DateUtils.h"
+
+namespace
+{
+    bool parseDigits(std::string_view text, int &value)
+    {
+        value = 0;
+        for (char c : text)
+        {
+            if (c < '0' || c > '9')
+            {
+                return false;
+            }
+            value = value * 10 + (c - '0');
+        }
+        return true;
+    }
+
+    bool isLeapYear(int year)
+    {
+        return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    }
+
+    int daysInMonth(int year, int month)
+    {
+        static const int days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+        return (month == 2 && isLeapYear(year)) ? 29 : days[month - 1];
+    }
+}
+
+// Civil date <-> day count conversion (proleptic Gregorian calendar)
+bool parseDate(std::string_view text, DayNumber &day)
+{
+    if (text.size() < 10 || text[4] != '-' || text[7] != '-')
+    {
+        return false;
+    }
+    if (text.size() > 10 && text[10] != ' ' && text[10] != 'T')
+    {
+        return false;
+    }
+
+    int year, month, dayOfMonth;
+    if (!parseDigits(text.substr(0, 4), year) || !parseDigits(text.substr(5, 2), month) ||
+        !parseDigits(text.substr(8, 2), dayOfMonth))
+    {
+        return false;
+    }
+    if (month < 1 || month > 12 || dayOfMonth < 1 || dayOfMonth > daysInMonth(year, month))
+    {
+        return false;
+    }
+
+    int y = year - (month <= 2 ? 1 : 0);
+    int era = y / 400;
+    int yearOfEra = y - era * 400;
+    int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + dayOfMonth - 1;
+    int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    day = era * 146097 + dayOfEra - 719468;
+    return true;
+}
+
+namespace
+{
+    struct CivilDate
+    {
+        int year;
+        int month;
+        int dayOfMonth;
+    };
+
+    CivilDate civilDate(DayNumber day)
+    {
+        int z = day + 719468;
+        int era = (z >= 0 ? z : z - 146096) / 146097;
+        int dayOfEra = z - era * 146097;
+        int yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+        int dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+        int mp = (5 * dayOfYear + 2) / 153;
+        int dayOfMonth = dayOfYear - (153 * mp + 2) / 5 + 1;
+        int month = mp < 10 ? mp + 3 : mp - 9;
+        int year = yearOfEra + era * 400 + (month <= 2 ? 1 : 0);
+        return {year, month, dayOfMonth};
+    }
+}
+
+DateText formatDateText(DayNumber day)
+{
+    CivilDate civil = civilDate(day);
+    int year = civil.year;
+    int month = civil.month;
+    int dayOfMonth = civil.dayOfMonth;
+
+    DateText text;
+    char *chars = text.chars;
+    for (int i = 3; i >= 0; --i, year /= 10)
+    {
+        chars[i] = static_cast<char>('0' + year % 10);
+    }
+    chars[4] = '-';
+    chars[5] = static_cast<char>('0' + month / 10);
+    chars[6] = static_cast<char>('0' + month % 10);
+    chars[7] = '-';
+    chars[8] = static_cast<char>('0' + dayOfMonth / 10);
+    chars[9] = static_cast<char>('0' + dayOfMonth % 10);
+    return text;
+}
+
+std::string formatDate(DayNumber day)
+{
+    return std::string(formatDateText(day).view());
+}
+
+int monthOf(DayNumber day)
+{
+    CivilDate civil = civilDate(day);
+    return civil.year * 12 + civil.month - 1;
+}
+
+DayNumber firstDayOfMonth(int month)
+{
+    int year = month >= 0 ? month / 12 : (month - 11) / 12;
+    int monthOfYear = month - year * 12 + 1;
+    int y = year - (monthOfYear <= 2 ? 1 : 0);
+    int era = (y >= 0 ? y : y - 399) / 400;
+    int yearOfEra = y - era * 400;
+    int dayOfYear = (153 * (monthOfYear + (monthOfYear > 2 ? -3 : 9)) + 2) / 5;
+    int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
@@ -0,0 +1,218 @@
+#include "Instrumentation.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace
+{
+    constexpr size_t OPERATION_COUNT = static_cast<size_t>(Operation::Count);
+    constexpr size_t COUNTER_COUNT = static_cast<size_t>(Counter::Count);
+
+    const char *const OPERATION_NAMES[OPERATION_COUNT] = {
+        "loadData", "loadSnapshot", "saveSnapshot", "addStockRecord", "addStockRecords", "ingestChunks",
+        "deleteTicker", "compact", "freezeColdPartitions", "getDataByDate", "getAverageClosePrice", "getHighestPriceInPeriod",
+        "getLowestPriceInPeriod", "getAllUniqueTickers", "doesTickerExist", "countDatesAboveThreshold",
+        "countDatesBelowThreshold", "countDatesBetweenThresholds", "getClosingPrice", "getDatesAndClosingPrices", "getRollingSeries",
+        "getTotalVolume", "getTotalDividends", "doesDataExist", "getOpeningAndClosingPrices", "getDividend",
+        "getTop10StocksByVolume", "getTopStocksOnDate", "getTopTickersByVolume", "getCorrelationMatrix",
+        "getTopCorrelatedPairs", "getBottom5StocksByClosingPrice",
+        "getTop5StocksByDividends", "topK", "bottomK", "filterRows", "countFilteredDates", "aggregateRows", "topRows"};
+
+    const char *const COUNTER_NAMES[COUNTER_COUNT] = {"rows_scanned", "index_hits", "index_misses", "scans", "allocations",
+                                                 "cache_hits", "cache_misses"};
+
+    struct ThreadStats
+    {
+        LatencyHistogram histograms[OPERATION_COUNT];
+        std::atomic<std::uint64_t> counters[COUNTER_COUNT] = {};
+    };
+
+    // Every thread's stats, kept after the thread exits so nothing is lost
+    struct Registry
+    {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<ThreadStats>> threads;
+    };
+
+    Registry &registry()
+    {
+        static Registry instance;
+        return instance;
+    }
+
+    std::atomic<bool> enabled{true};
+    thread_local bool latencyPaused = false;
+    thread_local bool countersPaused = false;
+
+    ThreadStats &localStats()
+    {
+        thread_local ThreadStats *stats = nullptr;
+        if (stats == nullptr)
+        {
+            auto owned = std::make_unique<ThreadStats>();
+            stats = owned.get();
+            Registry &r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            r.threads.push_back(std::move(owned));
+        }
+        return *stats;
+    }
+
+    void writePercentiles(std::ostream &out, const LatencyHistogram::Snapshot &s, bool json)
+    {
+        if (json)
+        {
+            out << "\"count\": " << s.total << ", \"mean_ns\": " << static_cast<std::uint64_t>(s.mean())
+                << ", \"min_ns\": " << s.min << ", \"p50_ns\": " << s.percentile(0.5) << ", \"p99_ns\": " << s.percentile(0.99)
+                << ", \"p999_ns\": " << s.percentile(0.999) << ", \"max_ns\": " << s.max;
+        }
+        else
+        {
+            out << " count " << s.total << ", mean " << static_cast<std::uint64_t>(s.mean()) << " ns, min " << s.min
+                << ", p50 " << s.percentile(0.5) << ", p99 " << s.percentile(0.99) << ", p99.9 " << s.percentile(0.999)
+                << ", max " << s.max << " ns";
+        }
+    }
+}
+
+const char *operationName(Operation operation)
+{
+    return OPERATION_NAMES[static_cast<size_t>(operation)];
+}
+
+const char *counterName(Counter counter)
+{
+    return COUNTER_NAMES[static_cast<size_t>(counter)];
+}
+
+bool instrumentationEnabled()
+{
+    return enabled.load(std::memory_order_relaxed);
+}
+
+void setInstrumentationEnabled(bool value)
+{
+    enabled.store(value, std::memory_order_relaxed);
+}
+
+bool latencyRecordingEnabled()
+{
+    return !latencyPaused && instrumentationEnabled();
+}
+
+InstrumentationPause::InstrumentationPause(bool counters)
+    : latencyWasPaused(latencyPaused), countersWerePaused(countersPaused)
+{
+    latencyPaused = true;
+    countersPaused = countersPaused || counters;
+}
+
+InstrumentationPause::~InstrumentationPause()
+{
+    latencyPaused = latencyWasPaused;
+    countersPaused = countersWerePaused;
+}
+
+void recordLatency(Operation operation, std::uint64_t nanoseconds)
+{
+    localStats().histograms[static_cast<size_t>(operation)].record(nanoseconds);
+}
+
+void addCount(Counter counter, std::uint64_t amount)
+{
+    if (countersPaused || !instrumentationEnabled())
+    {
+        return;
+    }
+    std::atomic<std::uint64_t> &value = localStats().counters[static_cast<size_t>(counter)];
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+LatencyHistogram::Snapshot latencySnapshot(Operation operation)
+{
+    LatencyHistogram::Snapshot snapshot;
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (const auto &stats : r.threads)
+    {
+        stats->histograms[static_cast<size_t>(operation)].addTo(snapshot);
+    }
+    return snapshot;
+}
+
+std::uint64_t counterValue(Counter counter)
+{
+    std::uint64_t total = 0;
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (const auto &stats : r.threads)
+    {
+        total += stats->counters[static_cast<size_t>(counter)].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+// Not synchronized with recording threads: values recorded during a reset may survive it
+void resetInstrumentation()
+{
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (const auto &stats : r.threads)
+    {
+        for (auto &histogram : stats->histograms)
+        {
+            histogram.reset();
+        }
+        for (auto &counter : stats->counters)
+        {
+            counter.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+void writeInstrumentationText(std::ostream &out)
+{
+    out << "Latency per operation:\n";
+    for (size_t i = 0; i < OPERATION_COUNT; ++i)
+    {
+        LatencyHistogram::Snapshot snapshot = latencySnapshot(static_cast<Operation>(i));
+        if (snapshot.total == 0)
+        {
+            continue;
+        }
+        out << "  " << OPERATION_NAMES[i] << ":";
+        writePercentiles(out, snapshot, false);
+        out << "\n";
+    }
+    out << "Counters:\n";
+    for (size_t i = 0; i < COUNTER_COUNT; ++i)
+    {
+        out << "  " << COUNTER_NAMES[i] << ": " << counterValue(static_cast<Counter>(i)) << "\n";
+    }
+}
+
+void writeInstrumentationJson(std::ostream &out)
+{
+    out << "{\"operations\": {";
+    bool first = true;
+    for (size_t i = 0; i < OPERATION_COUNT; ++i)
+    {
+        LatencyHistogram::Snapshot snapshot = latencySnapshot(static_cast<Operation>(i));
+        if (snapshot.total == 0)
+        {
+            continue;
+        }
+        out << (first ? "" : ", ") << "\"" << OPERATION_NAMES[i] << "\": {";
+        writePercentiles(out, snapshot, true);
+        out << "}";
+        first = false;
+    }
+    out << "}, \"counters\": {";
+    for (size_t i = 0; i < COUNTER_COUNT; ++i)
+    {
+        out << (i == 0 ? "" : ", ") << "\"" << COUNTER_NAMES[i] << "\": " << counterValue(static_cast<Counter>(i));
+    }
+    out << "}}\n";
+}
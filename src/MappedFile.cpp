@@ -0,0 +1,51 @@
+#include "MappedFile.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string &filename, AccessPattern pattern)
+{
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) == 0)
+    {
+        length = static_cast<size_t>(st.st_size);
+        ok = true;
+        if (length > 0)
+        {
+            void *p = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED)
+            {
+                ok = false;
+                length = 0;
+            }
+            else
+            {
+                mapped = static_cast<const char *>(p);
+                ::madvise(p, length, pattern == AccessPattern::Sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+            }
+        }
+    }
+    ::close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (mapped != nullptr)
+    {
+        ::munmap(const_cast<char *>(mapped), length);
+    }
+}
+
+void MappedFile::releasePages() const
+{
+    if (mapped != nullptr)
+    {
+        ::madvise(const_cast<char *>(mapped), length, MADV_DONTNEED);
+    }
+}
@@ -0,0 +1,162 @@
+#include "MarketDataGenerator.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+namespace
+{
+    constexpr double TRADING_DAYS_PER_YEAR = 252;
+
+    // splitmix64: small, fast and identical everywhere (unlike std:: distributions)
+    std::uint64_t nextRandom(std::uint64_t &state)
+    {
+        std::uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // Uniform in (0, 1)
+    double uniform(std::uint64_t &state)
+    {
+        return (static_cast<double>(nextRandom(state) >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+    }
+
+    // Standard normal (Box-Muller)
+    double normal(std::uint64_t &state)
+    {
+        double u1 = uniform(state);
+        double u2 = uniform(state);
+        return std::sqrt(-2.0 * std::log(u1)) * std::cos(6.283185307179586 * u2);
+    }
+
+    double roundTo(double value, double unit)
+    {
+        return std::round(value / unit) * unit;
+    }
+}
+
+std::string MarketDataGenerator::tickerName(size_t index)
+{
+    size_t length = 3;
+    size_t span = 26 * 26 * 26;
+    while (index >= span)
+    {
+        index -= span;
+        span *= 26;
+        ++length;
+    }
+    std::string name(length, 'A');
+    for (size_t i = length; i-- > 0;)
+    {
+        name[i] = static_cast<char>('A' + index % 26);
+        index /= 26;
+    }
+    return name;
+}
+
+MarketDataGenerator::MarketDataGenerator(const MarketDataOptions &options) : options(options)
+{
+    DayNumber first, last;
+    parseDate(std::to_string(options.startYear) + "-01-01", first);
+    parseDate(std::to_string(options.startYear + options.years) + "-01-01", last);
+    for (DayNumber day = first; day < last; ++day)
+    {
+        int weekday = ((day % 7) + 10) % 7; // 0 = Monday; 1970-01-01 was a Thursday
+        if (weekday < 5)
+        {
+            tradingDays.push_back(day);
+        }
+    }
+
+    states.reserve(options.tickers);
+    for (size_t i = 0; i < options.tickers; ++i)
+    {
+        TickerState state;
+        state.name = tickerName(i);
+        state.random = options.seed ^ (0xD1B54A32D192ED03ull * (i + 1));
+        state.close = roundTo(std::exp(std::log(5.0) + uniform(state.random) * std::log(100.0)), 0.01);
+        state.drift = 0.06 + 0.10 * normal(state.random);
+        state.volatility = 0.15 + 0.45 * uniform(state.random);
+        state.baseVolume = std::exp(13.0 + normal(state.random));
+        state.dividendYield = uniform(state.random) < options.dividendPayerShare ? 0.01 + 0.03 * uniform(state.random) : 0;
+        state.dividendPhase = static_cast<int>(nextRandom(state.random) % 63);
+        states.push_back(std::move(state));
+    }
+}
+
+bool MarketDataGenerator::next(StockData &bar)
+{
+    if (states.empty() || dayIndex >= tradingDays.size())
+    {
+        return false;
+    }
+
+    TickerState &state = states[tickerIndex];
+    double dt = 1.0 / TRADING_DAYS_PER_YEAR;
+    double dailyVolatility = state.volatility * std::sqrt(dt);
+    double move = (state.drift - 0.5 * state.volatility * state.volatility) * dt + dailyVolatility * normal(state.random);
+
+    double open = state.close * std::exp(0.25 * dailyVolatility * normal(state.random));
+    double close = state.close * std::exp(move);
+    double high = std::max(open, close) * std::exp(0.5 * dailyVolatility * std::fabs(normal(state.random)));
+    double low = std::min(open, close) * std::exp(-0.5 * dailyVolatility * std::fabs(normal(state.random)));
+    double volume = state.baseVolume * std::exp(0.4 * normal(state.random)) * (1.0 + 0.5 * std::fabs(move) / dailyVolatility);
+
+    double dividends = 0;
+    if (state.dividendYield > 0 && options.dividendFrequency > 0)
+    {
+        int period = std::max(1, static_cast<int>(TRADING_DAYS_PER_YEAR / options.dividendFrequency));
+        if (static_cast<int>(dayIndex) % period == state.dividendPhase % period)
+        {
+            dividends = roundTo(close * state.dividendYield / options.dividendFrequency, 0.01);
+        }
+    }
+
+    bar.date.assign(formatDateText(tradingDays[dayIndex]).view());
+    bar.ticker = state.name;
+    bar.open = roundTo(open, 1e-6);
+    bar.high = roundTo(high, 1e-6);
+    bar.low = roundTo(low, 1e-6);
+    bar.close = roundTo(close, 1e-6);
+    bar.volume = std::round(volume);
+    bar.dividends = dividends;
+    state.close = close;
+
+    if (++tickerIndex == states.size())
+    {
+        tickerIndex = 0;
+        ++dayIndex;
+    }
+    return true;
+}
+
+bool writeMarketDataCsv(const std::string &filename, const MarketDataOptions &options)
+{
+    std::ofstream out(filename, std::ios::binary);
+    if (!out)
+    {
+        return false;
+    }
+    out << "Date,Ticker,Open,High,Low,Close,Volume,Dividends\n";
+
+    MarketDataGenerator generator(options);
+    StockData bar;
+    char line[160];
+    std::string buffer;
+    while (generator.next(bar))
+    {
+        int length = std::snprintf(line, sizeof(line), "%s,%s,%.6f,%.6f,%.6f,%.6f,%.0f,%.2f\n", bar.date.c_str(),
+                                   bar.ticker.c_str(), bar.open, bar.high, bar.low, bar.close, bar.volume, bar.dividends);
+        buffer.append(line, static_cast<size_t>(length));
+        if (buffer.size() >= (1 << 20))
+        {
+            out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            buffer.clear();
+        }
+    }
+    out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,152 @@
+#include "ResultCache.h"
+#include <algorithm>
+
+namespace
+{
+    // Bookkeeping outside the result vectors: list and hash nodes plus the by-ticker slot
+    constexpr size_t ENTRY_OVERHEAD = 96;
+
+    size_t resultBytes(const CachedResult &result)
+    {
+        return result.rows.capacity() * sizeof(RowIndex) +
+               result.totals.capacity() * sizeof(std::pair<std::uint32_t, double>);
+    }
+
+    bool touchesRange(const std::vector<DayNumber> &days, DayNumber startDay, DayNumber endDay)
+    {
+        auto it = std::lower_bound(days.begin(), days.end(), startDay);
+        return it != days.end() && *it <= endDay;
+    }
+}
+
+ResultCache &ResultCache::operator=(const ResultCache &other)
+{
+    if (this != &other)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        lru.clear();
+        entries.clear();
+        byTicker.clear();
+        bytes = 0;
+        budget = other.budget;
+    }
+    return *this;
+}
+
+bool ResultCache::find(const CacheKey &key, CachedResult &result)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    if (it == entries.end())
+    {
+        ++counts.misses;
+        return false;
+    }
+    ++counts.hits;
+    lru.splice(lru.begin(), lru, it->second);
+    result = it->second->result;
+    return true;
+}
+
+void ResultCache::insert(const CacheKey &key, CachedResult result)
+{
+    size_t size = sizeof(Entry) + ENTRY_OVERHEAD + resultBytes(result);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (size > budget || entries.count(key) != 0)
+    {
+        return;
+    }
+    lru.push_front(Entry{key, std::move(result), size, 0});
+    entries.emplace(key, lru.begin());
+    std::vector<Entry *> &slots = byTicker[key.tickerId];
+    lru.front().tickerSlot = slots.size();
+    slots.push_back(&lru.front());
+    bytes += size;
+    evictToBudget();
+}
+
+void ResultCache::erase(std::list<Entry>::iterator it)
+{
+    // Swap-remove from the ticker's list so erasing stays O(1)
+    std::vector<Entry *> &slots = byTicker[it->key.tickerId];
+    slots[it->tickerSlot] = slots.back();
+    slots[it->tickerSlot]->tickerSlot = it->tickerSlot;
+    slots.pop_back();
+    if (slots.empty())
+    {
+        byTicker.erase(it->key.tickerId);
+    }
+    bytes -= it->bytes;
+    entries.erase(it->key);
+    lru.erase(it);
+}
+
+void ResultCache::evictToBudget()
+{
+    while (bytes > budget && !lru.empty())
+    {
+        erase(std::prev(lru.end()));
+        ++counts.evictions;
+    }
+}
+
+size_t ResultCache::invalidateList(std::vector<Entry *> &list, const std::vector<DayNumber> &days)
+{
+    std::vector<CacheKey> stale;
+    for (const Entry *entry : list)
+    {
+        if (touchesRange(days, entry->key.startDay, entry->key.endDay))
+        {
+            stale.push_back(entry->key);
+        }
+    }
+    for (const CacheKey &key : stale)
+    {
+        erase(entries.find(key)->second);
+    }
+    return stale.size();
+}
+
+void ResultCache::invalidate(std::uint32_t tickerId, const std::vector<DayNumber> &days)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (days.empty() || entries.empty())
+    {
+        return;
+    }
+    for (std::uint32_t id : {tickerId, CacheKey::ANY_TICKER})
+    {
+        auto it = byTicker.find(id);
+        if (it != byTicker.end())
+        {
+            counts.invalidations += invalidateList(it->second, days);
+        }
+    }
+}
+
+void ResultCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    counts.invalidations += entries.size();
+    lru.clear();
+    entries.clear();
+    byTicker.clear();
+    bytes = 0;
+}
+
+void ResultCache::setBudget(size_t newBudget)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    budget = newBudget;
+    evictToBudget();
+}
+
+ResultCache::Stats ResultCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats result = counts;
+    result.entries = entries.size();
+    result.bytes = bytes;
+    result.budget = budget;
+    return result;
+}
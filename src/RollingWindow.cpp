@@ -0,0 +1,235 @@
+#include "RollingWindow.h"
+#include <algorithm>
+#include <cmath>
+
+bool parseRollingMetric(std::string_view text, RollingMetric &metric)
+{
+    static const RollingMetric METRICS[] = {RollingMetric::Sma, RollingMetric::Ema, RollingMetric::Vwap, RollingMetric::Return,
+                                            RollingMetric::Volatility};
+    for (RollingMetric candidate : METRICS)
+    {
+        if (text == rollingMetricName(candidate))
+        {
+            metric = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *rollingMetricName(RollingMetric metric)
+{
+    switch (metric)
+    {
+    case RollingMetric::Sma:
+        return "sma";
+    case RollingMetric::Ema:
+        return "ema";
+    case RollingMetric::Vwap:
+        return "vwap";
+    case RollingMetric::Return:
+        return "return";
+    case RollingMetric::Volatility:
+        return "volatility";
+    }
+    return "";
+}
+
+// The quantity the window slides over, at a series position
+double RollingSeries::windowValue(const TickerSeries &series, const StockColumns &columns, size_t position) const
+{
+    const std::vector<RowIndex> &rows = series.rowIndices();
+    RowIndex row = rows[position];
+    switch (metric)
+    {
+    case RollingMetric::Vwap:
+        return (columns.high[row] + columns.low[row] + columns.close[row]) / 3 * columns.volume[row];
+    case RollingMetric::Volatility:
+        return columns.close[row] / columns.close[rows[position - 1]] - 1;
+    default:
+        return columns.close[row];
+    }
+}
+
+bool RollingSeries::isPrefixOf(const TickerSeries &series) const
+{
+    return consumed == 0 || (consumed <= series.size() && series.rowIndices()[consumed - 1] == lastRow);
+}
+
+void RollingSeries::extend(const TickerSeries &series, const StockColumns &columns)
+{
+    const std::vector<RowIndex> &rows = series.rowIndices();
+    size_t first = firstPosition();
+    double w = static_cast<double>(window);
+    double alpha = 2 / (w + 1);
+    for (size_t i = consumed; i < series.size(); ++i)
+    {
+        RowIndex row = rows[i];
+        switch (metric)
+        {
+        case RollingMetric::Sma:
+        case RollingMetric::Ema:
+        case RollingMetric::Vwap:
+        {
+            // Window [i + 1 - window, i]; EMA only needs the sum until its seed
+            double incoming = windowValue(series, columns, i);
+            if (metric == RollingMetric::Ema && i > first)
+            {
+                ema += alpha * (incoming - ema);
+                values.push_back(ema);
+                break;
+            }
+            sum += incoming;
+            volumeSum += columns.volume[row];
+            if (i >= window)
+            {
+                sum -= windowValue(series, columns, i - window);
+                volumeSum -= columns.volume[rows[i - window]];
+            }
+            if (i < first)
+            {
+                break;
+            }
+            if (metric == RollingMetric::Vwap)
+            {
+                values.push_back(volumeSum > 0 ? sum / volumeSum : 0);
+            }
+            else
+            {
+                ema = sum / w;
+                values.push_back(ema);
+            }
+            break;
+        }
+
+        case RollingMetric::Return:
+            if (i >= first)
+            {
+                values.push_back(columns.close[row] / columns.close[rows[i - window]] - 1);
+            }
+            break;
+
+        case RollingMetric::Volatility:
+        {
+            // Returns start at position 1; window [i + 1 - window, i] of them
+            if (i == 0)
+            {
+                break;
+            }
+            double incoming = windowValue(series, columns, i);
+            if (i <= window)
+            {
+                double delta = incoming - mean;
+                mean += delta / static_cast<double>(i);
+                m2 += delta * (incoming - mean);
+            }
+            else
+            {
+                double outgoing = windowValue(series, columns, i - window);
+                double oldMean = mean;
+                mean += (incoming - outgoing) / w;
+                m2 += (incoming - outgoing) * (incoming - mean + outgoing - oldMean);
+            }
+            if (i >= first)
+            {
+                values.push_back(window > 1 ? std::sqrt(std::max(m2, 0.0) / (w - 1)) : 0);
+            }
+            break;
+        }
+        }
+    }
+    consumed = series.size();
+    lastRow = consumed == 0 ? NO_ROW : rows[consumed - 1];
+}
+
+RollingCache &RollingCache::operator=(const RollingCache &other)
+{
+    if (this != &other)
+    {
+        clear();
+    }
+    return *this;
+}
+
+void RollingCache::trim(std::uint64_t keep)
+{
+    if (entries.size() <= MAX_SERIES)
+    {
+        return;
+    }
+    std::vector<std::uint64_t> uses;
+    for (const auto &entry : entries)
+    {
+        uses.push_back(entry.second.lastUse);
+    }
+    std::nth_element(uses.begin(), uses.begin() + MAX_SERIES / 2, uses.end(), std::greater<std::uint64_t>());
+    std::uint64_t cutoff = uses[MAX_SERIES / 2];
+    for (auto it = entries.begin(); it != entries.end();)
+    {
+        it = it->second.lastUse <= cutoff && it->first != keep ? entries.erase(it) : std::next(it);
+    }
+}
+
+std::shared_ptr<const RollingSeries> RollingCache::find(std::uint32_t tickerId, RollingMetric metric, size_t window,
+                                                        const TickerSeries &series, const StockColumns &columns, bool &hit)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::uint64_t k = key(tickerId, metric, window);
+    auto it = entries.find(k);
+    hit = it != entries.end();
+    if (!hit)
+    {
+        it = entries.emplace(k, Entry{std::make_shared<RollingSeries>(metric, window), 0}).first;
+        it->second.series->extend(series, columns);
+    }
+    it->second.lastUse = ++useClock;
+    std::shared_ptr<const RollingSeries> found = it->second.series;
+    if (!hit)
+    {
+        trim(k);
+    }
+    return found;
+}
+
+void RollingCache::update(std::uint32_t tickerId, const TickerSeries &series, const StockColumns &columns)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = entries.begin(); it != entries.end();)
+    {
+        if ((it->first >> 32) != tickerId)
+        {
+            ++it;
+        }
+        else if (it->second.series->isPrefixOf(series))
+        {
+            it->second.series->extend(series, columns);
+            ++it;
+        }
+        else
+        {
+            it = entries.erase(it);
+        }
+    }
+    trim(UINT64_MAX);
+}
+
+void RollingCache::erase(std::uint32_t tickerId)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = entries.begin(); it != entries.end();)
+    {
+        it = (it->first >> 32) == tickerId ? entries.erase(it) : std::next(it);
+    }
+}
+
+void RollingCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+}
+
+size_t RollingCache::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
@@ -0,0 +1,349 @@
+#include "RowFilter.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+
+RowFilter &RowFilter::between(DayNumber first, DayNumber last)
+{
+    firstDay = std::max(firstDay, first);
+    lastDay = std::min(lastDay, last);
+    return *this;
+}
+
+RowFilter &RowFilter::forTicker(std::string_view name)
+{
+    if (!ticker.empty() && ticker != name)
+    {
+        // No row has two tickers
+        return between(std::numeric_limits<DayNumber>::max(), std::numeric_limits<DayNumber>::min());
+    }
+    ticker.assign(name);
+    return *this;
+}
+
+RowFilter &RowFilter::withDividend()
+{
+    paysDividend = true;
+    return *this;
+}
+
+RowFilter &RowFilter::where(StockField field, double lower, double upper)
+{
+    for (FieldRange &range : ranges)
+    {
+        if (range.field == field)
+        {
+            range.lower = std::max(range.lower, lower);
+            range.upper = std::min(range.upper, upper);
+            return *this;
+        }
+    }
+    ranges.push_back({field, lower, upper});
+    return *this;
+}
+
+RowFilter &RowFilter::above(StockField field, double value)
+{
+    return where(field, value, std::numeric_limits<double>::infinity());
+}
+
+RowFilter &RowFilter::atLeast(StockField field, double value)
+{
+    return where(field, std::nextafter(value, -std::numeric_limits<double>::infinity()), std::numeric_limits<double>::infinity());
+}
+
+RowFilter &RowFilter::below(StockField field, double value)
+{
+    return where(field, -std::numeric_limits<double>::infinity(), std::nextafter(value, -std::numeric_limits<double>::infinity()));
+}
+
+RowFilter &RowFilter::atMost(StockField field, double value)
+{
+    return where(field, -std::numeric_limits<double>::infinity(), value);
+}
+
+RowFilter &RowFilter::equals(StockField field, double value)
+{
+    return where(field, std::nextafter(value, -std::numeric_limits<double>::infinity()), value);
+}
+
+bool RowFilter::isEmpty() const
+{
+    return !restrictsDates() && ticker.empty() && !paysDividend && ranges.empty();
+}
+
+bool RowFilter::restrictsDates() const
+{
+    return firstDay != std::numeric_limits<DayNumber>::min() || lastDay != std::numeric_limits<DayNumber>::max();
+}
+
+bool RowFilter::excludesAll() const
+{
+    if (firstDay > lastDay)
+    {
+        return true;
+    }
+    for (const FieldRange &range : ranges)
+    {
+        if (!(range.lower < range.upper))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+const FieldRange *RowFilter::range(StockField field) const
+{
+    for (const FieldRange &range : ranges)
+    {
+        if (range.field == field)
+        {
+            return &range;
+        }
+    }
+    return nullptr;
+}
+
+bool RowFilter::mayMatch(const DatePartition &partition) const
+{
+    if (partition.rows == 0 || partition.lastDay() < firstDay || partition.firstDay() > lastDay)
+    {
+        return false;
+    }
+    if (paysDividend && !(partition.maximum[static_cast<size_t>(StockField::Dividends)] > 0))
+    {
+        return false;
+    }
+    for (const FieldRange &range : ranges)
+    {
+        size_t f = static_cast<size_t>(range.field);
+        if (!(partition.maximum[f] > range.lower) || !(partition.minimum[f] <= range.upper))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+namespace
+{
+    const StockField FIELDS[] = {StockField::Open, StockField::High, StockField::Low,
+                                 StockField::Close, StockField::Volume, StockField::Dividends};
+
+    bool parseValue(std::string_view text, double &value)
+    {
+        const char *first = text.data();
+        const char *last = first + text.size();
+        if (first != last && *first == '+')
+        {
+            ++first;
+        }
+        auto result = std::from_chars(first, last, value);
+        return result.ec == std::errc() && result.ptr == last;
+    }
+
+    bool parseCondition(std::string_view text, RowFilter &filter, std::string &error)
+    {
+        if (text == "dividend")
+        {
+            filter.withDividend();
+            return true;
+        }
+        size_t opStart = text.find_first_of("<>=");
+        if (opStart == std::string_view::npos || opStart == 0)
+        {
+            error = "invalid condition '" + std::string(text) + "'";
+            return false;
+        }
+        size_t opEnd = opStart + 1;
+        if (opEnd < text.size() && text[opEnd] == '=' && text[opStart] != '=')
+        {
+            ++opEnd;
+        }
+        std::string_view name = text.substr(0, opStart);
+        std::string_view op = text.substr(opStart, opEnd - opStart);
+        std::string_view value = text.substr(opEnd);
+
+        if (name == "ticker")
+        {
+            if (op != "=" || value.empty())
+            {
+                error = "invalid condition '" + std::string(text) + "'";
+                return false;
+            }
+            filter.forTicker(value);
+            return true;
+        }
+        if (name == "date")
+        {
+            DayNumber day;
+            if (!parseDate(value, day))
+            {
+                error = "invalid date '" + std::string(value) + "'";
+                return false;
+            }
+            if (op == "<")
+            {
+                filter.between(std::numeric_limits<DayNumber>::min(), day - 1);
+            }
+            else if (op == "<=")
+            {
+                filter.between(std::numeric_limits<DayNumber>::min(), day);
+            }
+            else if (op == ">")
+            {
+                filter.between(day + 1, std::numeric_limits<DayNumber>::max());
+            }
+            else if (op == ">=")
+            {
+                filter.between(day, std::numeric_limits<DayNumber>::max());
+            }
+            else
+            {
+                filter.on(day);
+            }
+            return true;
+        }
+
+        StockField field;
+        double number;
+        if (!parseStockField(name, field))
+        {
+            error = "unknown field '" + std::string(name) + "'";
+            return false;
+        }
+        if (!parseValue(value, number))
+        {
+            error = "invalid number '" + std::string(value) + "'";
+            return false;
+        }
+        if (op == "<")
+        {
+            filter.below(field, number);
+        }
+        else if (op == "<=")
+        {
+            filter.atMost(field, number);
+        }
+        else if (op == ">")
+        {
+            filter.above(field, number);
+        }
+        else if (op == ">=")
+        {
+            filter.atLeast(field, number);
+        }
+        else
+        {
+            filter.equals(field, number);
+        }
+        return true;
+    }
+}
+
+bool parseStockField(std::string_view text, StockField &field)
+{
+    for (StockField candidate : FIELDS)
+    {
+        if (text == stockFieldName(candidate))
+        {
+            field = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *stockFieldName(StockField field)
+{
+    switch (field)
+    {
+    case StockField::Open:
+        return "open";
+    case StockField::High:
+        return "high";
+    case StockField::Low:
+        return "low";
+    case StockField::Close:
+        return "close";
+    case StockField::Volume:
+        return "volume";
+    default:
+        return "dividends";
+    }
+}
+
+bool parseFilterQuery(const std::vector<std::string> &words, FilterQuery &query, std::string &error)
+{
+    query = FilterQuery();
+    if (words.empty())
+    {
+        error = "missing output (count, dates, sum, avg, max, min, top or bottom)";
+        return false;
+    }
+    const std::string &output = words[0];
+    size_t next = 1;
+    if (output == "count" || output == "dates")
+    {
+        query.output = output == "count" ? FilterOutput::Count : FilterOutput::Dates;
+    }
+    else
+    {
+        if (output == "sum")
+        {
+            query.output = FilterOutput::Sum;
+        }
+        else if (output == "avg")
+        {
+            query.output = FilterOutput::Average;
+        }
+        else if (output == "max")
+        {
+            query.output = FilterOutput::Max;
+        }
+        else if (output == "min")
+        {
+            query.output = FilterOutput::Min;
+        }
+        else if (output == "top")
+        {
+            query.output = FilterOutput::Top;
+        }
+        else if (output == "bottom")
+        {
+            query.output = FilterOutput::Bottom;
+        }
+        else
+        {
+            error = "unknown output '" + output + "'";
+            return false;
+        }
+        if (next >= words.size() || !parseStockField(words[next], query.field))
+        {
+            error = output + " takes a field (open, high, low, close, volume or dividends)";
+            return false;
+        }
+        ++next;
+        if (query.output == FilterOutput::Top || query.output == FilterOutput::Bottom)
+        {
+            const std::string *count = next < words.size() ? &words[next] : nullptr;
+            auto result = count == nullptr ? std::from_chars_result{nullptr, std::errc::invalid_argument}
+                                           : std::from_chars(count->data(), count->data() + count->size(), query.k);
+            if (count == nullptr || result.ec != std::errc() || result.ptr != count->data() + count->size())
+            {
+                error = output + " takes a field and a count";
+                return false;
+            }
+            ++next;
+        }
+    }
+    for (; next < words.size(); ++next)
+    {
+        if (!parseCondition(words[next], query.filter, error))
+        {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,530 @@
+#include "ScanKernels.h"
+#include <atomic>
+#include <limits>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define SCAN_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    constexpr size_t LANES = 8;
+
+    struct KernelTable
+    {
+        double (*sum)(const double *, size_t);
+        double (*max)(const double *, size_t);
+        double (*min)(const double *, size_t);
+        double (*dot)(const double *, const double *, size_t);
+        size_t (*countAbove)(const double *, size_t, double);
+        size_t (*countBetween)(const double *, size_t, double, double);
+        size_t (*filterBetween)(const double *, size_t, double, double, std::uint32_t *);
+        void (*maskBetween)(const double *, size_t, double, double, std::uint64_t *);
+        void (*addToAll)(double *, size_t, double);
+    };
+
+    double addOp(double a, double b) { return a + b; }
+    double maxOp(double acc, double value) { return value > acc ? value : acc; }
+    double minOp(double acc, double value) { return value < acc ? value : acc; }
+
+    // Fold the tail into the lanes, then combine lanes (0,4) (1,5) (2,6) (3,7), then (0,2) (1,3), then (0,1)
+    template <typename Op>
+    double finish(double *lanes, const double *tail, size_t tailCount, Op op)
+    {
+        for (size_t j = 0; j < tailCount; ++j)
+        {
+            lanes[j] = op(lanes[j], tail[j]);
+        }
+        for (size_t width = LANES / 2; width > 0; width /= 2)
+        {
+            for (size_t j = 0; j < width; ++j)
+            {
+                lanes[j] = op(lanes[j], lanes[j + width]);
+            }
+        }
+        return lanes[0];
+    }
+
+    // Scalar reference
+
+    template <typename Op>
+    double reduceScalar(const double *values, size_t count, double init, Op op)
+    {
+        double lanes[LANES];
+        for (double &lane : lanes)
+        {
+            lane = init;
+        }
+        size_t i = 0;
+        for (; i + LANES <= count; i += LANES)
+        {
+            for (size_t j = 0; j < LANES; ++j)
+            {
+                lanes[j] = op(lanes[j], values[i + j]);
+            }
+        }
+        return finish(lanes, values + i, count - i, op);
+    }
+
+    double sumScalar(const double *values, size_t count) { return reduceScalar(values, count, 0.0, addOp); }
+    double maxScalar(const double *values, size_t count)
+    {
+        return reduceScalar(values, count, -std::numeric_limits<double>::infinity(), maxOp);
+    }
+    double minScalar(const double *values, size_t count)
+    {
+        return reduceScalar(values, count, std::numeric_limits<double>::infinity(), minOp);
+    }
+
+    // Products are rounded before they are added (no fused multiply-add), as in the vector paths
+    double dotTail(double *lanes, const double *a, const double *b, size_t count)
+    {
+        double tail[LANES];
+        for (size_t j = 0; j < count; ++j)
+        {
+            tail[j] = a[j] * b[j];
+        }
+        return finish(lanes, tail, count, addOp);
+    }
+
+    double dotScalar(const double *a, const double *b, size_t count)
+    {
+        double lanes[LANES] = {};
+        size_t i = 0;
+        for (; i + LANES <= count; i += LANES)
+        {
+            for (size_t j = 0; j < LANES; ++j)
+            {
+                lanes[j] += a[i + j] * b[i + j];
+            }
+        }
+        return dotTail(lanes, a + i, b + i, count - i);
+    }
+
+    size_t countAboveScalar(const double *values, size_t count, double threshold)
+    {
+        size_t n = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            n += values[i] > threshold;
+        }
+        return n;
+    }
+
+    size_t countBetweenScalar(const double *values, size_t count, double lower, double upper)
+    {
+        size_t n = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            n += values[i] > lower && values[i] <= upper;
+        }
+        return n;
+    }
+
+    size_t filterBetweenScalar(const double *values, size_t count, double lower, double upper, std::uint32_t *out)
+    {
+        size_t n = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (values[i] > lower && values[i] <= upper)
+            {
+                out[n++] = static_cast<std::uint32_t>(i);
+            }
+        }
+        return n;
+    }
+
+    void maskBetweenScalar(const double *values, size_t count, double lower, double upper, std::uint64_t *bits)
+    {
+        for (size_t i = 0; i < count; i += 64)
+        {
+            std::uint64_t word = 0;
+            size_t n = count - i < 64 ? count - i : 64;
+            for (size_t j = 0; j < n; ++j)
+            {
+                word |= std::uint64_t(values[i + j] > lower && values[i + j] <= upper) << j;
+            }
+            bits[i / 64] = word;
+        }
+    }
+
+    void addToAllScalar(double *values, size_t count, double delta)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            values[i] += delta;
+        }
+    }
+
+    const KernelTable SCALAR_KERNELS = {sumScalar, maxScalar, minScalar, dotScalar, countAboveScalar,
+                                        countBetweenScalar, filterBetweenScalar, maskBetweenScalar, addToAllScalar};
+
+#ifdef SCAN_KERNELS_X86
+
+    // AVX2: lanes 0-3 in `low`, 4-7 in `high`. max_pd(v, acc) is v > acc ? v : acc, like maxOp.
+
+#define AVX2_REDUCE(name, init, vectorOp, scalarOp)                                      \
+    __attribute__((target("avx2"))) double name(const double *values, size_t count)      \
+    {                                                                                    \
+        __m256d low = _mm256_set1_pd(init), high = low;                                  \
+        size_t i = 0;                                                                    \
+        for (; i + LANES <= count; i += LANES)                                           \
+        {                                                                                \
+            low = vectorOp(_mm256_loadu_pd(values + i), low);                            \
+            high = vectorOp(_mm256_loadu_pd(values + i + 4), high);                      \
+        }                                                                                \
+        double lanes[LANES];                                                             \
+        _mm256_storeu_pd(lanes, low);                                                    \
+        _mm256_storeu_pd(lanes + 4, high);                                               \
+        return finish(lanes, values + i, count - i, scalarOp);                           \
+    }
+
+    AVX2_REDUCE(sumAvx2, 0.0, _mm256_add_pd, addOp)
+    AVX2_REDUCE(maxAvx2, -std::numeric_limits<double>::infinity(), _mm256_max_pd, maxOp)
+    AVX2_REDUCE(minAvx2, std::numeric_limits<double>::infinity(), _mm256_min_pd, minOp)
+#undef AVX2_REDUCE
+
+    __attribute__((target("avx2"))) double dotAvx2(const double *a, const double *b, size_t count)
+    {
+        __m256d low = _mm256_setzero_pd(), high = low;
+        size_t i = 0;
+        for (; i + LANES <= count; i += LANES)
+        {
+            low = _mm256_add_pd(low, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+            high = _mm256_add_pd(high, _mm256_mul_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4)));
+        }
+        double lanes[LANES];
+        _mm256_storeu_pd(lanes, low);
+        _mm256_storeu_pd(lanes + 4, high);
+        return dotTail(lanes, a + i, b + i, count - i);
+    }
+
+    __attribute__((target("avx2,popcnt"))) size_t countAboveAvx2(const double *values, size_t count, double threshold)
+    {
+        __m256d t = _mm256_set1_pd(threshold);
+        size_t n = 0, i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            n += __builtin_popcount(_mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(values + i), t, _CMP_GT_OQ)));
+        }
+        return n + countAboveScalar(values + i, count - i, threshold);
+    }
+
+    __attribute__((target("avx2"))) inline int betweenMaskAvx2(const double *values, __m256d lower, __m256d upper)
+    {
+        __m256d v = _mm256_loadu_pd(values);
+        return _mm256_movemask_pd(_mm256_and_pd(_mm256_cmp_pd(v, lower, _CMP_GT_OQ), _mm256_cmp_pd(v, upper, _CMP_LE_OQ)));
+    }
+
+    __attribute__((target("avx2,popcnt"))) size_t countBetweenAvx2(const double *values, size_t count, double lower, double upper)
+    {
+        __m256d lo = _mm256_set1_pd(lower), hi = _mm256_set1_pd(upper);
+        size_t n = 0, i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            n += __builtin_popcount(betweenMaskAvx2(values + i, lo, hi));
+        }
+        return n + countBetweenScalar(values + i, count - i, lower, upper);
+    }
+
+    __attribute__((target("avx2,bmi"))) size_t filterBetweenAvx2(const double *values, size_t count, double lower, double upper,
+                                                                 std::uint32_t *out)
+    {
+        __m256d lo = _mm256_set1_pd(lower), hi = _mm256_set1_pd(upper);
+        size_t n = 0, i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            unsigned mask = static_cast<unsigned>(betweenMaskAvx2(values + i, lo, hi));
+            while (mask != 0)
+            {
+                out[n++] = static_cast<std::uint32_t>(i + __builtin_ctz(mask));
+                mask &= mask - 1;
+            }
+        }
+        for (; i < count; ++i)
+        {
+            if (values[i] > lower && values[i] <= upper)
+            {
+                out[n++] = static_cast<std::uint32_t>(i);
+            }
+        }
+        return n;
+    }
+
+    __attribute__((target("avx2"))) void maskBetweenAvx2(const double *values, size_t count, double lower, double upper,
+                                                         std::uint64_t *bits)
+    {
+        __m256d lo = _mm256_set1_pd(lower), hi = _mm256_set1_pd(upper);
+        size_t full = count / 64 * 64;
+        for (size_t i = 0; i < full; i += 64)
+        {
+            std::uint64_t word = 0;
+            for (size_t j = 0; j < 64; j += 4)
+            {
+                word |= static_cast<std::uint64_t>(betweenMaskAvx2(values + i + j, lo, hi)) << j;
+            }
+            bits[i / 64] = word;
+        }
+        if (full < count)
+        {
+            maskBetweenScalar(values + full, count - full, lower, upper, bits + full / 64);
+        }
+    }
+
+    __attribute__((target("avx2"))) void addToAllAvx2(double *values, size_t count, double delta)
+    {
+        __m256d d = _mm256_set1_pd(delta);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            _mm256_storeu_pd(values + i, _mm256_add_pd(_mm256_loadu_pd(values + i), d));
+        }
+        addToAllScalar(values + i, count - i, delta);
+    }
+
+    const KernelTable AVX2_KERNELS = {sumAvx2, maxAvx2, minAvx2, dotAvx2, countAboveAvx2,
+                                      countBetweenAvx2, filterBetweenAvx2, maskBetweenAvx2, addToAllAvx2};
+
+    // AVX-512: all 8 lanes in one register. Extremes are a compare and blend
+    // (same result as maxOp/minOp, and clear of GCC's max_pd warnings).
+
+    __attribute__((target("avx512f"))) inline __m512d maxAvx512Op(__m512d value, __m512d acc)
+    {
+        return _mm512_mask_blend_pd(_mm512_cmp_pd_mask(value, acc, _CMP_GT_OQ), acc, value);
+    }
+
+    __attribute__((target("avx512f"))) inline __m512d minAvx512Op(__m512d value, __m512d acc)
+    {
+        return _mm512_mask_blend_pd(_mm512_cmp_pd_mask(value, acc, _CMP_LT_OQ), acc, value);
+    }
+
+#define AVX512_REDUCE(name, init, vectorOp, scalarOp)                                    \
+    __attribute__((target("avx512f"))) double name(const double *values, size_t count)   \
+    {                                                                                    \
+        __m512d acc = _mm512_set1_pd(init);                                              \
+        size_t i = 0;                                                                    \
+        for (; i + LANES <= count; i += LANES)                                           \
+        {                                                                                \
+            acc = vectorOp(_mm512_loadu_pd(values + i), acc);                            \
+        }                                                                                \
+        double lanes[LANES];                                                             \
+        _mm512_storeu_pd(lanes, acc);                                                    \
+        return finish(lanes, values + i, count - i, scalarOp);                           \
+    }
+
+    AVX512_REDUCE(sumAvx512, 0.0, _mm512_add_pd, addOp)
+    AVX512_REDUCE(maxAvx512, -std::numeric_limits<double>::infinity(), maxAvx512Op, maxOp)
+    AVX512_REDUCE(minAvx512, std::numeric_limits<double>::infinity(), minAvx512Op, minOp)
+#undef AVX512_REDUCE
+
+    __attribute__((target("avx512f"))) double dotAvx512(const double *a, const double *b, size_t count)
+    {
+        __m512d acc = _mm512_setzero_pd();
+        size_t i = 0;
+        for (; i + LANES <= count; i += LANES)
+        {
+            acc = _mm512_add_pd(acc, _mm512_mul_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i)));
+        }
+        double lanes[LANES];
+        _mm512_storeu_pd(lanes, acc);
+        return dotTail(lanes, a + i, b + i, count - i);
+    }
+
+    __attribute__((target("avx512f,popcnt"))) size_t countAboveAvx512(const double *values, size_t count, double threshold)
+    {
+        __m512d t = _mm512_set1_pd(threshold);
+        size_t n = 0, i = 0;
+        for (; i + LANES <= count; i += LANES)
+        {
+            n += __builtin_popcount(_mm512_cmp_pd_mask(_mm512_loadu_pd(values + i), t, _CMP_GT_OQ));
+        }
+        return n + countAboveScalar(values + i, count - i, threshold);
+    }
+
+    __attribute__((target("avx512f"))) inline unsigned betweenMaskAvx512(const double *values, __m512d lower, __m512d upper)
+    {
+        __m512d v = _mm512_loadu_pd(values);
+        return _mm512_mask_cmp_pd_mask(_mm512_cmp_pd_mask(v, lower, _CMP_GT_OQ), v, upper, _CMP_LE_OQ);
+    }
+
+    __attribute__((target("avx512f,popcnt"))) size_t countBetweenAvx512(const double *values, size_t count, double lower, double upper)
+    {
+        __m512d lo = _mm512_set1_pd(lower), hi = _mm512_set1_pd(upper);
+        size_t n = 0, i = 0;
+        for (; i + LANES <= count; i += LANES)
+        {
+            n += __builtin_popcount(betweenMaskAvx512(values + i, lo, hi));
+        }
+        return n + countBetweenScalar(values + i, count - i, lower, upper);
+    }
+
+    __attribute__((target("avx512f"))) size_t filterBetweenAvx512(const double *values, size_t count, double lower, double upper,
+                                                                  std::uint32_t *out)
+    {
+        __m512d lo = _mm512_set1_pd(lower), hi = _mm512_set1_pd(upper);
+        size_t n = 0, i = 0;
+        for (; i + LANES <= count; i += LANES)
+        {
+            unsigned mask = betweenMaskAvx512(values + i, lo, hi);
+            while (mask != 0)
+            {
+                out[n++] = static_cast<std::uint32_t>(i + __builtin_ctz(mask));
+                mask &= mask - 1;
+            }
+        }
+        for (; i < count; ++i)
+        {
+            if (values[i] > lower && values[i] <= upper)
+            {
+                out[n++] = static_cast<std::uint32_t>(i);
+            }
+        }
+        return n;
+    }
+
+    __attribute__((target("avx512f"))) void maskBetweenAvx512(const double *values, size_t count, double lower, double upper,
+                                                              std::uint64_t *bits)
+    {
+        __m512d lo = _mm512_set1_pd(lower), hi = _mm512_set1_pd(upper);
+        size_t full = count / 64 * 64;
+        for (size_t i = 0; i < full; i += 64)
+        {
+            std::uint64_t word = 0;
+            for (size_t j = 0; j < 64; j += LANES)
+            {
+                word |= static_cast<std::uint64_t>(betweenMaskAvx512(values + i + j, lo, hi)) << j;
+            }
+            bits[i / 64] = word;
+        }
+        if (full < count)
+        {
+            maskBetweenScalar(values + full, count - full, lower, upper, bits + full / 64);
+        }
+    }
+
+    __attribute__((target("avx512f"))) void addToAllAvx512(double *values, size_t count, double delta)
+    {
+        __m512d d = _mm512_set1_pd(delta);
+        size_t i = 0;
+        for (; i + LANES <= count; i += LANES)
+        {
+            _mm512_storeu_pd(values + i, _mm512_add_pd(_mm512_loadu_pd(values + i), d));
+        }
+        addToAllScalar(values + i, count - i, delta);
+    }
+
+    const KernelTable AVX512_KERNELS = {sumAvx512, maxAvx512, minAvx512, dotAvx512, countAboveAvx512,
+                                        countBetweenAvx512, filterBetweenAvx512, maskBetweenAvx512, addToAllAvx512};
+#endif
+
+    ScanKernel bestSupported()
+    {
+#ifdef SCAN_KERNELS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f"))
+        {
+            return ScanKernel::Avx512;
+        }
+        if (__builtin_cpu_supports("avx2"))
+        {
+            return ScanKernel::Avx2;
+        }
+#endif
+        return ScanKernel::Scalar;
+    }
+
+    const KernelTable *tableFor(ScanKernel kernel)
+    {
+#ifdef SCAN_KERNELS_X86
+        if (kernel == ScanKernel::Avx512)
+        {
+            return &AVX512_KERNELS;
+        }
+        if (kernel == ScanKernel::Avx2)
+        {
+            return &AVX2_KERNELS;
+        }
+#endif
+        (void)kernel;
+        return &SCALAR_KERNELS;
+    }
+
+    struct Dispatch
+    {
+        ScanKernel supported = bestSupported();
+        std::atomic<ScanKernel> kernel{supported};
+        std::atomic<const KernelTable *> table{tableFor(supported)};
+    };
+
+    Dispatch &dispatch()
+    {
+        static Dispatch instance;
+        return instance;
+    }
+
+    const KernelTable &kernels()
+    {
+        return *dispatch().table.load(std::memory_order_relaxed);
+    }
+}
+
+ScanKernel activeScanKernel()
+{
+    return dispatch().kernel.load();
+}
+
+ScanKernel setScanKernel(ScanKernel kernel)
+{
+    Dispatch &d = dispatch();
+    if (static_cast<int>(kernel) > static_cast<int>(d.supported))
+    {
+        kernel = d.supported;
+    }
+    d.kernel.store(kernel);
+    d.table.store(tableFor(kernel));
+    return kernel;
+}
+
+const char *scanKernelName(ScanKernel kernel)
+{
+    switch (kernel)
+    {
+    case ScanKernel::Avx512:
+        return "avx512";
+    case ScanKernel::Avx2:
+        return "avx2";
+    default:
+        return "scalar";
+    }
+}
+
+double scanSum(const double *values, size_t count) { return kernels().sum(values, count); }
+double scanMax(const double *values, size_t count) { return kernels().max(values, count); }
+double scanMin(const double *values, size_t count) { return kernels().min(values, count); }
+double scanDot(const double *a, const double *b, size_t count) { return kernels().dot(a, b, count); }
+
+size_t scanCountAbove(const double *values, size_t count, double threshold)
+{
+    return kernels().countAbove(values, count, threshold);
+}
+
+size_t scanCountBetween(const double *values, size_t count, double lower, double upper)
+{
+    return kernels().countBetween(values, count, lower, upper);
+}
+
+size_t scanFilterBetween(const double *values, size_t count, double lower, double upper, std::uint32_t *out)
+{
+    return kernels().filterBetween(values, count, lower, upper, out);
+}
+
+void scanMaskBetween(const double *values, size_t count, double lower, double upper, std::uint64_t *bits)
+{
+    kernels().maskBetween(values, count, lower, upper, bits);
+}
+
+void scanAddToAll(double *values, size_t count, double delta)
+{
+    kernels().addToAll(values, count, delta);
+}
@@ -0,0 +1,440 @@
+#include "Snapshot.h"
+#include "StockDatabase.h"
+#include "Instrumentation.h"
+#include "MappedFile.h"
+#include "ColdSegment.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+    const char PADDING[8] = {};
+
+    template <typename T>
+    void writeSection(std::ostream &out, const T *values, size_t count)
+    {
+        size_t bytes = count * sizeof(T);
+        out.write(reinterpret_cast<const char *>(values), static_cast<std::streamsize>(bytes));
+        out.write(PADDING, static_cast<std::streamsize>((8 - bytes % 8) % 8));
+    }
+
+    // A column section holds its cold rows (decoded) followed by its in-memory rows
+    template <typename T>
+    void writeSection(std::ostream &out, const Column<T> &column)
+    {
+        size_t bytes = column.size() * sizeof(T);
+        column.forEachBlock(0, column.size(), [&out](const T *values, size_t n, size_t)
+                            { out.write(reinterpret_cast<const char *>(values), static_cast<std::streamsize>(n * sizeof(T))); });
+        out.write(PADDING, static_cast<std::streamsize>((8 - bytes % 8) % 8));
+    }
+
+    // Bounds-checked walk over the 8-byte aligned sections of a mapped snapshot
+    class SnapshotReader
+    {
+    private:
+        const char *cursor;
+        const char *end;
+
+    public:
+        SnapshotReader(const char *begin, const char *end) : cursor(begin), end(end) {}
+
+        // Returns nullptr when the section would run past the end of the file
+        template <typename T>
+        const T *section(std::uint64_t count)
+        {
+            std::uint64_t available = static_cast<std::uint64_t>(end - cursor);
+            if (count > available / sizeof(T))
+            {
+                return nullptr;
+            }
+            std::uint64_t padded = (count * sizeof(T) + 7) & ~std::uint64_t(7);
+            if (padded > available)
+            {
+                return nullptr;
+            }
+            const T *values = reinterpret_cast<const T *>(cursor);
+            cursor += padded;
+            return values;
+        }
+    };
+
+    // CSR offsets must start at 0, never decrease and end at `total`
+    bool validOffsets(const std::uint64_t *offsets, std::uint64_t count, std::uint64_t total)
+    {
+        if (offsets[0] != 0 || offsets[count] != total)
+        {
+            return false;
+        }
+        for (std::uint64_t i = 0; i < count; ++i)
+        {
+            if (offsets[i] > offsets[i + 1])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+std::uint64_t snapshotChecksum(const char *data, size_t size)
+{
+    std::uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i + 8 <= size; i += 8)
+    {
+        std::uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * 1099511628211ull;
+    }
+    return hash;
+}
+
+bool StockDatabase::saveSnapshot(const std::string &filename) const
+{
+    OperationTimer timer(Operation::SaveSnapshot);
+    std::string tempName = filename + ".tmp";
+    size_t rowCount = columns.size();
+    size_t tickerCount = columns.tickers.size();
+
+    std::vector<DayNumber> days;
+    days.reserve(dateMap.size());
+    for (const auto &entry : dateMap)
+    {
+        days.push_back(entry.first);
+    }
+    std::sort(days.begin(), days.end());
+
+    SnapshotHeader header{};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.headerSize = sizeof(SnapshotHeader);
+    header.rowCount = rowCount;
+    header.tickerCount = tickerCount;
+    header.dateCount = days.size();
+    header.partitionCount = datePartitions.size();
+
+    {
+        std::ofstream out(tempName, std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            return false;
+        }
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+        writeSection(out, columns.ticker);
+        writeSection(out, columns.date);
+        writeSection(out, columns.open);
+        writeSection(out, columns.high);
+        writeSection(out, columns.low);
+        writeSection(out, columns.close);
+        writeSection(out, columns.volume);
+        writeSection(out, columns.dividends);
+        writeSection(out, columns.tombstones.data(), columns.tombstones.size());
+        writeSection(out, dividendRows.data().data(), dividendRows.wordCount());
+
+        std::vector<std::uint64_t> offsets{0};
+        std::string names;
+        for (std::uint32_t tickerId = 0; tickerId < tickerCount; ++tickerId)
+        {
+            names += columns.tickers.name(tickerId);
+            offsets.push_back(names.size());
+        }
+        writeSection(out, offsets.data(), offsets.size());
+        writeSection(out, names.data(), names.size());
+
+        offsets.assign(1, 0);
+        for (std::uint32_t tickerId = 0; tickerId < tickerCount; ++tickerId)
+        {
+            offsets.push_back(offsets.back() + (tickerId < tickerMap.size() ? tickerMap[tickerId].size() : 0));
+        }
+        writeSection(out, offsets.data(), offsets.size());
+        for (std::uint32_t tickerId = 0; tickerId < tickerMap.size(); ++tickerId)
+        {
+            const std::vector<RowIndex> &rows = tickerMap[tickerId].rowIndices();
+            out.write(reinterpret_cast<const char *>(rows.data()), static_cast<std::streamsize>(rows.size() * sizeof(RowIndex)));
+        }
+        out.write(PADDING, static_cast<std::streamsize>((8 - offsets.back() * sizeof(RowIndex) % 8) % 8));
+
+        std::vector<double> tables;
+        offsets.assign(1, 0);
+        for (std::uint32_t tickerId = 0; tickerId < tickerCount; ++tickerId)
+        {
+            std::vector<double> saved = tickerId < tickerMap.size() ? tickerMap[tickerId].savedTables() : TickerSeries().savedTables();
+            tables.insert(tables.end(), saved.begin(), saved.end());
+            offsets.push_back(tables.size());
+        }
+        writeSection(out, offsets.data(), offsets.size());
+        writeSection(out, tables.data(), tables.size());
+
+        writeSection(out, days.data(), days.size());
+        offsets.assign(1, 0);
+        std::vector<double> maxCloses;
+        maxCloses.reserve(days.size());
+        for (DayNumber day : days)
+        {
+            offsets.push_back(offsets.back() + dateMap.at(day).rows.size());
+            maxCloses.push_back(dateMap.at(day).maxClose);
+        }
+        writeSection(out, offsets.data(), offsets.size());
+        for (DayNumber day : days)
+        {
+            const std::vector<RowIndex> &rows = dateMap.at(day).rows;
+            out.write(reinterpret_cast<const char *>(rows.data()), static_cast<std::streamsize>(rows.size() * sizeof(RowIndex)));
+        }
+        out.write(PADDING, static_cast<std::streamsize>((8 - offsets.back() * sizeof(RowIndex) % 8) % 8));
+        for (DayNumber day : days)
+        {
+            const std::vector<RowIndex> &rows = dateMap.at(day).byVolume;
+            out.write(reinterpret_cast<const char *>(rows.data()), static_cast<std::streamsize>(rows.size() * sizeof(RowIndex)));
+        }
+        out.write(PADDING, static_cast<std::streamsize>((8 - offsets.back() * sizeof(RowIndex) % 8) % 8));
+        writeSection(out, maxCloses.data(), maxCloses.size());
+
+        std::vector<std::int32_t> months;
+        std::vector<std::uint64_t> partitionRows;
+        std::vector<double> bounds;
+        for (size_t i = 0; i < datePartitions.size(); ++i)
+        {
+            const DatePartition &partition = datePartitions[i];
+            months.push_back(partition.month);
+            partitionRows.push_back(partition.rows);
+            bounds.insert(bounds.end(), partition.minimum.begin(), partition.minimum.end());
+            bounds.insert(bounds.end(), partition.maximum.begin(), partition.maximum.end());
+        }
+        writeSection(out, months.data(), months.size());
+        writeSection(out, partitionRows.data(), partitionRows.size());
+        writeSection(out, bounds.data(), bounds.size());
+
+        if (!out)
+        {
+            return false;
+        }
+    }
+
+    // Checksum the payload as written, then patch the header
+    {
+        MappedFile file(tempName, AccessPattern::Sequential);
+        if (!file.isOpen() || file.size() < sizeof(SnapshotHeader))
+        {
+            return false;
+        }
+        header.payloadSize = file.size() - sizeof(SnapshotHeader);
+        header.checksum = snapshotChecksum(file.data() + sizeof(SnapshotHeader), header.payloadSize);
+    }
+    {
+        std::fstream out(tempName, std::ios::binary | std::ios::in | std::ios::out);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        if (!out)
+        {
+            return false;
+        }
+    }
+    return std::rename(tempName.c_str(), filename.c_str()) == 0;
+}
+
+// The columns stay in the mapped file and become its cold rows; the indexes
+// are adopted from the file, the ticker series' tables read in place. Cold
+// rows are left out of tickerDateMap, so it starts out empty.
+bool StockDatabase::loadSnapshot(const std::string &filename)
+{
+    OperationTimer timer(Operation::LoadSnapshot);
+    auto segment = std::make_shared<ColdSegment>(filename);
+    const MappedFile &file = segment->file;
+    if (!file.isOpen() || file.size() < sizeof(SnapshotHeader))
+    {
+        return false;
+    }
+
+    SnapshotHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 || header.version != SNAPSHOT_VERSION ||
+        header.headerSize != sizeof(SnapshotHeader) || header.payloadSize != file.size() - sizeof(SnapshotHeader) ||
+        header.payloadSize % 8 != 0 || header.tickerCount > TickerDictionary::npos || header.rowCount > UINT32_MAX ||
+        header.dateCount > header.rowCount || header.partitionCount > header.dateCount)
+    {
+        return false;
+    }
+    const char *payload = file.data() + sizeof(SnapshotHeader);
+    if (snapshotChecksum(payload, header.payloadSize) != header.checksum)
+    {
+        return false;
+    }
+
+    SnapshotReader reader(payload, payload + header.payloadSize);
+    std::uint64_t rowCount = header.rowCount;
+    std::uint64_t tickerCount = header.tickerCount;
+    std::uint64_t dateCount = header.dateCount;
+    std::uint64_t partitionCount = header.partitionCount;
+
+    const std::uint32_t *tickerColumn = reader.section<std::uint32_t>(rowCount);
+    const DayNumber *dateColumn = reader.section<DayNumber>(rowCount);
+    const double *values[6];
+    for (auto &column : values)
+    {
+        column = reader.section<double>(rowCount);
+        if (column == nullptr)
+        {
+            return false;
+        }
+    }
+    std::uint64_t bitmapWords = (rowCount + 63) / 64;
+    const std::uint64_t *tombstones = reader.section<std::uint64_t>(bitmapWords);
+    const std::uint64_t *dividendBits = reader.section<std::uint64_t>(bitmapWords);
+    const std::uint64_t *nameOffsets = reader.section<std::uint64_t>(tickerCount + 1);
+    if (tickerColumn == nullptr || dateColumn == nullptr || tombstones == nullptr || dividendBits == nullptr ||
+        nameOffsets == nullptr)
+    {
+        return false;
+    }
+    const char *names = reader.section<char>(nameOffsets[tickerCount]);
+    const std::uint64_t *tickerOffsets = reader.section<std::uint64_t>(tickerCount + 1);
+    if (names == nullptr || tickerOffsets == nullptr || !validOffsets(nameOffsets, tickerCount, nameOffsets[tickerCount]))
+    {
+        return false;
+    }
+    const RowIndex *tickerRows = reader.section<RowIndex>(tickerOffsets[tickerCount]);
+    const std::uint64_t *tableOffsets = reader.section<std::uint64_t>(tickerCount + 1);
+    if (tickerRows == nullptr || tableOffsets == nullptr || !validOffsets(tickerOffsets, tickerCount, tickerOffsets[tickerCount]))
+    {
+        return false;
+    }
+    const double *tables = reader.section<double>(tableOffsets[tickerCount]);
+    const DayNumber *days = reader.section<DayNumber>(dateCount);
+    const std::uint64_t *dateOffsets = reader.section<std::uint64_t>(dateCount + 1);
+    if (tables == nullptr || days == nullptr || dateOffsets == nullptr ||
+        !validOffsets(tableOffsets, tickerCount, tableOffsets[tickerCount]))
+    {
+        return false;
+    }
+    const RowIndex *dateRows = reader.section<RowIndex>(dateOffsets[dateCount]);
+    const RowIndex *volumeRows = reader.section<RowIndex>(dateOffsets[dateCount]);
+    const double *maxCloses = reader.section<double>(dateCount);
+    const std::int32_t *months = reader.section<std::int32_t>(partitionCount);
+    const std::uint64_t *partitionRows = reader.section<std::uint64_t>(partitionCount);
+    const double *bounds = reader.section<double>(partitionCount * 2 * DatePartition::FIELD_COUNT);
+    if (dateRows == nullptr || volumeRows == nullptr || maxCloses == nullptr || months == nullptr ||
+        partitionRows == nullptr || bounds == nullptr || !validOffsets(dateOffsets, dateCount, dateOffsets[dateCount]))
+    {
+        return false;
+    }
+    if (rowCount % 64 != 0 && ((tombstones[bitmapWords - 1] | dividendBits[bitmapWords - 1]) >> (rowCount % 64)) != 0)
+    {
+        return false;
+    }
+    for (std::uint64_t i = 0; i < rowCount; ++i)
+    {
+        if (tickerColumn[i] >= tickerCount)
+        {
+            return false;
+        }
+    }
+    for (std::uint64_t i = 0; i < tickerOffsets[tickerCount]; ++i)
+    {
+        if (tickerRows[i] >= rowCount)
+        {
+            return false;
+        }
+    }
+    for (std::uint64_t i = 0; i < dateOffsets[dateCount]; ++i)
+    {
+        if (dateRows[i] >= rowCount || volumeRows[i] >= rowCount)
+        {
+            return false;
+        }
+    }
+
+    StockColumns loaded;
+    for (std::uint64_t tickerId = 0; tickerId < tickerCount; ++tickerId)
+    {
+        std::string_view name(names + nameOffsets[tickerId], nameOffsets[tickerId + 1] - nameOffsets[tickerId]);
+        if (loaded.tickers.intern(name) != tickerId)
+        {
+            return false;
+        }
+    }
+    loaded.ticker.attach(tickerColumn, rowCount);
+    loaded.date.attach(dateColumn, rowCount);
+    loaded.open.attach(values[0], rowCount);
+    loaded.high.attach(values[1], rowCount);
+    loaded.low.attach(values[2], rowCount);
+    loaded.close.attach(values[3], rowCount);
+    loaded.volume.attach(values[4], rowCount);
+    loaded.dividends.attach(values[5], rowCount);
+    loaded.tombstones.assign(tombstones, tombstones + bitmapWords);
+    for (std::uint64_t word : loaded.tombstones)
+    {
+        loaded.deletedRows += __builtin_popcountll(word);
+    }
+    loaded.coldDeletedRows = loaded.deletedRows;
+    segment->months = monthRuns(dateColumn, rowCount, 0);
+    loaded.coldSegments.push_back(segment);
+
+    std::vector<TickerSeries> loadedTickerMap(tickerCount);
+    for (std::uint64_t tickerId = 0; tickerId < tickerCount; ++tickerId)
+    {
+        std::vector<RowIndex> rows(tickerRows + tickerOffsets[tickerId], tickerRows + tickerOffsets[tickerId + 1]);
+        if (!loadedTickerMap[tickerId].restore(std::move(rows), loaded, tables + tableOffsets[tickerId],
+                                               tableOffsets[tickerId + 1] - tableOffsets[tickerId]))
+        {
+            return false;
+        }
+    }
+    std::unordered_map<DayNumber, DateBucket> loadedDateMap;
+    loadedDateMap.reserve(dateCount);
+    std::vector<double> maxima(maxCloses, maxCloses + dateCount);
+    for (std::uint64_t i = 0; i < dateCount; ++i)
+    {
+        DateBucket &bucket = loadedDateMap[days[i]];
+        bucket.rows.assign(dateRows + dateOffsets[i], dateRows + dateOffsets[i + 1]);
+        bucket.byVolume.assign(volumeRows + dateOffsets[i], volumeRows + dateOffsets[i + 1]);
+        bucket.maxClose = maxCloses[i];
+    }
+
+    // Each partition owns the run of (ascending) days in its month
+    std::vector<DatePartition> loadedPartitions(partitionCount);
+    std::uint64_t day = 0;
+    for (std::uint64_t i = 0; i < partitionCount; ++i)
+    {
+        DatePartition &partition = loadedPartitions[i];
+        partition.month = months[i];
+        partition.rows = partitionRows[i];
+        std::copy(bounds, bounds + DatePartition::FIELD_COUNT, partition.minimum.begin());
+        std::copy(bounds + DatePartition::FIELD_COUNT, bounds + 2 * DatePartition::FIELD_COUNT, partition.maximum.begin());
+        bounds += 2 * DatePartition::FIELD_COUNT;
+        for (; day < dateCount && monthOf(days[day]) == partition.month; ++day)
+        {
+            if (!partition.days.empty() && days[day] <= partition.days.back())
+            {
+                return false;
+            }
+            partition.days.push_back(days[day]);
+        }
+        if (partition.days.empty() || (i > 0 && partition.month <= loadedPartitions[i - 1].month))
+        {
+            return false;
+        }
+    }
+    if (day != dateCount)
+    {
+        return false;
+    }
+
+    columns = std::move(loaded);
+    tickerMap = std::move(loadedTickerMap);
+    dateMap = std::move(loadedDateMap);
+    dateMaxCloses.assign(std::move(maxima));
+    datePartitions.assign(std::move(loadedPartitions));
+    datePartitions.setColdRows(columns);
+    dividendRows.assign(dividendBits, rowCount);
+    resetFieldRankings();
+    resultCache.clear();
+    rollingCache.clear();
+
+    tickerDateMap.clear();
+    if (!coldSegmentPath.empty())
+    {
+        moveColdPartitions();
+    }
+    return true;
+}
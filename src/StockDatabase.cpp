@@ -1,297 +1,1624 @@
 #include "StockDatabase.h"
+#include "CsvLoader.h"
+#include "Instrumentation.h"
+#include "ScanKernels.h"
+#include "ColdSegment.h"
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <algorithm>
 #include <chrono>
-#include <unordered_set>
-#include <queue>
+#include <iterator>
 
 void StockDatabase::loadData(const std::string &filename)
 {
-    std::ifstream file(filename);
-    std::string line;
-    std::getline(file, line);
+    OperationTimer timer(Operation::LoadData);
+    auto start = std::chrono::steady_clock::now();
+    CsvParseResult parsed = parseCsvFile(filename);
+    if (!parsed.opened)
+    {
+        std::cerr << "Could not open " << filename << std::endl;
+        return;
+    }
 
-    while (std::getline(file, line))
+    size_t rowsBefore = columns.size();
+    std::vector<std::vector<RowIndex>> newTickerRows;
+    for (CsvChunk &chunk : parsed.chunks)
+    {
+        std::cerr << chunk.errors;
+        mergeChunk(chunk, newTickerRows);
+    }
+    for (std::uint32_t tickerId = 0; tickerId < newTickerRows.size(); ++tickerId)
+    {
+        tickerMap[tickerId].insert(newTickerRows[tickerId], columns);
+    }
+    tickerDateMap.reserve(tickerDateMap.size() + columns.size() - rowsBefore);
+    for (RowIndex row = static_cast<RowIndex>(rowsBefore); row < columns.size(); ++row)
     {
-        std::stringstream ss(line);
-        StockData record;
-        std::string temp;
+        dateMap[columns.date[row]].rows.push_back(row);
+        tickerDateMap[tickerDateKey(columns.ticker[row], columns.date[row])] = row;
+    }
+    rebuildDateIndexes();
+    resetFieldRankings();
+    resultCache.clear();
+    rollingCache.clear();
 
-        std::getline(ss, record.date, ',');
-        std::getline(ss, record.ticker, ',');
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double megabytes = parsed.bytes / (1024.0 * 1024.0);
+    std::cout << "Loaded " << columns.size() - rowsBefore << " rows (" << megabytes << " MB) in "
+              << elapsed * 1000 << " ms, " << (elapsed > 0 ? megabytes / elapsed : 0) << " MB/s\n";
+    if (!coldSegmentPath.empty())
+    {
+        moveColdPartitions();
+    }
+}
 
-        if (record.date.empty() || record.ticker.empty())
+// Append a parsed chunk to the columns, remapping its local ticker ids. Its
+// partial per-ticker row lists are collected into `newTickerRows` (by global
+// ticker id) so each series is merged once per load.
+void StockDatabase::mergeChunk(const CsvChunk &chunk, std::vector<std::vector<RowIndex>> &newTickerRows)
+{
+    const StockColumns &source = chunk.columns;
+    std::vector<std::uint32_t> remap(source.tickers.size());
+    for (std::uint32_t localId = 0; localId < remap.size(); ++localId)
+    {
+        remap[localId] = columns.tickers.intern(source.tickers.name(localId));
+    }
+    if (columns.tickers.size() > tickerMap.size())
+    {
+        tickerMap.resize(columns.tickers.size());
+    }
+    if (columns.tickers.size() > newTickerRows.size())
+    {
+        newTickerRows.resize(columns.tickers.size());
+    }
+
+    RowIndex offset = static_cast<RowIndex>(columns.size());
+    columns.reserve(columns.size() + source.size());
+    for (size_t i = 0; i < source.size(); ++i)
+    {
+        columns.ticker.push_back(remap[source.ticker[i]]);
+    }
+    columns.date.append(source.date);
+    columns.open.append(source.open);
+    columns.high.append(source.high);
+    columns.low.append(source.low);
+    columns.close.append(source.close);
+    columns.volume.append(source.volume);
+    columns.dividends.append(source.dividends);
+    columns.extendTombstones();
+
+    for (std::uint32_t localId = 0; localId < chunk.tickerRows.size(); ++localId)
+    {
+        std::vector<RowIndex> &rows = newTickerRows[remap[localId]];
+        for (RowIndex row : chunk.tickerRows[localId])
+        {
+            rows.push_back(offset + row);
+        }
+    }
+}
+
+// Rebuild every index from the columns in bulk
+void StockDatabase::rebuildIndexes()
+{
+    std::vector<std::vector<RowIndex>> rowsByTicker(columns.tickers.size());
+    dateMap.clear();
+    tickerDateMap.clear();
+    tickerDateMap.reserve(columns.size());
+    for (RowIndex row = 0; row < columns.size(); ++row)
+    {
+        if (columns.isDeleted(row))
         {
-            std::cerr << "Skipping line with missing Date or Ticker: " << line << std::endl;
             continue;
         }
+        rowsByTicker[columns.ticker[row]].push_back(row);
+        dateMap[columns.date[row]].rows.push_back(row);
+        tickerDateMap[tickerDateKey(columns.ticker[row], columns.date[row])] = row;
+    }
+    tickerMap.assign(columns.tickers.size(), TickerSeries());
+    for (std::uint32_t tickerId = 0; tickerId < rowsByTicker.size(); ++tickerId)
+    {
+        tickerMap[tickerId].insert(rowsByTicker[tickerId], columns);
+    }
+    rebuildDateIndexes();
+    resetFieldRankings();
+    resultCache.clear();
+    rollingCache.clear();
+}
+
+// Recompute every bucket's maximum close and volume ranking, then the
+// threshold index, the date partitions and the dividend bitmap. A bucket's
+// rows are scattered over the columns, so closes and volumes are read
+// through ColumnReader, decoded once when compressed.
+void StockDatabase::rebuildDateIndexes()
+{
+    ColumnReader<double> closes(columns.close);
+    ColumnReader<double> volumes(columns.volume);
+    ReaderComparator<std::greater<double>> byVolumeDescending{&volumes};
+    std::vector<double> maxima;
+    maxima.reserve(dateMap.size());
+    datePartitions.clear();
+    for (auto &entry : dateMap)
+    {
+        DateBucket &bucket = entry.second;
+        bucket.maxClose = -std::numeric_limits<double>::infinity();
+        datePartitions.addDay(entry.first);
+        for (RowIndex row : bucket.rows)
+        {
+            bucket.maxClose = std::max(bucket.maxClose, closes[row]);
+        }
+        bucket.byVolume = bucket.rows;
+        std::sort(bucket.byVolume.begin(), bucket.byVolume.end(), byVolumeDescending);
+        maxima.push_back(bucket.maxClose);
+    }
+    dateMaxCloses.assign(std::move(maxima));
+    datePartitions.addRows(columns);
+    datePartitions.setColdRows(columns);
+    dividendRows = RowBitmap();
+    indexDividendRows(0);
+}
+
+// Extend the dividend bitmap over the rows from `firstRow` on
+void StockDatabase::indexDividendRows(RowIndex firstRow)
+{
+    dividendRows.resize(columns.size());
+    columns.dividends.forEachBlock(firstRow, columns.size(), [this](const double *values, size_t n, size_t row)
+                                   {
+                                       for (size_t i = 0; i < n; ++i)
+                                       {
+                                           if (values[i] > 0)
+                                           {
+                                               dividendRows.set(row + i);
+                                           }
+                                       } });
+}
 
-        // Parse
-        bool isValid = true;
-        std::vector<std::string> fields = {"Open", "High", "Low", "Close", "Volume", "Dividends"};
-        std::vector<double *> values = {&record.open, &record.high, &record.low, &record.close, &record.volume, &record.dividends};
+bool StockDatabase::insertRecord(const StockData &record)
+{
+    OperationTimer timer(Operation::AddStockRecord);
+    DayNumber day;
+    if (!parseDate(record.date, day))
+    {
+        return false;
+    }
+    RowIndex row = columns.append(columns.tickers.intern(record.ticker), day, record);
+    indexRow(row);
+    invalidateResults({row});
+    rollingCache.update(columns.ticker[row], tickerMap[columns.ticker[row]], columns);
+    return true;
+}
+
+void StockDatabase::indexRow(RowIndex row)
+{
+    std::uint32_t tickerId = columns.ticker[row];
+    if (tickerId >= tickerMap.size())
+    {
+        tickerMap.resize(tickerId + 1);
+    }
+    tickerMap[tickerId].insert(row, columns);
+
+    DateBucket &bucket = dateMap[columns.date[row]];
+    bucket.rows.push_back(row);
+    double oldMax = bucket.maxClose;
+    bucket.maxClose = std::max(oldMax, columns.close[row]);
+    if (bucket.rows.size() == 1)
+    {
+        dateMaxCloses.add(bucket.maxClose);
+        datePartitions.addDay(columns.date[row]);
+    }
+    else if (bucket.maxClose != oldMax)
+    {
+        dateMaxCloses.replace(oldMax, bucket.maxClose);
+    }
+    datePartitions.addRow(columns, row);
+    indexDividendRows(row);
+    FieldComparator<StockField::Volume, std::greater<double>> byVolumeDescending{&columns};
+    bucket.byVolume.insert(std::upper_bound(bucket.byVolume.begin(), bucket.byVolume.end(), row, byVolumeDescending), row);
+
+    tickerDateMap[tickerDateKey(tickerId, columns.date[row])] = row;
+    std::apply([this, row](auto &...ranking)
+               { (ranking.insert(row, columns), ...); },
+               fieldRankings);
+}
+
+// Translate a ticker argument to its series; nullptr when the ticker has no rows
+const TickerSeries *StockDatabase::findSeries(std::string_view ticker) const
+{
+    std::uint32_t tickerId = columns.tickers.find(ticker);
+    if (tickerId == TickerDictionary::npos || tickerId >= tickerMap.size() || tickerMap[tickerId].empty())
+    {
+        addCount(Counter::IndexMisses);
+        return nullptr;
+    }
+    addCount(Counter::IndexHits);
+    return &tickerMap[tickerId];
+}
 
-        for (size_t i = 0; i < fields.size(); ++i)
+// Translate (ticker, date) arguments to a single row; nullptr when there is no
+// such record. Cold rows are not in the hash map; they are found by a binary
+// search of the ticker's series, where the last row of a date is the newest.
+const RowIndex *StockDatabase::findRow(std::string_view ticker, std::string_view date) const
+{
+    std::uint32_t tickerId = columns.tickers.find(ticker);
+    DayNumber day;
+    if (tickerId == TickerDictionary::npos || !parseDate(date, day))
+    {
+        addCount(Counter::IndexMisses);
+        return nullptr;
+    }
+    auto it = tickerDateMap.find(tickerDateKey(tickerId, day));
+    if (it != tickerDateMap.end())
+    {
+        addCount(Counter::IndexHits);
+        return &it->second;
+    }
+    if (columns.coldRows() > 0 && tickerId < tickerMap.size())
+    {
+        const TickerSeries &series = tickerMap[tickerId];
+        std::pair<size_t, size_t> range = series.findRange(day, day);
+        if (range.first < range.second)
         {
-            std::getline(ss, temp, ',');
-            if (temp.empty())
-            {
-                std::cerr << "Skipping line with empty " << fields[i] << " field: " << line << std::endl;
-                isValid = false;
-                break;
-            }
-            try
-            {
-                *values[i] = std::stod(temp);
-            }
-            catch (const std::invalid_argument &e)
-            {
-                std::cerr << "Skipping line with invalid " << fields[i] << " value: " << line << " - " << e.what() << std::endl;
-                isValid = false;
-                break;
-            }
+            addCount(Counter::IndexHits);
+            return &series.rowIndices()[range.second - 1];
         }
+    }
+    addCount(Counter::IndexMisses);
+    return nullptr;
+}
 
-        if (!isValid)
+// Drop the cached results that depend on `rows` (all of one ticker)
+void StockDatabase::invalidateResults(const std::vector<RowIndex> &rows)
+{
+    if (rows.empty())
+    {
+        return;
+    }
+    std::vector<DayNumber> days;
+    days.reserve(rows.size());
+    for (RowIndex row : rows)
+    {
+        days.push_back(columns.date[row]);
+    }
+    std::sort(days.begin(), days.end());
+    days.erase(std::unique(days.begin(), days.end()), days.end());
+    resultCache.invalidate(columns.ticker[rows.front()], days);
+}
+
+// Rankings are rebuilt lazily on the next topK/bottomK call
+void StockDatabase::resetFieldRankings()
+{
+    std::apply([](auto &...ranking)
+               { (ranking.reset(), ...); },
+               fieldRankings);
+}
+
+template <StockField F>
+std::vector<RowIndex> StockDatabase::rankRows(size_t k, bool distinctTicker, bool highest) const
+{
+    FieldRanking<F> &ranking = std::get<static_cast<size_t>(F)>(fieldRankings);
+    {
+        std::lock_guard<std::mutex> lock(rankingMutex.mutex);
+        if (!ranking.isBuilt())
         {
-            continue;
+            ranking.build(columns, tickerMap);
+            addCount(Counter::Scans);
+            addCount(Counter::RowsScanned, columns.size());
         }
+    }
+    addCount(Counter::IndexHits);
+    addCount(Counter::Allocations);
+    return highest ? ranking.highest(k, distinctTicker) : ranking.lowest(k, distinctTicker);
+}
 
-        data.push_back(record);
-        tickerMap[record.ticker].push_back(record);
-        dateMap[record.date].push_back(record);
-        tickerDateMap[record.ticker][record.date] = record;
+std::vector<RowIndex> StockDatabase::rankRows(StockField field, size_t k, bool distinctTicker, bool highest) const
+{
+    switch (field)
+    {
+    case StockField::Open:
+        return rankRows<StockField::Open>(k, distinctTicker, highest);
+    case StockField::High:
+        return rankRows<StockField::High>(k, distinctTicker, highest);
+    case StockField::Low:
+        return rankRows<StockField::Low>(k, distinctTicker, highest);
+    case StockField::Close:
+        return rankRows<StockField::Close>(k, distinctTicker, highest);
+    case StockField::Volume:
+        return rankRows<StockField::Volume>(k, distinctTicker, highest);
+    case StockField::Dividends:
+        return rankRows<StockField::Dividends>(k, distinctTicker, highest);
     }
+    return {};
 }
 
 void StockDatabase::addStockRecord(const StockData &record)
 {
-    data.push_back(record);
-
-    tickerMap[record.ticker].push_back(record);
-    dateMap[record.date].push_back(record);
-    tickerDateMap[record.ticker][record.date] = record;
+    if (!insertRecord(record))
+    {
+        std::cout << "Invalid date " << record.date << ", record not added.\n";
+        return;
+    }
 
     std::cout << "Added stock data for " << record.ticker << " on " << record.date << "\n";
 }
 
+// Append a batch of records in one pass and index them once (see indexAppendedRows).
+// With `report` a one-line summary is printed instead of a line per record.
+size_t StockDatabase::addStockRecords(const StockData *records, size_t count, bool report)
+{
+    OperationTimer timer(Operation::AddStockRecords);
+    RowIndex firstRow = static_cast<RowIndex>(columns.size());
+    columns.reserve(columns.size() + count);
+    std::vector<std::vector<RowIndex>> newTickerRows;
+    size_t rejected = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        DayNumber day;
+        if (!parseDate(records[i].date, day))
+        {
+            ++rejected;
+            continue;
+        }
+        std::uint32_t tickerId = columns.tickers.intern(records[i].ticker);
+        if (tickerId >= newTickerRows.size())
+        {
+            newTickerRows.resize(tickerId + 1);
+        }
+        newTickerRows[tickerId].push_back(columns.append(tickerId, day, records[i]));
+    }
+    size_t added = columns.size() - firstRow;
+    size_t touchedTickers = indexAppendedRows(firstRow, newTickerRows);
+
+    if (report)
+    {
+        std::cout << "Added " << added << " records for " << touchedTickers << " tickers";
+        if (rejected > 0)
+        {
+            std::cout << ", skipped " << rejected << " with an invalid date";
+        }
+        std::cout << "\n";
+    }
+    return added;
+}
+
+// Append parsed CSV chunks (e.g. lines newly written to a followed file) and
+// index them once, like addStockRecords
+size_t StockDatabase::ingestChunks(const std::vector<CsvChunk> &chunks)
+{
+    OperationTimer timer(Operation::IngestChunks);
+    RowIndex firstRow = static_cast<RowIndex>(columns.size());
+    std::vector<std::vector<RowIndex>> newTickerRows;
+    for (const CsvChunk &chunk : chunks)
+    {
+        std::cerr << chunk.errors;
+        mergeChunk(chunk, newTickerRows);
+    }
+    indexAppendedRows(firstRow, newTickerRows);
+    return columns.size() - firstRow;
+}
+
+void StockDatabase::clear()
+{
+    columns = StockColumns();
+    tickerMap.clear();
+    dateMap.clear();
+    tickerDateMap.clear();
+    rebuildDateIndexes();
+    resetFieldRankings();
+    resultCache.clear();
+    rollingCache.clear();
+}
+
+// Bring every index up to date with the rows appended from `firstRow` on
+// (`newTickerRows` lists them by ticker id): each touched series is merged once,
+// each touched date bucket re-ranked once, and the threshold index and field
+// rankings are updated (or rebuilt) once. Returns the number of touched tickers.
+size_t StockDatabase::indexAppendedRows(RowIndex firstRow, const std::vector<std::vector<RowIndex>> &newTickerRows)
+{
+    size_t added = columns.size() - firstRow;
+    if (tickerMap.size() < columns.tickers.size())
+    {
+        tickerMap.resize(columns.tickers.size());
+    }
+    size_t touchedTickers = 0;
+    for (std::uint32_t tickerId = 0; tickerId < newTickerRows.size(); ++tickerId)
+    {
+        if (!newTickerRows[tickerId].empty())
+        {
+            tickerMap[tickerId].insert(newTickerRows[tickerId], columns);
+            invalidateResults(newTickerRows[tickerId]);
+            rollingCache.update(tickerId, tickerMap[tickerId], columns);
+            ++touchedTickers;
+        }
+    }
+
+    // New rows go to the end of their buckets; collect them per date first
+    std::unordered_map<DayNumber, std::vector<RowIndex>> newDateRows;
+    tickerDateMap.reserve(tickerDateMap.size() + added);
+    for (RowIndex row = firstRow; row < columns.size(); ++row)
+    {
+        newDateRows[columns.date[row]].push_back(row);
+        tickerDateMap[tickerDateKey(columns.ticker[row], columns.date[row])] = row;
+    }
+
+    // Few touched dates: adjust their maxima in place; many: re-sort all maxima once
+    bool rebuildMaxima = newDateRows.size() * 8 > dateMap.size();
+    FieldComparator<StockField::Volume, std::greater<double>> byVolumeDescending{&columns};
+    for (auto &entry : newDateRows)
+    {
+        DateBucket &bucket = dateMap[entry.first];
+        std::vector<RowIndex> &rows = entry.second;
+        bool isNew = bucket.rows.empty();
+        double oldMax = bucket.maxClose;
+        if (isNew)
+        {
+            datePartitions.addDay(entry.first);
+        }
+        for (RowIndex row : rows)
+        {
+            bucket.maxClose = std::max(bucket.maxClose, columns.close[row]);
+            datePartitions.addRow(columns, row);
+        }
+        bucket.rows.insert(bucket.rows.end(), rows.begin(), rows.end());
+        std::sort(rows.begin(), rows.end(), byVolumeDescending);
+        size_t ranked = bucket.byVolume.size();
+        bucket.byVolume.insert(bucket.byVolume.end(), rows.begin(), rows.end());
+        std::inplace_merge(bucket.byVolume.begin(), bucket.byVolume.begin() + ranked, bucket.byVolume.end(), byVolumeDescending);
+
+        if (rebuildMaxima)
+        {
+            continue;
+        }
+        if (isNew)
+        {
+            dateMaxCloses.add(bucket.maxClose);
+        }
+        else if (bucket.maxClose != oldMax)
+        {
+            dateMaxCloses.replace(oldMax, bucket.maxClose);
+        }
+    }
+    if (rebuildMaxima)
+    {
+        std::vector<double> maxima;
+        maxima.reserve(dateMap.size());
+        for (const auto &entry : dateMap)
+        {
+            maxima.push_back(entry.second.maxClose);
+        }
+        dateMaxCloses.assign(std::move(maxima));
+    }
+    indexDividendRows(firstRow);
+
+    // Built rankings take small batches row by row; a large batch drops them for a lazy rebuild
+    if (added * 8 > columns.size())
+    {
+        resetFieldRankings();
+    }
+    else
+    {
+        for (RowIndex row = firstRow; row < columns.size(); ++row)
+        {
+            std::apply([this, row](auto &...ranking)
+                       { (ranking.insert(row, columns), ...); },
+                       fieldRankings);
+        }
+    }
+
+    return touchedTickers;
+}
+
+size_t StockDatabase::addStockRecords(const std::vector<StockData> &records, bool report)
+{
+    return addStockRecords(records.data(), records.size(), report);
+}
+
 // Erase ticker
 void StockDatabase::deleteTicker(const std::string &ticker)
 {
-    if (tickerMap.find(ticker) == tickerMap.end())
+    if (!eraseTicker(ticker))
     {
         std::cout << "Ticker " << ticker << " not found.\n";
         return;
     }
 
-    data.erase(std::remove_if(data.begin(), data.end(),
-                              [&ticker](const StockData &record)
-                              { return record.ticker == ticker; }),
-               data.end());
+    std::cout << "Deleted all records for ticker: " << ticker << "\n";
+}
 
-    tickerMap.erase(ticker);
+bool StockDatabase::eraseTicker(std::string_view ticker)
+{
+    OperationTimer timer(Operation::DeleteTicker);
+    if (findSeries(ticker) == nullptr)
+    {
+        return false;
+    }
 
-    for (auto &entry : dateMap)
+    // Only the ticker's own rows and the buckets of their dates are touched;
+    // the rows stay in the columns as tombstones until the next compaction
+    std::uint32_t tickerId = columns.tickers.find(ticker);
+    std::vector<RowIndex> rows = tickerMap[tickerId].rowIndices();
+    invalidateResults(rows);
+    rollingCache.erase(tickerId);
+    for (RowIndex row : rows)
     {
-        entry.second.erase(std::remove_if(entry.second.begin(), entry.second.end(),
-                                          [&ticker](const StockData &record)
-                                          { return record.ticker == ticker; }),
-                           entry.second.end());
+        DayNumber day = columns.date[row];
+        tickerDateMap.erase(tickerDateKey(tickerId, day));
+
+        // Bucket rows are in ascending row order, byVolume in ranking order;
+        // the row is looked up there by number, as a binary search would read
+        // (and, when compressed, decode) the volumes around it
+        DateBucket &bucket = dateMap[day];
+        bucket.rows.erase(std::lower_bound(bucket.rows.begin(), bucket.rows.end(), row));
+        bucket.byVolume.erase(std::find(bucket.byVolume.begin(), bucket.byVolume.end(), row));
+        datePartitions.removeRow(columns, row);
+        if (bucket.rows.empty())
+        {
+            dateMaxCloses.remove(bucket.maxClose);
+            dateMap.erase(day);
+            datePartitions.removeDay(day);
+        }
+        else if (columns.close[row] == bucket.maxClose)
+        {
+            double oldMax = bucket.maxClose;
+            bucket.maxClose = -std::numeric_limits<double>::infinity();
+            for (RowIndex other : bucket.rows)
+            {
+                bucket.maxClose = std::max(bucket.maxClose, columns.close[other]);
+            }
+            dateMaxCloses.replace(oldMax, bucket.maxClose);
+        }
+        columns.markDeleted(row);
     }
+    std::apply([&](auto &...ranking)
+               { (ranking.eraseTicker(tickerId, rows, columns), ...); },
+               fieldRankings);
+    tickerMap[tickerId].clear();
 
-    // Remove from tickerDateMap
-    tickerDateMap.erase(ticker);
+    // With cold storage deleted cold rows stay in their segment, so only the
+    // in-memory ones count; otherwise compaction reclaims (e.g. snapshot) rows too
+    size_t reclaimable = coldSegmentPath.empty() ? columns.deletedRows : columns.deletedRows - columns.coldDeletedRows;
+    if (reclaimable > compactionRatio * columns.size())
+    {
+        compact();
+    }
+    return true;
+}
 
-    std::cout << "Deleted all records for ticker: " << ticker << "\n";
+// Reclaim the space of deleted rows and rebuild the indexes over the survivors.
+// With cold storage only the in-memory rows are compacted (and the months that
+// aged out are frozen); deleted cold rows stay in their segment, marked deleted.
+void StockDatabase::compact()
+{
+    OperationTimer timer(Operation::Compact);
+    if (columns.deletedRows == 0)
+    {
+        return;
+    }
+    if (!coldSegmentPath.empty())
+    {
+        moveColdPartitions();
+        return;
+    }
+    columns.compact();
+    rebuildIndexes();
 }
 
-// Query 1:
-std::vector<StockData> StockDatabase::getDataByDate(const std::string &date)
+void StockDatabase::setCompactionRatio(double ratio)
 {
-    return dateMap[date];
+    compactionRatio = ratio;
 }
-// Query 2:
-double StockDatabase::getAverageClosePrice(const std::string &ticker)
+
+size_t StockDatabase::freezeColdPartitions(const std::string &filename, int months, bool compress)
+{
+    OperationTimer timer(Operation::FreezeColdPartitions);
+    coldSegmentPath = filename;
+    hotMonths = std::max(months, 0);
+    compressCold = compress;
+    moveColdPartitions();
+    return columns.coldRows();
+}
+
+// Reorder the in-memory rows as those of the months before the newest
+// `hotMonths`, grouped by month so each partition's rows in the new segment
+// are contiguous, followed by the newer rows, dropping deleted rows. The
+// indexes are renumbered rather than rebuilt; then the leading in-memory rows
+// move to a new segment, keeping their positions. The rows already cold are
+// neither read nor rewritten. Segment pages are released again, so cold rows
+// cost no resident memory until a query touches them.
+bool StockDatabase::moveColdPartitions()
 {
-    double sum = 0;
-    int count = 0;
-    for (const auto &record : tickerMap[ticker])
+    DayNumber cutoff = std::numeric_limits<DayNumber>::min();
+    if (datePartitions.size() > 0)
     {
-        sum += record.close;
-        count++;
+        cutoff = firstDayOfMonth(datePartitions[datePartitions.size() - 1].month - hotMonths + 1);
     }
-    return (count == 0) ? 0 : sum / count;
+    std::vector<std::pair<int, RowIndex>> coldByMonth;
+    std::vector<RowIndex> hotRows;
+    const std::vector<DayNumber> &days = columns.date.hotValues();
+    RowIndex firstHot = static_cast<RowIndex>(columns.coldRows());
+    for (RowIndex row = firstHot; row < columns.size(); ++row)
+    {
+        if (columns.isDeleted(row))
+        {
+            continue;
+        }
+        if (days[row - firstHot] < cutoff)
+        {
+            coldByMonth.push_back({monthOf(days[row - firstHot]), row});
+        }
+        else
+        {
+            hotRows.push_back(row);
+        }
+    }
+    std::stable_sort(coldByMonth.begin(), coldByMonth.end(),
+                     [](const std::pair<int, RowIndex> &a, const std::pair<int, RowIndex> &b)
+                     { return a.first < b.first; });
+    std::vector<RowIndex> order;
+    order.reserve(coldByMonth.size() + hotRows.size());
+    for (const auto &entry : coldByMonth)
+    {
+        order.push_back(entry.second);
+    }
+    order.insert(order.end(), hotRows.begin(), hotRows.end());
+
+    if (!coldByMonth.empty() || order.size() != columns.size() - firstHot)
+    {
+        renumberHotRows(order);
+    }
+    if (!coldByMonth.empty())
+    {
+        std::string filename = coldSegmentPath;
+        if (!columns.coldSegments.empty())
+        {
+            filename += "." + std::to_string(columns.coldSegments.size());
+        }
+        // The series' tables over the rows going cold go into the segment too
+        RowIndex coldEnd = static_cast<RowIndex>(firstHot + coldByMonth.size());
+        std::vector<double> tables;
+        tables.reserve(4 * coldByMonth.size()); // three running totals per row, the extreme tables well under one more
+        std::vector<size_t> frozenCounts(tickerMap.size());
+        for (size_t tickerId = 0; tickerId < tickerMap.size(); ++tickerId)
+        {
+            frozenCounts[tickerId] = tickerMap[tickerId].frozenTables(coldEnd, tables);
+        }
+        if (!moveToColdSegment(columns, coldByMonth.size(), filename, compressCold, tables))
+        {
+            std::cerr << "Could not write cold segment " << filename << std::endl;
+            return false;
+        }
+        const double *mapped = columns.coldSegments.back()->tables;
+        for (size_t tickerId = 0; tickerId < tickerMap.size(); ++tickerId)
+        {
+            mapped += tickerMap[tickerId].freeze(frozenCounts[tickerId], mapped);
+        }
+        // Lookups of cold rows fall back to their series (see findRow)
+        for (auto it = tickerDateMap.begin(); it != tickerDateMap.end();)
+        {
+            it = it->second < coldEnd ? tickerDateMap.erase(it) : std::next(it);
+        }
+        tickerDateMap.rehash(0);
+        datePartitions.setColdRows(columns);
+    }
+    for (const auto &segment : columns.coldSegments)
+    {
+        segment->file.releasePages();
+    }
+    return true;
 }
-// Query 3:
-double StockDatabase::getHighestPriceInPeriod(const std::string &ticker, const std::string &startDate, const std::string &endDate)
+
+// Apply a new order of the in-memory rows (their old indices, deleted ones
+// left out) to the columns and every index, without reading the cold rows
+void StockDatabase::renumberHotRows(const std::vector<RowIndex> &order)
 {
-    double highest = 0;
-    for (const auto &record : tickerMap[ticker])
+    RowIndex firstHot = static_cast<RowIndex>(columns.coldRows());
+    std::vector<RowIndex> newRows(columns.size() - firstHot, NO_ROW);
+    for (size_t i = 0; i < order.size(); ++i)
     {
-        if (record.date >= startDate && record.date <= endDate)
+        newRows[order[i] - firstHot] = static_cast<RowIndex>(firstHot + i);
+    }
+    auto renumber = [&](RowIndex &row)
+    {
+        if (row >= firstHot)
         {
-            if (record.high > highest)
-            {
-                highest = record.high;
-            }
+            row = newRows[row - firstHot];
+        }
+    };
+
+    // The cold rows' bits stay, the others follow their rows
+    RowBitmap dividends = dividendRows;
+    dividends.resize(firstHot);
+    dividends.resize(firstHot + order.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        if (dividendRows.test(order[i]))
+        {
+            dividends.set(firstHot + i);
         }
     }
-    return highest;
+    dividendRows = std::move(dividends);
+
+    columns.keepHotRows(order);
+    for (TickerSeries &series : tickerMap)
+    {
+        series.renumber(firstHot, newRows);
+    }
+    // A date's in-memory rows all fall in one group of `order`, which keeps
+    // their relative order, after its cold rows, so bucket rows and volume
+    // rankings stay sorted
+    for (auto &entry : dateMap)
+    {
+        std::for_each(entry.second.rows.begin(), entry.second.rows.end(), renumber);
+        std::for_each(entry.second.byVolume.begin(), entry.second.byVolume.end(), renumber);
+    }
+    for (auto &entry : tickerDateMap)
+    {
+        renumber(entry.second);
+    }
+    resetFieldRankings();
+    resultCache.clear();
+    rollingCache.clear();
 }
-// Query 4:
-std::set<std::string> StockDatabase::getAllUniqueTickers()
+
+const DatePartitions &StockDatabase::partitions() const
+{
+    return datePartitions;
+}
+
+namespace
 {
-    std::set<std::string> uniqueTickers;
-    for (const auto &record : data)
+    // Buckets plus one node (the entry and a next pointer) per entry
+    template <typename Map>
+    size_t hashTableBytes(const Map &map)
     {
-        uniqueTickers.insert(record.ticker);
+        return map.bucket_count() * sizeof(void *) + map.size() * (sizeof(typename Map::value_type) + sizeof(void *));
     }
-    return uniqueTickers;
 }
-// Query 7:
-bool StockDatabase::doesTickerExist(const std::string &ticker)
+
+MemoryUsage StockDatabase::memoryUsage() const
 {
-    return tickerMap.find(ticker) != tickerMap.end();
+    MemoryUsage usage;
+    usage.columnBytes = columns.residentBytes();
+    for (const auto &segment : columns.coldSegments)
+    {
+        usage.mappedBytes += segment->file.size();
+    }
+
+    size_t bytes = tickerMap.capacity() * sizeof(TickerSeries);
+    for (const TickerSeries &series : tickerMap)
+    {
+        bytes += series.residentBytes();
+    }
+    bytes += hashTableBytes(dateMap);
+    for (const auto &entry : dateMap)
+    {
+        bytes += (entry.second.rows.capacity() + entry.second.byVolume.capacity()) * sizeof(RowIndex);
+    }
+    bytes += hashTableBytes(tickerDateMap);
+    bytes += dateMaxCloses.size() * sizeof(double);
+    for (size_t i = 0; i < datePartitions.size(); ++i)
+    {
+        const DatePartition &partition = datePartitions[i];
+        bytes += sizeof(DatePartition) + partition.days.capacity() * sizeof(DayNumber) +
+                 partition.coldSpans.capacity() * sizeof(std::pair<RowIndex, RowIndex>);
+    }
+    bytes += dividendRows.wordCount() * sizeof(std::uint64_t);
+    {
+        std::lock_guard<std::mutex> lock(rankingMutex.mutex);
+        std::apply([&bytes](const auto &...ranking)
+                   { ((bytes += ranking.residentBytes()), ...); },
+                   fieldRankings);
+    }
+    usage.indexBytes = bytes;
+    return usage;
 }
-// Query 8:
-int StockDatabase::countDatesAboveThreshold(double threshold)
+
+void StockDatabase::setResultCacheBudget(size_t bytes)
 {
-    int count = 0;
-    for (const auto &entry : dateMap)
+    resultCache.setBudget(bytes);
+}
+
+ResultCache::Stats StockDatabase::resultCacheStats() const
+{
+    return resultCache.stats();
+}
+
+// Answer a per-ticker period query from the cache, or compute it from the
+// ticker's series and the positions of its rows inside the period
+template <typename Compute>
+double StockDatabase::cachedPeriodValue(CachedQuery query, std::string_view ticker, std::string_view startDate,
+                                        std::string_view endDate, Compute compute) const
+{
+    CacheKey key;
+    key.query = query;
+    key.tickerId = columns.tickers.find(ticker);
+    if (key.tickerId == TickerDictionary::npos || !parseDate(startDate, key.startDay) || !parseDate(endDate, key.endDay))
+    {
+        addCount(Counter::IndexMisses);
+        return 0;
+    }
+    CachedResult cached;
+    if (resultCache.find(key, cached))
+    {
+        addCount(Counter::CacheHits);
+        return cached.value;
+    }
+    addCount(Counter::CacheMisses);
+    const TickerSeries *series = findSeries(ticker);
+    // A period outside every partition has no rows of any ticker
+    bool inRange = datePartitions.overlaps(key.startDay, key.endDay);
+    cached.value = series == nullptr || !inRange ? 0 : compute(*series, series->findRange(key.startDay, key.endDay));
+    resultCache.insert(key, cached);
+    return cached.value;
+}
+
+// Query 1:
+RowRange StockDatabase::getDataByDate(std::string_view date) const
+{
+    OperationTimer timer(Operation::GetDataByDate);
+    DayNumber day;
+    if (!parseDate(date, day))
+    {
+        return {};
+    }
+    auto it = datePartitions.mayContain(day) ? dateMap.find(day) : dateMap.end();
+    if (it == dateMap.end())
+    {
+        addCount(Counter::IndexMisses);
+        return {};
+    }
+    addCount(Counter::IndexHits);
+    return RowRange(columns, it->second.rows.data(), it->second.rows.size());
+}
+// Query 2:
+double StockDatabase::getAverageClosePrice(std::string_view ticker) const
+{
+    OperationTimer timer(Operation::GetAverageClosePrice);
+    const TickerSeries *series = findSeries(ticker);
+    if (series == nullptr)
     {
-        for (const auto &record : entry.second)
+        return 0;
+    }
+    return series->sumClose(0, series->size()) / series->size();
+}
+double StockDatabase::getAverageClosePrice(std::string_view ticker, std::string_view startDate, std::string_view endDate) const
+{
+    OperationTimer timer(Operation::GetAverageClosePrice);
+    return cachedPeriodValue(CachedQuery::AverageClosePrice, ticker, startDate, endDate,
+                             [](const TickerSeries &series, std::pair<size_t, size_t> range)
+                             {
+                                 return range.first == range.second ? 0 : series.sumClose(range.first, range.second) / (range.second - range.first);
+                             });
+}
+// Query 3:
+double StockDatabase::getHighestPriceInPeriod(std::string_view ticker, std::string_view startDate, std::string_view endDate) const
+{
+    OperationTimer timer(Operation::GetHighestPriceInPeriod);
+    return cachedPeriodValue(CachedQuery::HighestPrice, ticker, startDate, endDate,
+                             [this](const TickerSeries &series, std::pair<size_t, size_t> range)
+                             { return range.first == range.second ? 0 : series.maxHigh(range.first, range.second, columns); });
+}
+double StockDatabase::getLowestPriceInPeriod(std::string_view ticker, std::string_view startDate, std::string_view endDate) const
+{
+    OperationTimer timer(Operation::GetLowestPriceInPeriod);
+    return cachedPeriodValue(CachedQuery::LowestPrice, ticker, startDate, endDate,
+                             [this](const TickerSeries &series, std::pair<size_t, size_t> range)
+                             { return range.first == range.second ? 0 : series.minLow(range.first, range.second, columns); });
+}
+// Query 4:
+std::vector<std::string_view> StockDatabase::getAllUniqueTickers() const
+{
+    OperationTimer timer(Operation::GetAllUniqueTickers);
+    std::vector<std::string_view> uniqueTickers;
+    for (std::uint32_t tickerId = 0; tickerId < tickerMap.size(); ++tickerId)
+    {
+        if (!tickerMap[tickerId].empty())
         {
-            if (record.close > threshold)
-            {
-                count++;
-                break;
-            }
+            uniqueTickers.push_back(columns.tickers.name(tickerId));
         }
     }
-    return count;
+    std::sort(uniqueTickers.begin(), uniqueTickers.end());
+    addCount(Counter::Scans);
+    addCount(Counter::RowsScanned, tickerMap.size());
+    addCount(Counter::Allocations);
+    return uniqueTickers;
+}
+// Query 7:
+bool StockDatabase::doesTickerExist(std::string_view ticker) const
+{
+    OperationTimer timer(Operation::DoesTickerExist);
+    return findSeries(ticker) != nullptr;
+}
+// Query 8:
+int StockDatabase::countDatesAboveThreshold(double threshold) const
+{
+    OperationTimer timer(Operation::CountDatesAboveThreshold);
+    addCount(Counter::IndexHits);
+    return static_cast<int>(dateMaxCloses.countAbove(threshold));
+}
+// Dates on which no stock closed at or above the threshold
+int StockDatabase::countDatesBelowThreshold(double threshold) const
+{
+    OperationTimer timer(Operation::CountDatesBelowThreshold);
+    addCount(Counter::IndexHits);
+    return static_cast<int>(dateMaxCloses.countBelow(threshold));
+}
+// Dates whose highest close lies in (lower, upper]
+int StockDatabase::countDatesBetweenThresholds(double lower, double upper) const
+{
+    OperationTimer timer(Operation::CountDatesBetweenThresholds);
+    addCount(Counter::IndexHits);
+    return static_cast<int>(dateMaxCloses.countBetween(lower, upper));
 }
 // Query 7:
-double StockDatabase::getClosingPrice(const std::string &ticker, const std::string &date)
+std::optional<double> StockDatabase::getClosingPrice(std::string_view ticker, std::string_view date) const
 {
-    if (tickerDateMap.find(ticker) != tickerDateMap.end() && tickerDateMap[ticker].find(date) != tickerDateMap[ticker].end())
+    OperationTimer timer(Operation::GetClosingPrice);
+    const RowIndex *row = findRow(ticker, date);
+    if (row == nullptr)
     {
-        return tickerDateMap[ticker][date].close;
+        return std::nullopt;
     }
-    return -1;
+    return columns.close[*row];
 }
 // Query 8:
-std::vector<std::pair<std::string, double>> StockDatabase::getDatesAndClosingPrices(const std::string &ticker)
+RowRange StockDatabase::getDatesAndClosingPrices(std::string_view ticker) const
 {
-    std::vector<std::pair<std::string, double>> result;
-    for (const auto &record : tickerMap[ticker])
+    OperationTimer timer(Operation::GetDatesAndClosingPrices);
+    const TickerSeries *series = findSeries(ticker);
+    if (series == nullptr)
     {
-        result.push_back({record.date, record.close});
+        return {};
     }
-    return result;
+    return RowRange(columns, series->rowIndices().data(), series->size());
 }
-// Query 9:
-double StockDatabase::getTotalVolume(const std::string &ticker)
+// Series of a rolling-window metric over the ticker's bars in date order, from
+// the first bar with a full window on. Computed once and extended as bars are appended.
+RollingRange StockDatabase::getRollingSeries(std::string_view ticker, RollingMetric metric, size_t window) const
 {
-    double totalVolume = 0;
-    for (const auto &record : tickerMap[ticker])
+    OperationTimer timer(Operation::GetRollingSeries);
+    const TickerSeries *series = findSeries(ticker);
+    if (series == nullptr || window == 0 || window > RollingCache::MAX_WINDOW)
+    {
+        return {};
+    }
+    bool hit;
+    std::shared_ptr<const RollingSeries> rolling = rollingCache.find(columns.tickers.find(ticker), metric, window, *series, columns, hit);
+    addCount(hit ? Counter::CacheHits : Counter::CacheMisses);
+    if (rolling->data().empty())
     {
-        totalVolume += record.volume;
+        return {};
     }
-    return totalVolume;
+    return RollingRange(columns, series->rowIndices().data(), std::move(rolling));
+}
+// Query 9:
+double StockDatabase::getTotalVolume(std::string_view ticker) const
+{
+    OperationTimer timer(Operation::GetTotalVolume);
+    const TickerSeries *series = findSeries(ticker);
+    return series == nullptr ? 0 : series->sumVolume(0, series->size());
+}
+double StockDatabase::getTotalVolume(std::string_view ticker, std::string_view startDate, std::string_view endDate) const
+{
+    OperationTimer timer(Operation::GetTotalVolume);
+    return cachedPeriodValue(CachedQuery::TotalVolume, ticker, startDate, endDate,
+                             [](const TickerSeries &series, std::pair<size_t, size_t> range)
+                             { return series.sumVolume(range.first, range.second); });
+}
+double StockDatabase::getTotalDividends(std::string_view ticker, std::string_view startDate, std::string_view endDate) const
+{
+    OperationTimer timer(Operation::GetTotalDividends);
+    return cachedPeriodValue(CachedQuery::TotalDividends, ticker, startDate, endDate,
+                             [](const TickerSeries &series, std::pair<size_t, size_t> range)
+                             { return series.sumDividends(range.first, range.second); });
 }
 // Query 10:
-bool StockDatabase::doesDataExist(const std::string &ticker, const std::string &date)
+bool StockDatabase::doesDataExist(std::string_view ticker, std::string_view date) const
 {
-    return tickerDateMap.find(ticker) != tickerDateMap.end() && tickerDateMap[ticker].find(date) != tickerDateMap[ticker].end();
+    OperationTimer timer(Operation::DoesDataExist);
+    return findRow(ticker, date) != nullptr;
 }
 // Query 11:
-std::pair<double, double> StockDatabase::getOpeningAndClosingPrices(const std::string &ticker, const std::string &date)
+std::optional<std::pair<double, double>> StockDatabase::getOpeningAndClosingPrices(std::string_view ticker, std::string_view date) const
 {
-    if (tickerDateMap.find(ticker) != tickerDateMap.end() && tickerDateMap[ticker].find(date) != tickerDateMap[ticker].end())
+    OperationTimer timer(Operation::GetOpeningAndClosingPrices);
+    const RowIndex *row = findRow(ticker, date);
+    if (row == nullptr)
     {
-        return {tickerDateMap[ticker][date].open, tickerDateMap[ticker][date].close};
+        return std::nullopt;
     }
-    return {-1, -1};
+    return std::make_pair(columns.open[*row], columns.close[*row]);
 }
 // Query 12:
-double StockDatabase::getDividend(const std::string &ticker, const std::string &date)
+std::optional<double> StockDatabase::getDividend(std::string_view ticker, std::string_view date) const
 {
-    if (tickerDateMap.find(ticker) != tickerDateMap.end() && tickerDateMap[ticker].find(date) != tickerDateMap[ticker].end())
+    OperationTimer timer(Operation::GetDividend);
+    const RowIndex *row = findRow(ticker, date);
+    if (row == nullptr)
     {
-        return tickerDateMap[ticker][date].dividends;
+        return std::nullopt;
     }
-    return -1;
+    return columns.dividends[*row];
 }
 // Query 13:
-std::vector<StockData> StockDatabase::getTop10StocksByVolume(const std::string &date)
+RowRange StockDatabase::getTop10StocksByVolume(std::string_view date) const
+{
+    OperationTimer timer(Operation::GetTop10StocksByVolume);
+    return getTopStocksOnDate(date, StockField::Volume, 10);
+}
+// The K rows of one date with the largest values of a field, largest first.
+// Volume is a prefix of the bucket's ranking; other fields use a partial sort.
+RowRange StockDatabase::getTopStocksOnDate(std::string_view date, StockField field, size_t k) const
+{
+    OperationTimer timer(Operation::GetTopStocksOnDate);
+    DayNumber day;
+    if (!parseDate(date, day))
+    {
+        return {};
+    }
+    auto it = datePartitions.mayContain(day) ? dateMap.find(day) : dateMap.end();
+    if (it == dateMap.end())
+    {
+        addCount(Counter::IndexMisses);
+        return {};
+    }
+    addCount(Counter::IndexHits);
+    const DateBucket &bucket = it->second;
+    k = std::min(k, bucket.rows.size());
+    if (field == StockField::Volume)
+    {
+        return RowRange(columns, bucket.byVolume.data(), k);
+    }
+
+    CacheKey key;
+    key.query = CachedQuery::TopStocksOnDate;
+    key.field = static_cast<std::uint8_t>(field);
+    key.startDay = key.endDay = day;
+    key.k = k;
+    CachedResult cached;
+    if (resultCache.find(key, cached))
+    {
+        addCount(Counter::CacheHits);
+        return RowRange(columns, std::move(cached.rows));
+    }
+    addCount(Counter::CacheMisses);
+
+    addCount(Counter::Scans);
+    addCount(Counter::RowsScanned, bucket.rows.size());
+    addCount(Counter::Allocations);
+    std::vector<RowIndex> rows = bucket.rows;
+    const Column<double> &column = fieldColumn(columns, field);
+    auto byFieldDescending = [&column](RowIndex a, RowIndex b)
+    {
+        return column[a] != column[b] ? column[a] > column[b] : a < b;
+    };
+    std::partial_sort(rows.begin(), rows.begin() + k, rows.end(), byFieldDescending);
+    rows.resize(k);
+    cached.rows.assign(rows.begin(), rows.end());
+    resultCache.insert(key, std::move(cached));
+    return RowRange(columns, std::move(rows));
+}
+// Tickers with the largest total volume over [startDate, endDate], largest first.
+// Each ticker's total is one prefix-sum lookup on its series.
+std::vector<std::pair<std::string_view, double>> StockDatabase::getTopTickersByVolume(std::string_view startDate, std::string_view endDate, size_t k) const
 {
-    std::priority_queue<StockData, std::vector<StockData>, VolumeComparator> pq;
-    for (const auto &record : dateMap[date])
+    OperationTimer timer(Operation::GetTopTickersByVolume);
+    std::vector<std::pair<std::string_view, double>> result;
+    DayNumber startDay, endDay;
+    if (!parseDate(startDate, startDay) || !parseDate(endDate, endDay) || !datePartitions.overlaps(startDay, endDay))
     {
-        pq.push(record);
-        if (pq.size() > 10)
+        return result;
+    }
+
+    CacheKey key;
+    key.query = CachedQuery::TopTickersByVolume;
+    key.startDay = startDay;
+    key.endDay = endDay;
+    key.k = k;
+    CachedResult cached;
+    if (resultCache.find(key, cached))
+    {
+        addCount(Counter::CacheHits);
+        for (const auto &total : cached.totals)
+        {
+            result.push_back({columns.tickers.name(total.first), total.second});
+        }
+        return result;
+    }
+    addCount(Counter::CacheMisses);
+
+    std::vector<std::pair<double, std::uint32_t>> totals;
+    for (std::uint32_t tickerId = 0; tickerId < tickerMap.size(); ++tickerId)
+    {
+        const TickerSeries &series = tickerMap[tickerId];
+        auto range = series.findRange(startDay, endDay);
+        if (range.first != range.second)
         {
-            pq.pop();
+            totals.push_back({series.sumVolume(range.first, range.second), tickerId});
         }
     }
-    std::vector<StockData> result;
-    while (!pq.empty())
+    addCount(Counter::Scans);
+    addCount(Counter::RowsScanned, tickerMap.size());
+    addCount(Counter::Allocations, 2);
+    k = std::min(k, totals.size());
+    std::partial_sort(totals.begin(), totals.begin() + k, totals.end(),
+                      [](const std::pair<double, std::uint32_t> &a, const std::pair<double, std::uint32_t> &b)
+                      { return a.first != b.first ? a.first > b.first : a.second < b.second; });
+    for (size_t i = 0; i < k; ++i)
     {
-        result.push_back(pq.top());
-        pq.pop();
+        result.push_back({columns.tickers.name(totals[i].second), totals[i].first});
+        cached.totals.push_back({totals[i].second, totals[i].first});
     }
-    std::reverse(result.begin(), result.end());
+    resultCache.insert(key, std::move(cached));
     return result;
 }
-// Query 14:
-std::vector<StockData> StockDatabase::getBottom5StocksByClosingPrice()
+// One-bar returns of the tickers (all when `tickers` is empty; sorted by name)
+// over the period, aligned on the dates of the period that have any rows. A
+// ticker without a bar on a date keeps its previous close, so its return there
+// is 0, as it is before its first bar. Tickers with fewer than two bars in the
+// period are left out. Each row is demeaned; `names` gets the row tickers.
+ReturnMatrix StockDatabase::buildReturnMatrix(std::string_view startDate, std::string_view endDate,
+                                              const std::vector<std::string_view> &tickers, std::vector<std::string_view> &names) const
 {
-    std::priority_queue<StockData, std::vector<StockData>, ClosePriceComparator> pq;
-    std::unordered_set<std::string> uniqueTickers;
+    ReturnMatrix returns;
+    DayNumber startDay, endDay;
+    if (!parseDate(startDate, startDay) || !parseDate(endDate, endDay))
+    {
+        return returns;
+    }
+    std::vector<DayNumber> axis = datePartitions.daysBetween(startDay, endDay);
+    if (axis.size() < 3)
+    {
+        return returns;
+    }
 
-    for (const auto &record : data)
+    names = tickers;
+    if (names.empty())
+    {
+        for (std::uint32_t tickerId = 0; tickerId < tickerMap.size(); ++tickerId)
+        {
+            names.push_back(columns.tickers.name(tickerId));
+        }
+    }
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+    returns.days = axis.size() - 1;
+    size_t kept = 0;
+    for (std::string_view name : names)
     {
-        if (uniqueTickers.find(record.ticker) == uniqueTickers.end())
+        const TickerSeries *series = findSeries(name);
+        if (series == nullptr)
         {
-            pq.push(record);
-            uniqueTickers.insert(record.ticker);
-            if (pq.size() > 5)
+            continue;
+        }
+        auto range = series->findRange(startDay, endDay);
+        if (range.second - range.first < 2)
+        {
+            continue;
+        }
+        names[kept++] = name;
+        returns.values.resize(kept * returns.days);
+        double *row = returns.values.data() + (kept - 1) * returns.days;
+        const std::vector<RowIndex> &rows = series->rowIndices();
+        size_t position = range.first;
+        double previous = 0;
+        for (size_t k = 0; k < axis.size(); ++k)
+        {
+            double price = previous;
+            for (; position < range.second && series->day(position) == axis[k]; ++position)
+            {
+                price = columns.close[rows[position]];
+            }
+            if (k > 0)
             {
-                uniqueTickers.erase(pq.top().ticker);
-                pq.pop();
+                row[k - 1] = previous != 0 ? price / previous - 1 : 0;
             }
+            previous = price;
         }
+        scanAddToAll(row, returns.days, -scanSum(row, returns.days) / static_cast<double>(returns.days));
     }
-
-    std::vector<StockData> result;
-    while (!pq.empty())
+    names.resize(kept);
+    returns.tickers = kept;
+    addCount(Counter::Scans);
+    addCount(Counter::RowsScanned, kept * returns.days);
+    return returns;
+}
+// Covariance and correlation of every pair of tickers' returns over the
+// period; the products run tile by tile on `threadCount` threads (0 = all cores)
+CorrelationMatrix StockDatabase::getCorrelationMatrix(std::string_view startDate, std::string_view endDate,
+                                                      const std::vector<std::string_view> &tickers, unsigned threadCount) const
+{
+    OperationTimer timer(Operation::GetCorrelationMatrix);
+    std::vector<std::string_view> names;
+    ReturnMatrix returns = buildReturnMatrix(startDate, endDate, tickers, names);
+    addCount(Counter::Allocations, 2);
+    return CorrelationMatrix(std::move(names), covarianceMatrix(returns, threadCount), returns.days);
+}
+// The `n` most correlated pairs of tickers over the period, without building the full matrix
+std::vector<CorrelatedPair> StockDatabase::getTopCorrelatedPairs(std::string_view startDate, std::string_view endDate, size_t n,
+                                                                 const std::vector<std::string_view> &tickers, unsigned threadCount) const
+{
+    OperationTimer timer(Operation::GetTopCorrelatedPairs);
+    std::vector<std::string_view> names;
+    ReturnMatrix returns = buildReturnMatrix(startDate, endDate, tickers, names);
+    std::vector<CorrelatedPair> result;
+    for (const PairScore &pair : topCorrelatedPairs(returns, n, threadCount))
     {
-        result.push_back(pq.top());
-        pq.pop();
+        result.push_back({names[pair.first], names[pair.second], pair.correlation, pair.covariance});
     }
-    std::reverse(result.begin(), result.end());
+    addCount(Counter::Allocations, 2);
     return result;
 }
+// Query 14: the 5 tickers with the lowest close, each represented by its lowest-close row
+RowRange StockDatabase::getBottom5StocksByClosingPrice() const
+{
+    OperationTimer timer(Operation::GetBottom5StocksByClosingPrice);
+    return bottomK(StockField::Close, 5, true);
+}
 // Query 15:
-std::vector<StockData> StockDatabase::getTop5StocksByDividends()
+RowRange StockDatabase::getTop5StocksByDividends() const
 {
-    std::priority_queue<StockData, std::vector<StockData>, DividendsComparator> pq;
-    for (const auto &record : data)
+    OperationTimer timer(Operation::GetTop5StocksByDividends);
+    return topK(StockField::Dividends, 5);
+}
+// Rows with the K largest values of a field, largest first
+RowRange StockDatabase::topK(StockField field, size_t k, bool distinctTicker) const
+{
+    OperationTimer timer(Operation::TopK);
+    return RowRange(columns, rankRows(field, k, distinctTicker, true));
+}
+// Rows with the K smallest values of a field, smallest first
+RowRange StockDatabase::bottomK(StockField field, size_t k, bool distinctTicker) const
+{
+    OperationTimer timer(Operation::BottomK);
+    return RowRange(columns, rankRows(field, k, distinctTicker, false));
+}
+namespace
+{
+    constexpr size_t SPARSE_RATIO = 32;   // fewer selected rows than 1 in this many are read one by one
+    constexpr size_t SCAN_WINDOW = 4096;  // rows per kernel call; windows without selected rows are skipped
+}
+
+// The live rows that meet every condition of `filter`. Candidates come from
+// the narrowest index at hand (the ticker's series, the date index for a short
+// period, else every live row less the cold spans of partitions the zone maps
+// rule out); the value ranges are then tested row by row when few candidates
+// are left, or scanned a window at a time with the mask kernel.
+RowBitmap StockDatabase::selectRows(const RowFilter &filter) const
+{
+    size_t rowCount = columns.size();
+    RowBitmap selected(rowCount);
+    if (filter.excludesAll())
+    {
+        return selected;
+    }
+    auto range = datePartitions.overlapping(filter.firstDay, filter.lastDay);
+    std::vector<bool> matching(datePartitions.size(), false);
+    size_t estimate = 0;
+    for (size_t i = range.first; i < range.second; ++i)
+    {
+        matching[i] = filter.mayMatch(datePartitions[i]);
+        estimate += matching[i] ? datePartitions[i].rows : 0;
+    }
+    if (estimate == 0)
+    {
+        addCount(Counter::IndexHits);
+        return selected;
+    }
+
+    if (!filter.ticker.empty())
     {
-        pq.push(record);
-        if (pq.size() > 5)
+        const TickerSeries *series = findSeries(filter.ticker);
+        if (series == nullptr)
         {
-            pq.pop();
+            return selected;
+        }
+        auto rows = series->findRange(filter.firstDay, filter.lastDay);
+        for (size_t position = rows.first; position < rows.second; ++position)
+        {
+            selected.set(series->rowIndices()[position]);
         }
     }
-    std::vector<StockData> result;
-    while (!pq.empty())
+    else if (estimate * 4 < rowCount - columns.deletedRows)
     {
-        result.push_back(pq.top());
-        pq.pop();
+        addCount(Counter::IndexHits);
+        for (size_t i = range.first; i < range.second; ++i)
+        {
+            if (!matching[i])
+            {
+                continue;
+            }
+            const std::vector<DayNumber> &days = datePartitions[i].days;
+            for (auto day = std::lower_bound(days.begin(), days.end(), filter.firstDay);
+                 day != days.end() && *day <= filter.lastDay; ++day)
+            {
+                for (RowIndex row : dateMap.at(*day).rows)
+                {
+                    selected.set(row);
+                }
+            }
+        }
     }
-    std::reverse(result.begin(), result.end());
-    return result;
-}
\ No newline at end of file
+    else
+    {
+        selected.setRange(0, rowCount);
+        selected.clearMasked(columns.tombstones);
+        for (size_t i = 0; i < datePartitions.size(); ++i)
+        {
+            if (matching[i])
+            {
+                continue;
+            }
+            for (const auto &span : datePartitions[i].coldSpans)
+            {
+                selected.clearRange(span.first, span.second);
+            }
+        }
+        if (filter.restrictsDates())
+        {
+            for (size_t first = 0; first < rowCount; first += SCAN_WINDOW)
+            {
+                size_t last = std::min(rowCount, first + SCAN_WINDOW);
+                if (selected.noneIn(first, last))
+                {
+                    continue;
+                }
+                columns.date.forEachBlock(first, last, [&selected, &filter](const DayNumber *days, size_t n, size_t row)
+                                          {
+                                              for (size_t j = 0; j < n; ++j)
+                                              {
+                                                  if (days[j] < filter.firstDay || days[j] > filter.lastDay)
+                                                  {
+                                                      selected.reset(row + j);
+                                                  }
+                                              } });
+            }
+        }
+    }
+    if (filter.paysDividend)
+    {
+        selected &= dividendRows;
+        addCount(Counter::IndexHits);
+    }
+    if (filter.ranges.empty())
+    {
+        return selected;
+    }
+
+    addCount(Counter::Scans);
+    if (selected.count() * SPARSE_RATIO < rowCount)
+    {
+        selected.forEach([this, &selected, &filter](size_t row)
+                         {
+                             addCount(Counter::RowsScanned);
+                             for (const FieldRange &condition : filter.ranges)
+                             {
+                                 if (!condition.contains(fieldColumn(columns, condition.field)[row]))
+                                 {
+                                     selected.reset(row);
+                                     return;
+                                 }
+                             } });
+        return selected;
+    }
+    std::uint64_t bits[SCAN_WINDOW / 64];
+    for (const FieldRange &condition : filter.ranges)
+    {
+        const Column<double> &column = fieldColumn(columns, condition.field);
+        for (size_t first = 0; first < rowCount; first += SCAN_WINDOW)
+        {
+            size_t last = std::min(rowCount, first + SCAN_WINDOW);
+            if (selected.noneIn(first, last))
+            {
+                continue;
+            }
+            addCount(Counter::RowsScanned, last - first);
+            column.forEachBlock(first, last, [&selected, &condition, &bits](const double *values, size_t n, size_t row)
+                                {
+                                    scanMaskBetween(values, n, condition.lower, condition.upper, bits);
+                                    selected.andBits(row, bits, n); });
+        }
+    }
+    return selected;
+}
+
+// Call visit(row, value) for each selected row in ascending order, with the
+// value of `field`; dense selections read the column a window at a time
+template <typename Visit>
+void StockDatabase::visitSelected(const RowBitmap &selected, StockField field, Visit visit) const
+{
+    const Column<double> &column = fieldColumn(columns, field);
+    size_t rowCount = selected.size();
+    if (selected.count() * SPARSE_RATIO < rowCount)
+    {
+        selected.forEach([&column, &visit](size_t row)
+                         { visit(static_cast<RowIndex>(row), column[row]); });
+        return;
+    }
+    for (size_t first = 0; first < rowCount; first += SCAN_WINDOW)
+    {
+        size_t last = std::min(rowCount, first + SCAN_WINDOW);
+        if (selected.noneIn(first, last))
+        {
+            continue;
+        }
+        column.forEachBlock(first, last, [&selected, &visit](const double *values, size_t n, size_t row)
+                            {
+                                for (size_t j = 0; j < n; ++j)
+                                {
+                                    if (selected.test(row + j))
+                                    {
+                                        visit(static_cast<RowIndex>(row + j), values[j]);
+                                    }
+                                } });
+    }
+}
+
+RowBitmap StockDatabase::filterRows(const RowFilter &filter) const
+{
+    OperationTimer timer(Operation::FilterRows);
+    return selectRows(filter);
+}
+
+size_t StockDatabase::countRows(const RowFilter &filter) const
+{
+    OperationTimer timer(Operation::FilterRows);
+    return selectRows(filter).count();
+}
+
+// A period alone is answered by the partitions' date lists and "close above a
+// threshold" (query 6) by the index of each date's highest close
+size_t StockDatabase::countDates(const RowFilter &filter) const
+{
+    OperationTimer timer(Operation::CountFilteredDates);
+    if (filter.excludesAll())
+    {
+        return 0;
+    }
+    if (filter.useIndexShortcuts && filter.ticker.empty() && !filter.paysDividend)
+    {
+        if (filter.ranges.empty())
+        {
+            addCount(Counter::IndexHits);
+            return datePartitions.daysBetween(filter.firstDay, filter.lastDay).size();
+        }
+        const FieldRange *close = filter.range(StockField::Close);
+        if (!filter.restrictsDates() && filter.ranges.size() == 1 && close != nullptr &&
+            close->upper == std::numeric_limits<double>::infinity())
+        {
+            addCount(Counter::IndexHits);
+            return dateMaxCloses.countAbove(close->lower);
+        }
+    }
+
+    RowBitmap selected = selectRows(filter);
+    if (datePartitions.size() == 0)
+    {
+        return 0;
+    }
+    DayNumber firstDay = datePartitions[0].firstDay();
+    std::vector<bool> seen(datePartitions[datePartitions.size() - 1].lastDay() - firstDay + 1, false);
+    size_t dates = 0;
+    selected.forEach([this, &seen, &dates, firstDay](size_t row)
+                     {
+                         size_t offset = static_cast<size_t>(columns.date[row] - firstDay);
+                         if (!seen[offset])
+                         {
+                             seen[offset] = true;
+                             ++dates;
+                         } });
+    return dates;
+}
+
+FilterAggregate StockDatabase::aggregateRows(const RowFilter &filter, StockField field) const
+{
+    OperationTimer timer(Operation::AggregateRows);
+    FilterAggregate aggregate;
+    visitSelected(selectRows(filter), field, [&aggregate](RowIndex, double value)
+                  {
+                      ++aggregate.count;
+                      aggregate.sum += value;
+                      aggregate.minimum = std::min(aggregate.minimum, value);
+                      aggregate.maximum = std::max(aggregate.maximum, value); });
+    return aggregate;
+}
+
+// Ties go to the higher row when highest and to the lower row otherwise, as in
+// topK and bottomK, and NaN values are never ranked. Without conditions the
+// field ranking answers (queries 14 and 15); for one date and volume the
+// date's volume ranking is walked only until no later row can enter the
+// result (query 13). RowFilter::useIndexShortcuts = false forces the scan.
+RowRange StockDatabase::topRows(const RowFilter &filter, StockField field, size_t k, bool highest, bool distinctTicker) const
+{
+    OperationTimer timer(Operation::TopRows);
+    if (k == 0 || filter.excludesAll())
+    {
+        return {};
+    }
+    if (filter.useIndexShortcuts && filter.isEmpty())
+    {
+        return RowRange(columns, rankRows(field, k, distinctTicker, highest));
+    }
+
+    auto before = [highest](const std::pair<double, RowIndex> &a, const std::pair<double, RowIndex> &b)
+    {
+        if (a.first != b.first)
+        {
+            return highest ? a.first > b.first : a.first < b.first;
+        }
+        return highest ? a.second > b.second : a.second < b.second;
+    };
+    // One candidate per row, or per ticker (its best row) when distinctTicker
+    std::vector<std::pair<double, RowIndex>> candidates;
+    std::vector<size_t> tickerSlot(distinctTicker ? columns.tickers.size() : 0, SIZE_MAX);
+    auto offer = [&](RowIndex row, double value)
+    {
+        if (value != value)
+        {
+            return;
+        }
+        if (!distinctTicker)
+        {
+            candidates.push_back({value, row});
+            return;
+        }
+        size_t &slot = tickerSlot[columns.ticker[row]];
+        if (slot == SIZE_MAX)
+        {
+            slot = candidates.size();
+            candidates.push_back({value, row});
+        }
+        else if (before({value, row}, candidates[slot]))
+        {
+            candidates[slot] = {value, row};
+        }
+    };
+
+    if (filter.useIndexShortcuts && field == StockField::Volume && highest && filter.ticker.empty() &&
+        filter.firstDay == filter.lastDay)
+    {
+        auto it = datePartitions.mayContain(filter.firstDay) ? dateMap.find(filter.firstDay) : dateMap.end();
+        if (it == dateMap.end())
+        {
+            return {};
+        }
+        addCount(Counter::IndexHits);
+        // Rows come largest volume first; once K candidates are in, only rows
+        // tying with the K-th can still displace one
+        double cutoff = 0;
+        bool full = false;
+        for (RowIndex row : it->second.byVolume)
+        {
+            double value = columns.volume[row];
+            if (full && value < cutoff)
+            {
+                break;
+            }
+            bool passes = !filter.paysDividend || dividendRows.test(row);
+            for (size_t i = 0; passes && i < filter.ranges.size(); ++i)
+            {
+                passes = filter.ranges[i].contains(fieldColumn(columns, filter.ranges[i].field)[row]);
+            }
+            if (passes)
+            {
+                offer(row, value);
+                if (!full && candidates.size() == k)
+                {
+                    full = true;
+                    cutoff = value;
+                }
+            }
+        }
+    }
+    else
+    {
+        visitSelected(selectRows(filter), field, offer);
+    }
+    addCount(Counter::Allocations);
+    k = std::min(k, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + k, candidates.end(), before);
+    std::vector<RowIndex> rows;
+    rows.reserve(k);
+    for (size_t i = 0; i < k; ++i)
+    {
+        rows.push_back(candidates[i].second);
+    }
+    return RowRange(columns, std::move(rows));
+}
@@ -0,0 +1,224 @@
+#include "TickerSeries.h"
+#include <algorithm>
+
+void TickerSeries::insert(RowIndex row, const StockColumns &columns)
+{
+    DayNumber day = columns.date[row];
+    if (days.empty() || day >= days.back())
+    {
+        rows.push_back(row);
+        days.push_back(day);
+        highs.push_back(columns.high[row]);
+        lows.push_back(columns.low[row]);
+        closeSums.push_back(columns.close[row]);
+        volumeSums.push_back(columns.volume[row]);
+        dividendSums.push_back(columns.dividends[row]);
+        return;
+    }
+
+    size_t pos = std::upper_bound(days.begin(), days.end(), day) - days.begin();
+    if (pos < frozen)
+    {
+        thaw(columns);
+    }
+    rows.insert(rows.begin() + pos, row);
+    days.insert(days.begin() + pos, day);
+    highs.insert(pos, columns.high[row]);
+    lows.insert(pos, columns.low[row]);
+    closeSums.insert(pos, columns.close[row]);
+    volumeSums.insert(pos, columns.volume[row]);
+    dividendSums.insert(pos, columns.dividends[row]);
+}
+
+namespace
+{
+    std::vector<double> valuesAt(const Column<double> &column, const std::vector<RowIndex> &rows)
+    {
+        std::vector<double> values;
+        values.reserve(rows.size());
+        for (RowIndex row : rows)
+        {
+            values.push_back(column[row]);
+        }
+        return values;
+    }
+}
+
+void TickerSeries::insert(const std::vector<RowIndex> &newRows, const StockColumns &columns)
+{
+    if (newRows.empty())
+    {
+        return;
+    }
+
+    std::vector<RowIndex> sorted = newRows;
+    std::stable_sort(sorted.begin(), sorted.end(), [&columns](RowIndex a, RowIndex b)
+                     { return columns.date[a] < columns.date[b]; });
+
+    // Only the batch's values are read, a column at a time, so rows sharing
+    // a compressed block decode it once rather than once per field
+    size_t count = sorted.size();
+    std::vector<DayNumber> newDays(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        newDays[i] = columns.date[sorted[i]];
+    }
+    std::vector<double> highValues = valuesAt(columns.high, sorted);
+    std::vector<double> lowValues = valuesAt(columns.low, sorted);
+    std::vector<double> closeValues = valuesAt(columns.close, sorted);
+    std::vector<double> volumeValues = valuesAt(columns.volume, sorted);
+    std::vector<double> dividendValues = valuesAt(columns.dividends, sorted);
+
+    // The usual case, a batch of newer bars: append each, O(1) apiece
+    if (days.empty() || newDays.front() >= days.back())
+    {
+        rows.insert(rows.end(), sorted.begin(), sorted.end());
+        days.insert(days.end(), newDays.begin(), newDays.end());
+        for (size_t i = 0; i < count; ++i)
+        {
+            highs.push_back(highValues[i]);
+            lows.push_back(lowValues[i]);
+            closeSums.push_back(closeValues[i]);
+            volumeSums.push_back(volumeValues[i]);
+            dividendSums.push_back(dividendValues[i]);
+        }
+        return;
+    }
+
+    // Each new row goes after the rows already on its date, and the series
+    // moves only from the first position on
+    std::vector<size_t> positions(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        positions[i] = std::upper_bound(days.begin(), days.end(), newDays[i]) - days.begin();
+    }
+    if (positions[0] < frozen)
+    {
+        thaw(columns);
+    }
+    mergeInto(rows, positions, sorted);
+    mergeInto(days, positions, newDays);
+    highs.insert(positions, highValues);
+    lows.insert(positions, lowValues);
+    closeSums.insert(positions, closeValues);
+    volumeSums.insert(positions, volumeValues);
+    dividendSums.insert(positions, dividendValues);
+}
+
+void TickerSeries::thaw(const StockColumns &columns)
+{
+    std::vector<double> highValues = valuesAt(columns.high, rows);
+    std::vector<double> lowValues = valuesAt(columns.low, rows);
+    highs.assign(std::move(highValues));
+    lows.assign(std::move(lowValues));
+    closeSums.thaw();
+    volumeSums.thaw();
+    dividendSums.thaw();
+    frozen = 0;
+}
+
+void TickerSeries::clear()
+{
+    *this = TickerSeries();
+}
+
+std::vector<double> TickerSeries::savedTables() const
+{
+    std::vector<double> tables;
+    for (const PrefixSums *sums : {&closeSums, &volumeSums, &dividendSums})
+    {
+        std::vector<double> totals = sums->totals();
+        tables.insert(tables.end(), totals.begin(), totals.end());
+    }
+    highs.saveLevels(tables);
+    lows.saveLevels(tables);
+    return tables;
+}
+
+bool TickerSeries::restore(std::vector<RowIndex> newRows, const StockColumns &columns, const double *tables, size_t count)
+{
+    size_t n = newRows.size();
+    size_t levels = RangeExtremeTable<std::greater<double>>::levelSize(n);
+    if (count != 3 * (n + 1) + 2 * levels)
+    {
+        return false;
+    }
+    rows = std::move(newRows);
+    days.resize(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        days[i] = columns.date[rows[i]];
+    }
+    for (PrefixSums *sums : {&closeSums, &volumeSums, &dividendSums})
+    {
+        sums->restore(tables, n + 1);
+        tables += n + 1;
+    }
+    highs.restore(n, tables, [this, &columns](size_t i)
+                  { return columns.high[rows[i]]; });
+    lows.restore(n, tables + levels, [this, &columns](size_t i)
+                 { return columns.low[rows[i]]; });
+    frozen = n;
+    return true;
+}
+
+size_t TickerSeries::frozenTables(RowIndex coldEnd, std::vector<double> &out) const
+{
+    size_t count = frozen;
+    while (count < rows.size() && rows[count] < coldEnd)
+    {
+        ++count;
+    }
+    if (count == frozen)
+    {
+        return count;
+    }
+    for (const PrefixSums *sums : {&closeSums, &volumeSums, &dividendSums})
+    {
+        sums->frozenTotals(count, out);
+    }
+    highs.frozenLevels(count, out);
+    lows.frozenLevels(count, out);
+    return count;
+}
+
+size_t TickerSeries::freeze(size_t count, const double *mapped)
+{
+    if (count == frozen)
+    {
+        return 0;
+    }
+    const double *next = mapped;
+    for (PrefixSums *sums : {&closeSums, &volumeSums, &dividendSums})
+    {
+        next += sums->freeze(count, next);
+    }
+    next += highs.freeze(count, next);
+    next += lows.freeze(count, next);
+    frozen = count;
+    return static_cast<size_t>(next - mapped);
+}
+
+size_t TickerSeries::residentBytes() const
+{
+    return rows.capacity() * sizeof(RowIndex) + days.capacity() * sizeof(DayNumber) + highs.residentBytes() +
+           lows.residentBytes() + closeSums.residentBytes() + volumeSums.residentBytes() + dividendSums.residentBytes();
+}
+
+void TickerSeries::renumber(RowIndex firstRow, const std::vector<RowIndex> &newRows)
+{
+    for (RowIndex &row : rows)
+    {
+        if (row >= firstRow)
+        {
+            row = newRows[row - firstRow];
+        }
+    }
+}
+
+std::pair<size_t, size_t> TickerSeries::findRange(DayNumber startDay, DayNumber endDay) const
+{
+    size_t first = std::lower_bound(days.begin(), days.end(), startDay) - days.begin();
+    size_t last = std::upper_bound(days.begin(), days.end(), endDay) - days.begin();
+    return {first, std::max(first, last)};
+}
@@ -0,0 +1,110 @@
+#include "WorkStealingPool.h"
+#include <algorithm>
+
+WorkStealingPool::WorkStealingPool(unsigned threadCount)
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned i = 0; i < threadCount; ++i)
+    {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (unsigned i = 0; i < threadCount; ++i)
+    {
+        workers.emplace_back(&WorkStealingPool::run, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+void WorkStealingPool::submit(Task task)
+{
+    Queue &queue = *queues[nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        ++pending;
+        queued.fetch_add(1);
+    }
+    wake.notify_one();
+}
+
+void WorkStealingPool::wait()
+{
+    std::unique_lock<std::mutex> lock(stateMutex);
+    idle.wait(lock, [this]
+              { return pending == 0; });
+}
+
+bool WorkStealingPool::popLocal(size_t worker, Task &task)
+{
+    Queue &queue = *queues[worker];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty())
+    {
+        return false;
+    }
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    return true;
+}
+
+bool WorkStealingPool::steal(size_t worker, Task &task)
+{
+    for (size_t offset = 1; offset < queues.size(); ++offset)
+    {
+        Queue &queue = *queues[(worker + offset) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty())
+        {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::run(size_t worker)
+{
+    Task task;
+    while (true)
+    {
+        if (popLocal(worker, task) || steal(worker, task))
+        {
+            queued.fetch_sub(1);
+            task();
+            task = nullptr;
+            std::lock_guard<std::mutex> lock(stateMutex);
+            if (--pending == 0)
+            {
+                idle.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(stateMutex);
+        wake.wait(lock, [this]
+                  { return stopping || queued.load() > 0; });
+        if (stopping && queued.load() == 0)
+        {
+            return;
+        }
+    }
+}